@@ -1,20 +1,42 @@
 #include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
 #include "extconf.h"
 #include <string.h>
 #include <ruby/version.h>
+#include <ruby/thread.h>
+
+#include <limits.h>
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 #ifdef HAVE_RUBY_MEMORY_VIEW_H
 #include <ruby/memory_view.h>
 #endif
 
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES
+#include <ruby/io/buffer.h>
+#endif
+
 extern VALUE cArrayBuffer;
 
-#define DECLAREBB(self) \
-  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_data_object_get((self))
+static ID idR = Qundef;
+static ID idRw = Qundef;
+static ID idEndianess = Qundef;
+static ID idArrayBuffer = Qundef;
+
+/* Kernels over at least this many bytes run without holding the GVL */
+static size_t gvl_threshold = 1024 * 1024;
 
 #define CHECKBOUNDS(bb, idx) \
-  if (!(bb)->ptr || (idx) < 0 || (unsigned int)(idx) >= (bb)->size) { \
-    rb_raise(rb_eArgError, "Index out of bounds: %d", (idx)); \
+  if (!(bb)->ptr || (idx) < 0 || (size_t)(idx) >= (bb)->size) { \
+    rb_raise(rb_eArgError, "Index out of bounds: %"PRIdSIZE, (idx)); \
   }
 
 #ifdef HAVE_RUBY_MEMORY_VIEW_H
@@ -23,14 +45,20 @@ r_bb_mv_get(VALUE self, rb_memory_view_t *view, int flags) {
   DECLAREBB(self);
   if (!bb->size)
     return 0;
-  rb_memory_view_init_as_byte_array(view, self, bb->ptr, (const ssize_t)bb->size, 0);
+  const bool readonly = (bb->flags & BB_FLAG_READONLY) != 0;
+  if (readonly && (flags & RUBY_MEMORY_VIEW_WRITABLE))
+    return 0;
+  rb_memory_view_init_as_byte_array(view, self, bb->ptr, (const ssize_t)bb->size, readonly);
+  // The memory must not move until the view is released
+  llc_bb_pin(self);
   return 1;
 }
 
-// static bool
-// r_bb_mv_release(VALUE self, rb_memory_view_t *view) {
-//   return 1;
-// }
+static bool
+r_bb_mv_release(VALUE self, rb_memory_view_t *view) {
+  llc_bb_unpin(self);
+  return 1;
+}
 
 static bool
 r_bb_mv_available_p(VALUE self) {
@@ -40,31 +68,193 @@ r_bb_mv_available_p(VALUE self) {
 
 static rb_memory_view_entry_t cArrayBufferMemoryView = {
   r_bb_mv_get,
-  NULL, // r_bb_mv_release,
+  r_bb_mv_release,
   r_bb_mv_available_p
 };
 #endif
 
 static void
-t_bb_gc_mark(struct LLC_ArrayBuffer *bb) {
+t_bb_gc_mark(void *ptr) {
+  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)ptr;
+  // Marked as pinned: bb->ptr points into the backing string, which may
+  // hold its bytes embedded in the object slot itself
   if (bb->backing_str) {
     rb_gc_mark(bb->backing_str);
   }
+  // Pinned as well, as the buffer has no compaction callback to follow it
+  if (bb->lease) {
+    rb_gc_mark(bb->lease);
+  }
+}
+
+static void
+t_bb_unmap(struct LLC_ArrayBuffer *bb) {
+#ifdef HAVE_MMAP
+  if ((bb->flags & BB_FLAG_MAPPED) && bb->ptr) {
+    munmap((void*)bb->ptr, (size_t)bb->size);
+    rb_gc_adjust_memory_usage(-(ssize_t)bb->size);
+  }
+#endif
+  bb->ptr = NULL;
+  bb->size = 0;
+}
+
+/*
+ * The source of the memory of an external buffer, and how to give the memory
+ * back: by releasing the MemoryView it was imported through, or by unlocking
+ * the IO::Buffer.
+ *
+ * The lease lives apart from the buffer, so a finalizer can still give the
+ * memory back once the buffer is collected. The free function of the buffer
+ * can't: by then the source may have been collected as well.
+ */
+struct bb_lease {
+  VALUE source;
+  void *view;
+  /* The object_id of the buffer, as copies made by #dup share the finalizer */
+  VALUE owner_id;
+};
+
+static void
+bb_lease_mark(void *ptr) {
+  struct bb_lease *lease = (struct bb_lease*)ptr;
+  // Pinned: the buffer points into the memory of the source
+  if (lease->source)
+    rb_gc_mark(lease->source);
+  rb_gc_mark(lease->owner_id);
 }
 
 static void
-t_bb_free(struct LLC_ArrayBuffer *bb) {
+bb_lease_free(void *ptr) {
+  struct bb_lease *lease = (struct bb_lease*)ptr;
+  // The view is left over only when the finalizer never ran
+  xfree(lease->view);
+  xfree(lease);
+}
+
+static const rb_data_type_t bb_lease_type = {
+  "ArrayBuffer::Lease",
+  { bb_lease_mark, bb_lease_free, NULL, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+/*
+ * Gives the memory back to its source. Calling it more than once has no
+ * effect.
+ */
+static void
+bb_lease_release(VALUE obj) {
+  struct bb_lease *lease = (struct bb_lease*)rb_check_typeddata(obj, &bb_lease_type);
+  VALUE source = lease->source;
+  void *view = lease->view;
+  lease->source = 0;
+  lease->view = NULL;
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+  if (view) {
+    rb_memory_view_release((rb_memory_view_t*)view);
+    xfree(view);
+    return;
+  }
+#endif
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES
+  if (source && rb_obj_is_kind_of(source, rb_cIOBuffer))
+    rb_io_buffer_unlock(source);
+#endif
+  RB_GC_GUARD(source);
+}
+
+static VALUE
+bb_lease_finalize(RB_BLOCK_CALL_FUNC_ARGLIST(object_id, obj)) {
+  struct bb_lease *lease = (struct bb_lease*)rb_check_typeddata(obj, &bb_lease_type);
+  if (rb_equal(object_id, lease->owner_id))
+    bb_lease_release(obj);
+  return Qnil;
+}
+
+/*
+ * Makes +self+ an external buffer over the memory of +source+, which is given
+ * back through +view+, an rb_memory_view_t owned from then on, or else by
+ * unlocking +source+ once the buffer is closed or collected.
+ */
+static void
+bb_lease_source(VALUE self, VALUE source, void *view) {
+  DECLAREBB(self);
+  struct bb_lease *lease;
+  VALUE obj = TypedData_Make_Struct(0, struct bb_lease, &bb_lease_type, lease);
+  lease->view = view;
+  RB_OBJ_WRITE(obj, &lease->source, source);
+  RB_OBJ_WRITE(obj, &lease->owner_id, rb_obj_id(self));
+  RB_OBJ_WRITE(self, &bb->lease, obj);
+  rb_define_finalizer(self, rb_proc_new(bb_lease_finalize, obj));
+}
+
+/*
+ * Gives the memory of an external buffer back to its source.
+ */
+static void
+t_bb_release_external(struct LLC_ArrayBuffer *bb) {
+  if (!(bb->flags & BB_FLAG_EXTERNAL))
+    return;
+  if (bb->lease)
+    bb_lease_release(bb->lease);
+  bb->lease = 0;
+  bb->ptr = NULL;
+  bb->size = 0;
+}
+
+static void
+t_bb_free(void *ptr) {
+  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)ptr;
+  t_bb_unmap(bb);
   xfree(bb);
 }
 
+/*
+ * The bytes of string-backed buffers are already accounted to the backing
+ * string, so only mapped and external memory is reported here.
+ */
+static size_t
+t_bb_memsize(const void *ptr) {
+  const struct LLC_ArrayBuffer *bb = (const struct LLC_ArrayBuffer*)ptr;
+  if (bb->flags & (BB_FLAG_MAPPED | BB_FLAG_EXTERNAL))
+    return sizeof(struct LLC_ArrayBuffer) + bb->size;
+  return sizeof(struct LLC_ArrayBuffer);
+}
+
+const rb_data_type_t llc_arraybuffer_type = {
+  "ArrayBuffer",
+  { t_bb_gc_mark, t_bb_free, t_bb_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
 static VALUE
 t_bb_allocator(VALUE klass) {
-  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)xmalloc(sizeof(struct LLC_ArrayBuffer));
+  struct LLC_ArrayBuffer *bb;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_ArrayBuffer, &llc_arraybuffer_type, bb);
   bb->ptr = NULL;
   bb->size = 0;
   bb->backing_str = 0;
+  bb->lease = 0;
+  bb->flags = 0;
+  bb->pins = 0;
+  return obj;
+}
 
-  return Data_Wrap_Struct(klass, t_bb_gc_mark, t_bb_free, bb);
+/*
+ * Raises unless the memory of the buffer is a backing string that can be
+ * reallocated.
+ */
+static void
+bb_check_resizable(struct LLC_ArrayBuffer *bb) {
+  if (bb->flags & BB_FLAG_MAPPED)
+    rb_raise(rb_eRuntimeError, "can't resize a memory-mapped ArrayBuffer");
+  if (bb->flags & BB_FLAG_EXTERNAL)
+    rb_raise(rb_eRuntimeError, "can't resize an ArrayBuffer over external memory");
+  if (bb->flags & BB_FLAG_POOLED)
+    rb_raise(rb_eRuntimeError, "can't resize an ArrayBuffer released to a pool");
+  CHECK_BB_UNPINNED(bb);
 }
 
 #if (RUBY_API_VERSION_CODE >= 30100)
@@ -94,12 +284,12 @@ t_bb_reassign_ptr(struct LLC_ArrayBuffer *bb) {
 static VALUE
 t_bb_initialize(VALUE self, VALUE size) {
   DECLAREBB(self);
-  unsigned int s = NUM2UINT(size);
+  size_t s = NUM2SIZET(size);
+  if (s > LONG_MAX)
+    rb_raise(rb_eArgError, "size too big: %"PRIuSIZE, s);
+  bb_check_resizable(bb);
   bb->size = s;
-  if (bb->backing_str)
-    rb_gc_mark(bb->backing_str);
-
-  bb->backing_str = rb_str_buf_new(s);
+  RB_OBJ_WRITE(self, &bb->backing_str, rb_str_buf_new((long)s));
 
   t_bb_reassign_ptr(bb);
   memset(bb->ptr, 0, (size_t)s);
@@ -109,9 +299,9 @@ t_bb_initialize(VALUE self, VALUE size) {
 static VALUE
 t_bb_getbyte(VALUE self, VALUE index) {
   DECLAREBB(self);
-  int idx = NUM2INT(index);
+  ssize_t idx = NUM2SSIZET(index);
   if (idx < 0)
-    idx += (int)bb->size;
+    idx += (ssize_t)bb->size;
   CHECKBOUNDS(bb, idx);
   return UINT2NUM((unsigned int)bb->ptr[idx]);
 }
@@ -119,11 +309,12 @@ t_bb_getbyte(VALUE self, VALUE index) {
 static VALUE
 t_bb_setbyte(VALUE self, VALUE index, VALUE value) {
   DECLAREBB(self);
-  int idx = NUM2INT(index);
+  ssize_t idx = NUM2SSIZET(index);
   unsigned int val = NUM2UINT(value);
   if (idx < 0)
-    idx += (int)bb->size;
+    idx += (ssize_t)bb->size;
   CHECKBOUNDS(bb, idx);
+  CHECK_BB_WRITABLE(bb);
   bb->ptr[idx] = (unsigned char)val;
   return self;
 }
@@ -131,7 +322,7 @@ t_bb_setbyte(VALUE self, VALUE index, VALUE value) {
 static VALUE
 t_bb_size(VALUE self) {
   DECLAREBB(self);
-  return UINT2NUM(bb->size);
+  return SIZET2NUM(bb->size);
 }
 
 static VALUE
@@ -139,7 +330,7 @@ t_bb_each(VALUE self) {
   DECLAREBB(self);
 
   if (rb_block_given_p()) {
-    for (unsigned int i = 0; i < bb->size; i++) {
+    for (size_t i = 0; i < bb->size; i++) {
       unsigned int val = (unsigned int)bb->ptr[i];
       rb_yield(UINT2NUM(val));
     }
@@ -153,34 +344,659 @@ t_bb_each(VALUE self) {
 static VALUE
 t_bb_realloc(VALUE self, VALUE _new_size) {
   DECLAREBB(self);
-  unsigned int new_size = NUM2UINT(_new_size);
+  size_t new_size = NUM2SIZET(_new_size);
+  bb_check_resizable(bb);
   if (new_size == bb->size)
     return self;
+  if (new_size > LONG_MAX)
+    rb_raise(rb_eArgError, "size too big: %"PRIuSIZE, new_size);
 
-  rb_str_resize(bb->backing_str, new_size);
+  rb_str_resize(bb->backing_str, (long)new_size);
   bb->size = new_size;
   t_bb_reassign_ptr(bb);
 
   return self;
 }
 
+/*
+ * Makes room for at least +capacity+ bytes without changing the size.
+ */
+static void
+bb_ensure_capacity(VALUE self, struct LLC_ArrayBuffer *bb, size_t capacity) {
+  bb_check_resizable(bb);
+  if (capacity > LONG_MAX)
+    rb_raise(rb_eArgError, "size too big: %"PRIuSIZE, capacity);
+  if (!bb->backing_str) {
+    bb->size = 0;
+    RB_OBJ_WRITE(self, &bb->backing_str, rb_str_buf_new((long)capacity));
+  } else if (capacity > rb_str_capacity(bb->backing_str)) {
+    rb_str_modify_expand(bb->backing_str, (long)(capacity - bb->size));
+  }
+  t_bb_reassign_ptr(bb);
+}
+
+/*
+ * Grows the buffer by +n+ bytes and returns a pointer to the first new one.
+ *
+ * The capacity grows geometrically, so appending byte by byte is amortized
+ * O(1). The new bytes are left uninitialized.
+ */
+static unsigned char *
+bb_append(VALUE self, struct LLC_ArrayBuffer *bb, size_t n) {
+  bb_check_resizable(bb);
+  const size_t old_size = bb->size;
+  if (n > LONG_MAX - old_size)
+    rb_raise(rb_eArgError, "size too big");
+
+  const size_t needed = old_size + n;
+  const size_t capacity = bb->backing_str ? rb_str_capacity(bb->backing_str) : 0;
+  if (needed > capacity) {
+    size_t grown = capacity > LONG_MAX / 2 ? (size_t)LONG_MAX : capacity * 2;
+    bb_ensure_capacity(self, bb, grown < needed ? needed : grown);
+  }
+
+  bb->size = needed;
+  t_bb_reassign_ptr(bb);
+  return bb->ptr + old_size;
+}
+
+/*
+ * Creates a zero-filled ArrayBuffer of +size+ bytes that can grow up to
+ * +capacity+ bytes without reallocating.
+ */
+VALUE
+llc_bb_new(size_t size, size_t capacity) {
+  VALUE obj = t_bb_allocator(cArrayBuffer);
+  DECLAREBB(obj);
+  bb_ensure_capacity(obj, bb, capacity < size ? size : capacity);
+  llc_bb_reset(bb, size);
+  return obj;
+}
+
+/*
+ * Sets the size of a string-backed buffer, which must fit in its capacity,
+ * and zero-fills it.
+ */
+void
+llc_bb_reset(struct LLC_ArrayBuffer *bb, size_t size) {
+  bb->size = size;
+  t_bb_reassign_ptr(bb);
+  if (bb->ptr)
+    memset(bb->ptr, 0, size);
+}
+
+/*
+ * Returns how many bytes the buffer can hold before its memory has to be
+ * reallocated.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bb_capacity(VALUE self) {
+  DECLAREBB(self);
+  if (!bb->backing_str)
+    return SIZET2NUM(bb->size);
+  return SIZET2NUM(rb_str_capacity(bb->backing_str));
+}
+
+/*
+ * Makes sure the buffer can grow to +capacity+ bytes without reallocating.
+ *
+ * The size is not changed.
+ *
+ * @param capacity [Integer]
+ */
+static VALUE
+t_bb_reserve(VALUE self, VALUE capacity) {
+  DECLAREBB(self);
+  bb_ensure_capacity(self, bb, NUM2SIZET(capacity));
+  return self;
+}
+
+/*
+ * Releases the capacity that is not used by the current size.
+ *
+ * The buffer gets a new, exactly sized, backing string. Strings previously
+ * returned by #bytes no longer reflect the buffer contents.
+ */
+static VALUE
+t_bb_shrink_to_fit(VALUE self) {
+  DECLAREBB(self);
+  bb_check_resizable(bb);
+  if (!bb->backing_str || rb_str_capacity(bb->backing_str) == bb->size)
+    return self;
+
+  RB_OBJ_WRITE(self, &bb->backing_str, rb_str_new((const char*)bb->ptr, (long)bb->size));
+  t_bb_reassign_ptr(bb);
+  return self;
+}
+
+static VALUE
+bb_append_value(int argc, VALUE *argv, VALUE self, int type) {
+  VALUE value;
+  VALUE kwargs;
+  VALUE endianess = Qundef;
+  static ID keyword_ids[] = { 0 };
+
+  rb_scan_args(argc, argv, "1:", &value, &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idEndianess;
+  }
+
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+
+  const int little = endianess == Qundef ? 0 : llc_parse_endianess(endianess);
+  const uint64_t bits = llc_encode_value(value, type);
+
+  DECLAREBB(self);
+  unsigned char *p = bb_append(self, bb, llc_type_widths[type]);
+  llc_store_uint(p, llc_type_widths[type], little, bits);
+  return self;
+}
+
+/*
+ * Appends one byte to the end of the buffer, growing it.
+ *
+ * Values lower than zero will be set to 0 and values greater than 255
+ * will be capped.
+ */
+static VALUE
+t_bb_append_u8(VALUE self, VALUE value) {
+  return bb_append_value(1, &value, self, LLC_U8);
+}
+
+/*
+ * call-seq:
+ *  append_u16(value, endianess: :big)
+ *
+ * Appends an +unsigned short+ to the end of the buffer, growing it.
+ *
+ * Values lower than zero will be set to 0 and values greater than 65535
+ * will be capped.
+ */
+static VALUE
+t_bb_append_u16(int argc, VALUE *argv, VALUE self) {
+  return bb_append_value(argc, argv, self, LLC_U16);
+}
+
+/*
+ * call-seq:
+ *  append_u32(value, endianess: :big)
+ *
+ * Appends a 4 bytes long unsigned integer to the end of the buffer,
+ * growing it.
+ *
+ * Values lower than zero will be set to 0 and values greater than
+ * 4294967295 will be capped.
+ */
+static VALUE
+t_bb_append_u32(int argc, VALUE *argv, VALUE self) {
+  return bb_append_value(argc, argv, self, LLC_U32);
+}
+
+/*
+ * Appends the bytes of +bytes+ to the end of the buffer, growing it.
+ *
+ * @param bytes [String, ArrayBuffer, DataView]
+ */
+static VALUE
+t_bb_append_bytes(VALUE self, VALUE bytes) {
+  DECLAREBB(self);
+  size_t length;
+
+  if (RB_TYPE_P(bytes, T_STRING)) {
+    length = (size_t)RSTRING_LEN(bytes);
+    unsigned char *p = bb_append(self, bb, length);
+    memmove(p, RSTRING_PTR(bytes), length);
+  } else {
+    size_t src_length;
+    llc_view_bytes(bytes, &length, NULL, 0);
+    unsigned char *p = bb_append(self, bb, length);
+    // Growing may have moved the source, when it is this very buffer
+    const unsigned char *src = llc_view_bytes(bytes, &src_length, NULL, 0);
+    memmove(p, src, length);
+  }
+
+  return self;
+}
+
 /*
  * Returns a ASCII-8BIT string with the contents of the buffer
  *
  * The returned string is the backing string of the buffer.
  * It's encoding is always ASCII-8BIT.
  * If the buffer has size zero, an empty string is returned.
+ * Memory-mapped and external buffers have no backing string, so a copy of
+ * their bytes is returned instead.
  *
  * @return [String]
  */
 static VALUE
 t_bb_bytes(VALUE self) {
   DECLAREBB(self);
+  if (!bb->backing_str)
+    return rb_str_new((const char*)bb->ptr, (long)bb->size);
   return bb->backing_str;
 }
 
+/*
+ * call-seq:
+ *  ArrayBuffer.mmap(path, mode = :r)
+ *
+ * Creates an ArrayBuffer backed by a memory mapping of the file at +path+.
+ *
+ * No data is copied: pages are loaded lazily as they are touched, and
+ * DataView and MemoryView consumers read the mapping directly.
+ * With mode +:r+ the mapping is read-only and any write raises FrozenError.
+ * With mode +:rw+ the mapping is shared, so writes reach the file; use #msync
+ * to flush them.
+ *
+ * The buffer size is the size of the file and cannot be changed with
+ * #realloc. Call #close to unmap the file before the buffer is collected.
+ *
+ * @param path [String] Path to the file
+ * @param mode [:r, :rw] Optional. The default is +:r+
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_bb_s_mmap(int argc, VALUE *argv, VALUE klass) {
+#ifdef HAVE_MMAP
+  VALUE path;
+  VALUE mode;
+  rb_scan_args(argc, argv, "11", &path, &mode);
+  FilePathValue(path);
+
+  int writable = 0;
+  if (!NIL_P(mode)) {
+    Check_Type(mode, T_SYMBOL);
+    ID id = SYM2ID(mode);
+    if (id == idRw)
+      writable = 1;
+    else if (id != idR)
+      rb_raise(rb_eArgError, "mode must be either :r or :rw");
+  }
+
+  int fd = rb_cloexec_open(StringValueCStr(path), writable ? O_RDWR : O_RDONLY, 0);
+  if (fd < 0)
+    rb_sys_fail_str(path);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int e = errno;
+    close(fd);
+    errno = e;
+    rb_sys_fail_str(path);
+  }
+  if ((unsigned long long)st.st_size > LONG_MAX) {
+    close(fd);
+    rb_raise(rb_eArgError, "file is too large to be mapped: %"PRIsVALUE, path);
+  }
+
+  void *ptr = NULL;
+  if (st.st_size > 0) {
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    ptr = mmap(NULL, (size_t)st.st_size, prot, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      int e = errno;
+      close(fd);
+      errno = e;
+      rb_sys_fail_str(path);
+    }
+  }
+  close(fd);
+
+  VALUE self = t_bb_allocator(klass);
+  DECLAREBB(self);
+  bb->ptr = (unsigned char*)ptr;
+  bb->size = (size_t)st.st_size;
+  bb->flags = BB_FLAG_MAPPED | (writable ? 0 : BB_FLAG_READONLY);
+  rb_gc_adjust_memory_usage((ssize_t)bb->size);
+  return self;
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
+/*
+ * Returns whether the buffer is backed by a memory-mapped file.
+ *
+ * @return [Boolean]
+ */
+static VALUE
+t_bb_mapped_p(VALUE self) {
+  DECLAREBB(self);
+  return (bb->flags & BB_FLAG_MAPPED) ? Qtrue : Qfalse;
+}
+
+/*
+ * Flushes changes made to a memory-mapped buffer back to its file.
+ *
+ * Does nothing for read-only mappings and raises for buffers that are not
+ * memory-mapped.
+ */
+static VALUE
+t_bb_msync(VALUE self) {
+  DECLAREBB(self);
+  if (!(bb->flags & BB_FLAG_MAPPED))
+    rb_raise(rb_eRuntimeError, "ArrayBuffer is not memory-mapped");
+#ifdef HAVE_MSYNC
+  if (bb->ptr && !(bb->flags & BB_FLAG_READONLY)) {
+    if (msync((void*)bb->ptr, (size_t)bb->size, MS_SYNC) < 0)
+      rb_sys_fail("msync");
+  }
+#endif
+  return self;
+}
+
+/*
+ * Unmaps the file backing a memory-mapped buffer, or gives the memory of an
+ * external buffer back to its source.
+ *
+ * Afterwards the buffer has size zero. Any DataView over it sees no data.
+ * Calling it more than once has no effect.
+ */
+static VALUE
+t_bb_close(VALUE self) {
+  DECLAREBB(self);
+  if (!(bb->flags & (BB_FLAG_MAPPED | BB_FLAG_EXTERNAL)))
+    rb_raise(rb_eRuntimeError, "ArrayBuffer is neither memory-mapped nor external");
+  CHECK_BB_UNPINNED(bb);
+  t_bb_unmap(bb);
+  t_bb_release_external(bb);
+  return Qnil;
+}
+
+/*
+ * Keeps the memory of +obj+, an ArrayBuffer or a DataView, from being
+ * resized or unmapped while a kernel or a system call works on it without
+ * the GVL. The backing string is locked too, so it can't be changed through
+ * #bytes.
+ */
+void
+llc_bb_pin(VALUE obj) {
+  if (rb_typeddata_is_kind_of(obj, &llc_dataview_type)) {
+    DECLAREDV(obj);
+    obj = dv->bb_obj;
+  }
+  if (!rb_typeddata_is_kind_of(obj, &llc_arraybuffer_type))
+    return;
+
+  DECLAREBB(obj);
+  if (!bb->pins && bb->backing_str)
+    rb_str_locktmp(bb->backing_str);
+  bb->pins++;
+}
+
+void
+llc_bb_unpin(VALUE obj) {
+  if (rb_typeddata_is_kind_of(obj, &llc_dataview_type)) {
+    DECLAREDV(obj);
+    obj = dv->bb_obj;
+  }
+  if (!rb_typeddata_is_kind_of(obj, &llc_arraybuffer_type))
+    return;
+
+  DECLAREBB(obj);
+  bb->pins--;
+  if (!bb->pins && bb->backing_str)
+    rb_str_unlocktmp(bb->backing_str);
+}
+
+struct kernel_call {
+  void *(*kernel)(void *);
+  void *arg;
+  VALUE objs[2];
+  int pinned;
+};
+
+static VALUE
+kernel_call_body(VALUE data) {
+  struct kernel_call *call = (struct kernel_call*)data;
+  for (; call->pinned < 2; call->pinned++)
+    llc_bb_pin(call->objs[call->pinned]);
+  rb_thread_call_without_gvl(call->kernel, call->arg, NULL, NULL);
+  return Qnil;
+}
+
+static VALUE
+kernel_call_ensure(VALUE data) {
+  struct kernel_call *call = (struct kernel_call*)data;
+  while (call->pinned > 0)
+    llc_bb_unpin(call->objs[--call->pinned]);
+  return Qnil;
+}
+
+/*
+ * Runs +kernel(arg)+, which must not touch any Ruby object, over +size+
+ * bytes of the buffers +obj1+ and +obj2+ (ArrayBuffers, DataViews or
+ * Qnil).
+ *
+ * When +size+ reaches ArrayBuffer.gvl_threshold the kernel runs without the
+ * GVL, so other threads keep running, and both buffers are pinned until it
+ * returns.
+ */
+void
+llc_run_kernel(size_t size, void *(*kernel)(void *), void *arg, VALUE obj1, VALUE obj2) {
+  if (size < gvl_threshold) {
+    kernel(arg);
+    return;
+  }
+
+  struct kernel_call call = { kernel, arg, { obj1, obj2 }, 0 };
+  rb_ensure(kernel_call_body, (VALUE)&call, kernel_call_ensure, (VALUE)&call);
+}
+
+struct copy_args {
+  unsigned char *dst;
+  const unsigned char *src;
+  size_t length;
+};
+
+static void *
+copy_kernel(void *ptr) {
+  struct copy_args *args = (struct copy_args*)ptr;
+  memmove(args->dst, args->src, args->length);
+  return NULL;
+}
+
+/*
+ * Returns +str+, or when kernels over +length+ of its bytes run without the
+ * GVL, a frozen string sharing them, so they can't change meanwhile.
+ */
+VALUE
+llc_kernel_string(VALUE str, size_t length) {
+  return length >= gvl_threshold ? rb_str_new_frozen(str) : str;
+}
+
+/*
+ * Copies +length+ bytes from +src+, within +src_obj+, to +dst+, within
+ * +dst_obj+. The areas may overlap.
+ *
+ * +src_obj+ may also be a String, read through llc_kernel_string.
+ */
+void
+llc_copy_bytes(unsigned char *dst, const unsigned char *src, size_t length, VALUE dst_obj, VALUE src_obj) {
+  if (RB_TYPE_P(src_obj, T_STRING)) {
+    const long offset = (long)((const char*)src - RSTRING_PTR(src_obj));
+    src_obj = llc_kernel_string(src_obj, length);
+    src = (const unsigned char*)RSTRING_PTR(src_obj) + offset;
+  }
+
+  struct copy_args args = { dst, src, length };
+  llc_run_kernel(length, copy_kernel, &args, dst_obj, src_obj);
+  RB_GC_GUARD(src_obj);
+}
+
+/*
+ * Returns the size, in bytes, from which bulk operations release the GVL.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bb_s_gvl_threshold(VALUE klass) {
+  return SIZET2NUM(gvl_threshold);
+}
+
+/*
+ * Sets the size, in bytes, from which bulk operations such as copies run
+ * without holding the GVL, so other threads keep running meanwhile.
+ *
+ * While such an operation runs, the buffers it works on can't be resized.
+ * The default is 1 MiB.
+ *
+ * @param threshold [Integer]
+ */
+static VALUE
+t_bb_s_set_gvl_threshold(VALUE klass, VALUE threshold) {
+  const ssize_t val = NUM2SSIZET(threshold);
+  if (val < 0)
+    rb_raise(rb_eArgError, "threshold must not be negative: %"PRIdSIZE, val);
+  gvl_threshold = (size_t)val;
+  return threshold;
+}
+
+/*
+ * Pins the buffer for good, once its memory is handed to another object that
+ * can't tell when it would be moved.
+ */
+static void
+bb_share(VALUE self) {
+  DECLAREBB(self);
+  if (!(bb->flags & BB_FLAG_SHARED)) {
+    llc_bb_pin(self);
+    bb->flags |= BB_FLAG_SHARED;
+  }
+}
+
+/*
+ * call-seq:
+ *  ArrayBuffer.from_memory_view(obj)
+ *
+ * Creates an ArrayBuffer over the memory that +obj+ exports as a
+ * MemoryView, such as a Fiddle::Pointer or a numeric array. No bytes are
+ * copied: reads and writes go straight to the memory of +obj+, which is kept
+ * alive as long as the buffer is.
+ *
+ * Read-only views give read-only buffers. The buffer can't be resized;
+ * call #close to release the view before the buffer is collected. When
+ * +obj+ is an ArrayBuffer, a DataView or a TypedArray, its buffer can't be
+ * resized either until the view is released.
+ *
+ * @param obj [Object] Any object exporting a contiguous MemoryView
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_bb_s_from_memory_view(VALUE klass, VALUE obj) {
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+  VALUE self = t_bb_allocator(klass);
+  DECLAREBB(self);
+  rb_memory_view_t *view = ALLOC(rb_memory_view_t);
+  if (!rb_memory_view_get(obj, view, RUBY_MEMORY_VIEW_SIMPLE)) {
+    xfree(view);
+    rb_raise(rb_eArgError, "unable to get a memory view from %"PRIsVALUE, rb_obj_class(obj));
+  }
+
+  // Owned by the buffer from here on, so it is released even if we raise
+  bb_lease_source(self, obj, view);
+  bb->flags = BB_FLAG_EXTERNAL | (view->readonly ? BB_FLAG_READONLY : 0);
+  bb->ptr = (unsigned char*)view->data;
+  bb->size = (size_t)view->byte_size;
+
+  // Byte arrays have neither shape nor strides, which
+  // rb_memory_view_is_contiguous does not expect
+  if (view->strides && !(view->shape && rb_memory_view_is_contiguous(view))) {
+    t_bb_release_external(bb);
+    rb_raise(rb_eArgError, "memory view of %"PRIsVALUE" is not contiguous", rb_obj_class(obj));
+  }
+  return self;
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
+/*
+ * call-seq:
+ *  ArrayBuffer.from_io_buffer(io_buffer)
+ *
+ * Creates an ArrayBuffer over the memory of +io_buffer+, without copying.
+ *
+ * The IO::Buffer is locked, so it can't be resized or freed, until #close
+ * is called on the returned buffer or the buffer is collected. Read-only
+ * IO::Buffers give read-only buffers.
+ *
+ * Example:
+ *   io_buffer = IO::Buffer.map(file)
+ *   view = DataView.new(ArrayBuffer.from_io_buffer(io_buffer))
+ *
+ * @param io_buffer [IO::Buffer]
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_bb_s_from_io_buffer(VALUE klass, VALUE io_buffer) {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES
+  if (!rb_obj_is_kind_of(io_buffer, rb_cIOBuffer))
+    rb_raise(rb_eTypeError, "expected an IO::Buffer, got %"PRIsVALUE, rb_obj_class(io_buffer));
+
+  VALUE self = t_bb_allocator(klass);
+  DECLAREBB(self);
+  void *base;
+  size_t size;
+  const enum rb_io_buffer_flags flags = rb_io_buffer_get_bytes(io_buffer, &base, &size);
+  rb_io_buffer_lock(io_buffer);
+
+  bb_lease_source(self, io_buffer, NULL);
+  bb->flags = BB_FLAG_EXTERNAL | ((flags & RB_IO_BUFFER_READONLY) ? BB_FLAG_READONLY : 0);
+  bb->ptr = (unsigned char*)base;
+  bb->size = size;
+  return self;
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
+/*
+ * Returns an IO::Buffer over the memory of the buffer, without copying.
+ *
+ * The IO::Buffer keeps the buffer alive, and from then on the buffer can't
+ * be resized, unmapped or closed, and its backing string can't be modified.
+ * Read-only buffers give read-only IO::Buffers.
+ *
+ * Example:
+ *   io.read(buffer.to_io_buffer)
+ *
+ * @return [IO::Buffer]
+ */
+static VALUE
+t_bb_to_io_buffer(VALUE self) {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES
+  DECLAREBB(self);
+  enum rb_io_buffer_flags flags = RB_IO_BUFFER_EXTERNAL;
+  if (bb->flags & BB_FLAG_READONLY)
+    flags |= RB_IO_BUFFER_READONLY;
+
+  bb_share(self);
+  VALUE io_buffer = rb_io_buffer_new(bb->ptr, bb->size, flags);
+  rb_ivar_set(io_buffer, idArrayBuffer, self);
+  return io_buffer;
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
 void
 Init_arraybuffer() {
+  idR = rb_intern("r");
+  idRw = rb_intern("rw");
+  idEndianess = rb_intern("endianess");
+  // Not a valid instance variable name, so it is hidden from Ruby
+  idArrayBuffer = rb_intern("__array_buffer__");
+
   cArrayBuffer = rb_define_class("ArrayBuffer", rb_cObject);
   rb_define_alloc_func(cArrayBuffer, t_bb_allocator);
   rb_include_module(cArrayBuffer, rb_mEnumerable);
@@ -192,9 +1008,29 @@ Init_arraybuffer() {
   rb_define_alias(cArrayBuffer, "length", "size");
   rb_define_method(cArrayBuffer, "each", t_bb_each, 0);
   rb_define_method(cArrayBuffer, "realloc", t_bb_realloc, 1);
+  rb_define_method(cArrayBuffer, "capacity", t_bb_capacity, 0);
+  rb_define_method(cArrayBuffer, "reserve", t_bb_reserve, 1);
+  rb_define_method(cArrayBuffer, "shrink_to_fit", t_bb_shrink_to_fit, 0);
+  rb_define_method(cArrayBuffer, "append_u8", t_bb_append_u8, 1);
+  rb_define_method(cArrayBuffer, "append_u16", t_bb_append_u16, -1);
+  rb_define_method(cArrayBuffer, "append_u32", t_bb_append_u32, -1);
+  rb_define_method(cArrayBuffer, "append_bytes", t_bb_append_bytes, 1);
+  rb_define_alias(cArrayBuffer, "<<", "append_bytes");
   rb_define_method(cArrayBuffer, "bytes", t_bb_bytes, 0);
   rb_define_method(cArrayBuffer, "to_s", t_bb_bytes, 0);
 
+  rb_define_singleton_method(cArrayBuffer, "mmap", t_bb_s_mmap, -1);
+  rb_define_method(cArrayBuffer, "mapped?", t_bb_mapped_p, 0);
+  rb_define_method(cArrayBuffer, "msync", t_bb_msync, 0);
+  rb_define_method(cArrayBuffer, "close", t_bb_close, 0);
+
+  rb_define_singleton_method(cArrayBuffer, "from_memory_view", t_bb_s_from_memory_view, 1);
+  rb_define_singleton_method(cArrayBuffer, "from_io_buffer", t_bb_s_from_io_buffer, 1);
+  rb_define_method(cArrayBuffer, "to_io_buffer", t_bb_to_io_buffer, 0);
+
+  rb_define_singleton_method(cArrayBuffer, "gvl_threshold", t_bb_s_gvl_threshold, 0);
+  rb_define_singleton_method(cArrayBuffer, "gvl_threshold=", t_bb_s_set_gvl_threshold, 1);
+
 #ifdef HAVE_RUBY_MEMORY_VIEW_H
   rb_memory_view_register(cArrayBuffer, &cArrayBufferMemoryView);
 #endif
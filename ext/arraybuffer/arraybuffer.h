@@ -5,8 +5,53 @@
 
 struct LLC_ArrayBuffer {
   unsigned char *ptr;
-  unsigned int size;
+  size_t size;
   VALUE backing_str;
+  /* The lease giving the memory of an external buffer back to its source */
+  VALUE lease;
+  unsigned char flags;
+  /*
+   * How many native kernels are working on the memory without the GVL
+   * and MemoryViews are exported over it, plus one for good once the memory
+   * is shared with another object
+   */
+  unsigned int pins;
 };
 
+/* The memory is a mmap(2) of a file rather than a backing string */
+#define BB_FLAG_MAPPED 1
+/* The memory must not be written to */
+#define BB_FLAG_READONLY 2
+/* The buffer was released to an ArrayBuffer::Pool and waits for reuse */
+#define BB_FLAG_POOLED 4
+/* The memory belongs to another object, such as an IO::Buffer */
+#define BB_FLAG_EXTERNAL 8
+/* The memory is shared with another object for good, so it stays pinned */
+#define BB_FLAG_SHARED 16
+
+extern const rb_data_type_t llc_arraybuffer_type;
+
+#define DECLAREBB(o) \
+  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_check_typeddata((o), &llc_arraybuffer_type)
+
+#define CHECK_BB_WRITABLE(bb) \
+  if ((bb)->flags & BB_FLAG_READONLY) { \
+    rb_raise(rb_eFrozenError, "can't modify read-only ArrayBuffer"); \
+  }
+
+#define CHECK_BB_UNPINNED(bb) \
+  if ((bb)->pins) { \
+    rb_raise(rb_eRuntimeError, "can't resize an ArrayBuffer while its memory is in use"); \
+  }
+
+VALUE llc_bb_new(size_t size, size_t capacity);
+void llc_bb_reset(struct LLC_ArrayBuffer *bb, size_t size);
+
+void llc_bb_pin(VALUE obj);
+void llc_bb_unpin(VALUE obj);
+
+void llc_run_kernel(size_t size, void *(*kernel)(void *), void *arg, VALUE obj1, VALUE obj2);
+VALUE llc_kernel_string(VALUE str, size_t length);
+void llc_copy_bytes(unsigned char *dst, const unsigned char *src, size_t length, VALUE dst_obj, VALUE src_obj);
+
 #endif
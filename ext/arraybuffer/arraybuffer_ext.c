@@ -3,12 +3,48 @@
 
 VALUE cArrayBuffer = Qundef;
 VALUE cDataView = Qundef;
+VALUE cSchema = Qundef;
+VALUE cReader = Qundef;
+VALUE cWriter = Qundef;
+VALUE cPool = Qundef;
+VALUE cTypedArray = Qundef;
+VALUE cBitReader = Qundef;
 
 void Init_dataview();
 void Init_arraybuffer();
+void Init_schema();
+void Init_cursor();
+void Init_pool();
+void Init_search();
+void Init_checksum();
+void Init_compare();
+void Init_bulk();
+void Init_typedarray();
+void Init_io();
+void Init_bits();
+void Init_varint();
+void Init_pack();
+void Init_reduce();
+void Init_bitmap();
+void Init_codec();
 
 void
 Init_arraybuffer_ext() {
   Init_arraybuffer();
   Init_dataview();
+  Init_schema();
+  Init_cursor();
+  Init_pool();
+  Init_search();
+  Init_checksum();
+  Init_compare();
+  Init_bulk();
+  Init_typedarray();
+  Init_io();
+  Init_bits();
+  Init_varint();
+  Init_pack();
+  Init_reduce();
+  Init_bitmap();
+  Init_codec();
 }
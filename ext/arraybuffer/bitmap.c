@@ -0,0 +1,450 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLC_BITMAP_POPCNT 1
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+#ifdef LLC_BITMAP_POPCNT
+/* Whether the CPU has the POPCNT instruction, detected at load time */
+static int bitmap_popcnt = 0;
+#endif
+
+/*
+ * Bitmaps are read the way DataView#getBit does: bit +i+ is bit +i % 8+,
+ * counting from the least significant one, of byte +i / 8+. Words are only
+ * combined, counted or tested for zero, so they are loaded in host order.
+ */
+
+enum bitmap_op { BITMAP_AND, BITMAP_OR, BITMAP_XOR, BITMAP_ANDNOT, BITMAP_NOT };
+
+struct bitmap_args {
+  unsigned char *dst;
+  const unsigned char *a;
+  const unsigned char *b;
+  size_t len;
+  enum bitmap_op op;
+  size_t count;
+};
+
+static inline uint64_t
+bitmap_load(const unsigned char *p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+static inline void
+bitmap_store(unsigned char *p, uint64_t word) {
+  memcpy(p, &word, sizeof(word));
+}
+
+/*
+ * Applies +expr+, over the words or bytes +a+ and +b+, to every 8 bytes
+ * then to the remaining ones. Going backwards keeps an in-place operation
+ * right when +dst+ overlaps the end of +pb+. Unary operations ignore +b+.
+ */
+#define BITMAP_LOOP(expr) do { \
+    if (backward) { \
+      size_t i = len; \
+      for (; i % 8; i--) { \
+        const uint64_t a = pa[i - 1], b = pb[i - 1]; \
+        (void)b; \
+        dst[i - 1] = (unsigned char)(expr); \
+      } \
+      for (; i; i -= 8) { \
+        const uint64_t a = bitmap_load(pa + i - 8), b = bitmap_load(pb + i - 8); \
+        (void)b; \
+        bitmap_store(dst + i - 8, (expr)); \
+      } \
+    } else { \
+      size_t i = 0; \
+      for (; i + 8 <= len; i += 8) { \
+        const uint64_t a = bitmap_load(pa + i), b = bitmap_load(pb + i); \
+        (void)b; \
+        bitmap_store(dst + i, (expr)); \
+      } \
+      for (; i < len; i++) { \
+        const uint64_t a = pa[i], b = pb[i]; \
+        (void)b; \
+        dst[i] = (unsigned char)(expr); \
+      } \
+    } \
+  } while (0)
+
+static void *
+bitmap_op_kernel(void *ptr) {
+  struct bitmap_args *args = (struct bitmap_args*)ptr;
+  // Locals, since stores through the bytes could otherwise alias args
+  unsigned char *dst = args->dst;
+  const unsigned char *pa = args->a;
+  const unsigned char *pb = args->b ? args->b : args->a;
+  const size_t len = args->len;
+  const int backward = pb < dst && dst < pb + len;
+
+  switch (args->op) {
+  case BITMAP_AND: BITMAP_LOOP(a & b); break;
+  case BITMAP_OR: BITMAP_LOOP(a | b); break;
+  case BITMAP_XOR: BITMAP_LOOP(a ^ b); break;
+  case BITMAP_ANDNOT: BITMAP_LOOP(a & ~b); break;
+  case BITMAP_NOT: BITMAP_LOOP(~a); break;
+  }
+  return NULL;
+}
+
+static inline size_t
+popcount_words(const unsigned char *p, size_t len) {
+  // Independent counters let the popcounts overlap
+  size_t counts[4] = { 0, 0, 0, 0 };
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    counts[0] += (size_t)__builtin_popcountll(bitmap_load(p + i));
+    counts[1] += (size_t)__builtin_popcountll(bitmap_load(p + i + 8));
+    counts[2] += (size_t)__builtin_popcountll(bitmap_load(p + i + 16));
+    counts[3] += (size_t)__builtin_popcountll(bitmap_load(p + i + 24));
+  }
+  for (; i < len; i++)
+    counts[0] += (size_t)__builtin_popcount(p[i]);
+  return counts[0] + counts[1] + counts[2] + counts[3];
+}
+
+#ifdef LLC_BITMAP_POPCNT
+__attribute__((target("popcnt")))
+static size_t
+popcount_hw(const unsigned char *p, size_t len) {
+  return popcount_words(p, len);
+}
+#endif
+
+static size_t
+popcount_bytes(const unsigned char *p, size_t len) {
+#ifdef LLC_BITMAP_POPCNT
+  if (bitmap_popcnt)
+    return popcount_hw(p, len);
+#endif
+  return popcount_words(p, len);
+}
+
+static void *
+popcount_kernel(void *ptr) {
+  struct bitmap_args *args = (struct bitmap_args*)ptr;
+  args->count = popcount_bytes(args->a, args->len);
+  return NULL;
+}
+
+/*
+ * Returns the index of the first set bit from +from+ on, or +nbits+ if
+ * there is none.
+ */
+static size_t
+bitmap_next_set(const unsigned char *p, size_t len, size_t from) {
+  const size_t nbits = len * 8;
+  size_t idx = from / 8;
+  if (from >= nbits)
+    return nbits;
+
+  unsigned int byte = p[idx] & (0xFFu << (from % 8));
+  while (!byte) {
+    if (++idx == len)
+      return nbits;
+    // Skip zero words whole once aligned on them
+    if (!(idx % 8)) {
+      for (; idx + 8 <= len && !bitmap_load(p + idx); idx += 8);
+      if (idx == len)
+        return nbits;
+    }
+    byte = p[idx];
+  }
+  return idx * 8 + (size_t)__builtin_ctz(byte);
+}
+
+/*
+ * Resolves the bit index +idx+ over +nbits+ bits, which may be negative,
+ * allowing +nbits+ itself when +inclusive+. Converting the index may run
+ * Ruby code that resizes the buffer, so callers do it before taking the
+ * bytes.
+ */
+static size_t
+bitmap_index(ssize_t idx, size_t nbits, int inclusive) {
+  if (idx < 0)
+    idx += (ssize_t)nbits;
+  if (idx < 0 || (size_t)idx > nbits || (!inclusive && (size_t)idx == nbits))
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
+  return (size_t)idx;
+}
+
+static const unsigned char *
+bitmap_operand(VALUE obj, size_t len) {
+  size_t other_len;
+  const unsigned char *ptr = llc_view_bytes(obj, &other_len, NULL, 0);
+  if (other_len != len)
+    rb_raise(rb_eArgError, "bitmaps differ in size: %"PRIuSIZE" and %"PRIuSIZE" bytes", len, other_len);
+  return ptr;
+}
+
+static VALUE
+bitmap_apply(VALUE self, VALUE other, enum bitmap_op op) {
+  struct bitmap_args args;
+  memset(&args, 0, sizeof(args));
+  args.op = op;
+  args.a = args.dst = llc_view_bytes(self, &args.len, NULL, 1);
+  if (op != BITMAP_NOT)
+    args.b = bitmap_operand(other, args.len);
+  llc_run_kernel(args.len, bitmap_op_kernel, &args, self, op != BITMAP_NOT ? other : Qnil);
+  return self;
+}
+
+static VALUE
+bitmap_apply_new(VALUE self, VALUE other, enum bitmap_op op) {
+  struct bitmap_args args;
+  memset(&args, 0, sizeof(args));
+  args.op = op;
+  llc_view_bytes(self, &args.len, NULL, 0);
+  if (op != BITMAP_NOT)
+    bitmap_operand(other, args.len);
+
+  VALUE result = llc_bb_new(args.len, args.len);
+  // Allocating may have run GC, but not Ruby code, so the operands are intact
+  args.a = llc_view_bytes(self, &args.len, NULL, 0);
+  if (op != BITMAP_NOT)
+    args.b = bitmap_operand(other, args.len);
+  args.dst = llc_view_bytes(result, &args.len, NULL, 1);
+  llc_run_kernel(args.len, bitmap_op_kernel, &args, self, op != BITMAP_NOT ? other : Qnil);
+  return result;
+}
+
+/*
+ * Returns a new ArrayBuffer with the bitwise AND of the bytes with those of
+ * +other+, which must be as large.
+ *
+ * Example:
+ *   matches = active & selected
+ *
+ * @param other [ArrayBuffer, DataView]
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_and(VALUE self, VALUE other) {
+  return bitmap_apply_new(self, other, BITMAP_AND);
+}
+
+/*
+ * Returns a new ArrayBuffer with the bitwise OR of the bytes with those of
+ * +other+, which must be as large.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_or(VALUE self, VALUE other) {
+  return bitmap_apply_new(self, other, BITMAP_OR);
+}
+
+/*
+ * Returns a new ArrayBuffer with the bitwise XOR of the bytes with those of
+ * +other+, which must be as large.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_xor(VALUE self, VALUE other) {
+  return bitmap_apply_new(self, other, BITMAP_XOR);
+}
+
+/*
+ * Returns a new ArrayBuffer with the bits set in the bytes but not in
+ * those of +other+, which must be as large.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_andnot(VALUE self, VALUE other) {
+  return bitmap_apply_new(self, other, BITMAP_ANDNOT);
+}
+
+/*
+ * Returns a new ArrayBuffer with every bit of the bytes flipped.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_not(VALUE self) {
+  return bitmap_apply_new(self, Qnil, BITMAP_NOT);
+}
+
+/*
+ * Same as #and, but stores the result in place.
+ *
+ * @return [self]
+ */
+static VALUE
+t_and_bang(VALUE self, VALUE other) {
+  return bitmap_apply(self, other, BITMAP_AND);
+}
+
+/*
+ * Same as #or, but stores the result in place.
+ *
+ * @return [self]
+ */
+static VALUE
+t_or_bang(VALUE self, VALUE other) {
+  return bitmap_apply(self, other, BITMAP_OR);
+}
+
+/*
+ * Same as #xor, but stores the result in place.
+ *
+ * @return [self]
+ */
+static VALUE
+t_xor_bang(VALUE self, VALUE other) {
+  return bitmap_apply(self, other, BITMAP_XOR);
+}
+
+/*
+ * Same as #andnot, but stores the result in place.
+ *
+ * @return [self]
+ */
+static VALUE
+t_andnot_bang(VALUE self, VALUE other) {
+  return bitmap_apply(self, other, BITMAP_ANDNOT);
+}
+
+/*
+ * Same as #not, but stores the result in place.
+ *
+ * @return [self]
+ */
+static VALUE
+t_not_bang(VALUE self) {
+  return bitmap_apply(self, Qnil, BITMAP_NOT);
+}
+
+/*
+ * Counts the set bits.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_popcount(VALUE self) {
+  struct bitmap_args args;
+  memset(&args, 0, sizeof(args));
+  args.a = llc_view_bytes(self, &args.len, NULL, 0);
+  llc_run_kernel(args.len, popcount_kernel, &args, self, Qnil);
+  return SIZET2NUM(args.count);
+}
+
+/*
+ * Counts the set bits before the bit at +index+, which may go from zero
+ * up to +size * 8+. Negative values are summed with +size * 8+.
+ *
+ * Example:
+ *   # Position of a row among the selected ones
+ *   selected.rank(row)
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_rank(VALUE self, VALUE index) {
+  const ssize_t index_arg = NUM2SSIZET(index);
+  struct bitmap_args args;
+  memset(&args, 0, sizeof(args));
+  args.a = llc_view_bytes(self, &args.len, NULL, 0);
+  const size_t idx = bitmap_index(index_arg, args.len * 8, 1);
+  args.len = idx / 8;
+  llc_run_kernel(args.len, popcount_kernel, &args, self, Qnil);
+  if (idx % 8)
+    args.count += (size_t)__builtin_popcount(args.a[idx / 8] & ((1u << (idx % 8)) - 1));
+  return SIZET2NUM(args.count);
+}
+
+/*
+ * call-seq:
+ *  next_set_bit(from = 0)
+ *
+ * Returns the index of the first set bit at or after +from+, or nil if
+ * there is none. Negative values of +from+ are summed with +size * 8+.
+ *
+ * @return [Integer, nil]
+ */
+static VALUE
+t_next_set_bit(int argc, VALUE *argv, VALUE self) {
+  VALUE from;
+  rb_scan_args(argc, argv, "01", &from);
+  const ssize_t from_arg = NIL_P(from) ? 0 : NUM2SSIZET(from);
+
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+  if (!len)
+    return Qnil;
+  const size_t idx = bitmap_next_set(ptr, len, bitmap_index(from_arg, len * 8, 1));
+  return idx < len * 8 ? SIZET2NUM(idx) : Qnil;
+}
+
+static VALUE
+bitmap_enum_size(VALUE self, VALUE args, VALUE eobj) {
+  return t_popcount(self);
+}
+
+/*
+ * Yields the index of every set bit, in increasing order.
+ *
+ * Example:
+ *   matches.each_set_bit { |row| puts rows[row] }
+ *
+ * @return [self]
+ */
+static VALUE
+t_each_set_bit(VALUE self) {
+  RETURN_SIZED_ENUMERATOR(self, 0, 0, bitmap_enum_size);
+
+  // The block may resize the buffer, so bytes are looked up on every step
+  for (size_t from = 0;; from++) {
+    size_t len;
+    const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+    from = bitmap_next_set(ptr, len, from);
+    if (from >= len * 8)
+      break;
+    rb_yield(SIZET2NUM(from));
+  }
+  return self;
+}
+
+static void
+define_bitmap_methods(VALUE klass) {
+  rb_define_method(klass, "and", t_and, 1);
+  rb_define_method(klass, "or", t_or, 1);
+  rb_define_method(klass, "xor", t_xor, 1);
+  rb_define_method(klass, "andnot", t_andnot, 1);
+  rb_define_method(klass, "not", t_not, 0);
+  rb_define_method(klass, "&", t_and, 1);
+  rb_define_method(klass, "|", t_or, 1);
+  rb_define_method(klass, "^", t_xor, 1);
+  rb_define_method(klass, "~", t_not, 0);
+  rb_define_method(klass, "and!", t_and_bang, 1);
+  rb_define_method(klass, "or!", t_or_bang, 1);
+  rb_define_method(klass, "xor!", t_xor_bang, 1);
+  rb_define_method(klass, "andnot!", t_andnot_bang, 1);
+  rb_define_method(klass, "not!", t_not_bang, 0);
+  rb_define_method(klass, "popcount", t_popcount, 0);
+  rb_define_method(klass, "rank", t_rank, 1);
+  rb_define_method(klass, "next_set_bit", t_next_set_bit, -1);
+  rb_define_method(klass, "each_set_bit", t_each_set_bit, 0);
+}
+
+void
+Init_bitmap() {
+#ifdef LLC_BITMAP_POPCNT
+  __builtin_cpu_init();
+  bitmap_popcnt = __builtin_cpu_supports("popcnt");
+#endif
+
+  define_bitmap_methods(cArrayBuffer);
+  define_bitmap_methods(cDataView);
+}
@@ -0,0 +1,584 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+extern VALUE cBitReader;
+
+static ID idOrder = Qundef;
+static ID idMsb = Qundef;
+static ID idLsb = Qundef;
+
+/* Masks the lower +width+ bits, for widths from 1 to 64 */
+#define BITS_MASK(width) (UINT64_MAX >> (64 - (width)))
+
+/*
+ * Returns whether +order+, which must be +:msb+ or +:lsb+, is MSB-first.
+ * Qundef and nil stand for the default, LSB-first, the order of #getBit.
+ */
+static int
+bits_parse_order(VALUE order) {
+  if (order == Qundef || NIL_P(order))
+    return 0;
+  Check_Type(order, T_SYMBOL);
+  const ID id = SYM2ID(order);
+  if (id == idMsb)
+    return 1;
+  if (id != idLsb)
+    rb_raise(rb_eArgError, "order must be either :msb or :lsb");
+  return 0;
+}
+
+static int
+bits_order_kwarg(VALUE kwargs) {
+  static ID keyword_ids[] = { 0 };
+  VALUE order = Qundef;
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idOrder;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &order);
+  return bits_parse_order(order);
+}
+
+static unsigned int
+bits_width(VALUE width) {
+  const int val = NUM2INT(width);
+  if (val < 1 || val > 64)
+    rb_raise(rb_eArgError, "width must be between 1 and 64: %d", val);
+  return (unsigned int)val;
+}
+
+/*
+ * Resolves +bit_offset+, which may be negative, for a field of +width+ bits
+ * within +self+ and returns the bytes of the view, storing their count in
+ * +len+.
+ */
+static unsigned char *
+bits_field(VALUE self, VALUE bit_offset, unsigned int width, int writable, size_t *offset, size_t *len) {
+  // Converting may run Ruby code that resizes the buffer, so it comes
+  // before the bytes are taken
+  ssize_t idx = NUM2SSIZET(bit_offset);
+  unsigned char *ptr = llc_view_bytes(self, len, NULL, writable);
+  const size_t bits = *len * 8;
+  if (idx < 0)
+    idx += (ssize_t)bits;
+  if (idx < 0 || (size_t)idx > bits || width > bits - (size_t)idx)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
+  *offset = (size_t)idx;
+  return ptr;
+}
+
+/*
+ * Extracts +width+ bits starting +shift+ bits into +p+, which holds at
+ * least 9 readable bytes.
+ *
+ * LSB-first numbers the bits of every byte from the least significant one,
+ * and the first bit becomes the least significant bit of the result.
+ * MSB-first numbers them from the most significant one, and the first bit
+ * becomes the most significant bit of the result.
+ */
+static inline uint64_t
+bits_extract(const unsigned char *p, unsigned int shift, unsigned int width, int msb) {
+  if (msb) {
+    uint64_t val = llc_load_uint(p, 8, 0) << shift;
+    if (shift + width > 64)
+      val |= (uint64_t)p[8] >> (8 - shift);
+    return val >> (64 - width);
+  }
+
+  uint64_t val = llc_load_uint(p, 8, 1) >> shift;
+  if (shift + width > 64)
+    val |= (uint64_t)p[8] << (64 - shift);
+  return val & BITS_MASK(width);
+}
+
+/*
+ * Reads +width+ bits at +bit_offset+ of the +len+ bytes at +ptr+. Fields
+ * near the end are read through a zero-padded copy.
+ */
+static uint64_t
+bits_get(const unsigned char *ptr, size_t len, size_t bit_offset, unsigned int width, int msb) {
+  const size_t byte_idx = bit_offset >> 3;
+  const unsigned int shift = (unsigned int)(bit_offset & 7);
+  if (len - byte_idx >= 9)
+    return bits_extract(ptr + byte_idx, shift, width, msb);
+
+  unsigned char tmp[9] = { 0 };
+  memcpy(tmp, ptr + byte_idx, len - byte_idx);
+  return bits_extract(tmp, shift, width, msb);
+}
+
+/*
+ * call-seq:
+ *  getBits(bit_offset, width, order: :lsb)
+ *
+ * Reads an unsigned field of +width+ bits, up to 64, starting at bit
+ * +bit_offset+ of the view.
+ *
+ * With +:lsb+ order, bits are numbered like in #getBit, from the least
+ * significant bit of each byte, and the first one is the least significant
+ * bit of the field. This is how DEFLATE packs its fields. With +:msb+
+ * order, bits are numbered from the most significant bit of each byte and
+ * the first one is the most significant bit of the field, as in most
+ * media headers.
+ *
+ * If passed a negative offset, it will be summed with the view size, in
+ * bits.
+ *
+ * Example:
+ *   # The 4 bits version and the 4 bits header length of an IPv4 header
+ *   version = view.getBits(0, 4, order: :msb)
+ *   ihl = view.getBits(4, 4, order: :msb)
+ *
+ * @param order [:lsb, :msb] Optional. Defaults to +:lsb+
+ * @return [Integer]
+ */
+static VALUE
+t_dv_getbits(int argc, VALUE *argv, VALUE self) {
+  VALUE bit_offset;
+  VALUE width;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "2:", &bit_offset, &width, &kwargs);
+
+  const int msb = bits_order_kwarg(kwargs);
+  const unsigned int w = bits_width(width);
+  size_t offset;
+  size_t len;
+  const unsigned char *ptr = bits_field(self, bit_offset, w, 0, &offset, &len);
+  return ULL2NUM(bits_get(ptr, len, offset, w, msb));
+}
+
+/*
+ * call-seq:
+ *  setBits(bit_offset, width, value, order: :lsb)
+ *
+ * Writes +value+ as an unsigned field of +width+ bits, up to 64, starting
+ * at bit +bit_offset+ of the view. The bits around the field are kept.
+ *
+ * Bits are numbered as in #getBits. Values lower than zero will be set to 0
+ * and values that don't fit in +width+ bits will be capped.
+ *
+ * @param order [:lsb, :msb] Optional. Defaults to +:lsb+
+ */
+static VALUE
+t_dv_setbits(int argc, VALUE *argv, VALUE self) {
+  VALUE bit_offset;
+  VALUE width;
+  VALUE value;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "3:", &bit_offset, &width, &value, &kwargs);
+
+  const int msb = bits_order_kwarg(kwargs);
+  const unsigned int w = bits_width(width);
+  uint64_t val = llc_capped_uint64(value);
+  if (val > BITS_MASK(w))
+    val = BITS_MASK(w);
+
+  size_t pos;
+  size_t len;
+  unsigned char *ptr = bits_field(self, bit_offset, w, 1, &pos, &len);
+  for (unsigned int left = w; left > 0;) {
+    unsigned char *p = ptr + (pos >> 3);
+    const unsigned int bit = (unsigned int)(pos & 7);
+    const unsigned int n = 8 - bit < left ? 8 - bit : left;
+    const unsigned int mask = (1u << n) - 1;
+    if (msb) {
+      const unsigned int shift = 8 - bit - n;
+      const unsigned int chunk = (unsigned int)(val >> (left - n)) & mask;
+      *p = (unsigned char)((*p & ~(mask << shift)) | (chunk << shift));
+    } else {
+      const unsigned int chunk = (unsigned int)val & mask;
+      *p = (unsigned char)((*p & ~(mask << bit)) | (chunk << bit));
+      val >>= n;
+    }
+    pos += n;
+    left -= n;
+  }
+  return self;
+}
+
+struct LLC_BitReader {
+  VALUE view;
+  /* Bits read so far, from the start of the view */
+  size_t pos;
+  /* The +cached+ bits that follow +pos+, read ahead from the view */
+  uint64_t cache;
+  unsigned int cached;
+  unsigned char msb;
+};
+
+#define DECLAREBITREADER(o) \
+  struct LLC_BitReader *reader = (struct LLC_BitReader*)rb_check_typeddata((o), &bit_reader_type)
+
+static void
+t_bit_reader_gc_mark(void *ptr) {
+  struct LLC_BitReader *reader = (struct LLC_BitReader*)ptr;
+  if (reader->view)
+    rb_gc_mark_movable(reader->view);
+}
+
+static void
+t_bit_reader_free(void *ptr) {
+  xfree(ptr);
+}
+
+static size_t
+t_bit_reader_memsize(const void *ptr) {
+  return sizeof(struct LLC_BitReader);
+}
+
+static void
+t_bit_reader_compact(void *ptr) {
+  struct LLC_BitReader *reader = (struct LLC_BitReader*)ptr;
+  if (reader->view)
+    reader->view = rb_gc_location(reader->view);
+}
+
+static const rb_data_type_t bit_reader_type = {
+  "ArrayBuffer::BitReader",
+  { t_bit_reader_gc_mark, t_bit_reader_free, t_bit_reader_memsize, t_bit_reader_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE
+t_bit_reader_allocator(VALUE klass) {
+  struct LLC_BitReader *reader;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_BitReader, &bit_reader_type, reader);
+  reader->view = 0;
+  reader->pos = 0;
+  reader->cache = 0;
+  reader->cached = 0;
+  reader->msb = 0;
+  return obj;
+}
+
+static size_t
+bit_reader_length(struct LLC_BitReader *reader) {
+  size_t len;
+  llc_view_bytes(reader->view, &len, NULL, 0);
+  return len * 8;
+}
+
+/*
+ * Reads whole bytes ahead into the cache until it holds more than 56 bits
+ * or the view ends.
+ *
+ * The cache always ends at a byte boundary, except while empty: then it is
+ * refilled from the byte holding +pos+, dropping the bits before it.
+ */
+static void
+bit_reader_fill(struct LLC_BitReader *reader) {
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(reader->view, &len, NULL, 0);
+  size_t byte_idx = (reader->pos + reader->cached) >> 3;
+  unsigned int skip = 0;
+  if (!reader->cached) {
+    reader->cache = 0;
+    skip = (unsigned int)(reader->pos & 7);
+  }
+
+  if (reader->cached == 0 && byte_idx + 8 <= len && !skip) {
+    // Fast path: a whole word at once
+    reader->cache = llc_load_uint(ptr + byte_idx, 8, !reader->msb);
+    reader->cached = 64;
+    return;
+  }
+
+  for (; reader->cached <= 56 && byte_idx < len; byte_idx++) {
+    const uint64_t byte = ptr[byte_idx];
+    if (reader->msb)
+      reader->cache = (reader->cache << 8) | byte;
+    else
+      reader->cache |= byte << reader->cached;
+    reader->cached += 8;
+    if (skip) {
+      // MSB-first leaves the skipped bits above the cached ones
+      if (!reader->msb)
+        reader->cache >>= skip;
+      reader->cached -= skip;
+      skip = 0;
+    }
+  }
+}
+
+/*
+ * Raises EOFError unless +width+ bits are left.
+ */
+static void
+bit_reader_check(struct LLC_BitReader *reader, unsigned int width) {
+  const size_t bits = bit_reader_length(reader);
+  if (reader->pos > bits || width > bits - reader->pos)
+    rb_raise(rb_eEOFError, "%u bits needed at bit %"PRIuSIZE", but only %"PRIuSIZE" available",
+      width, reader->pos, reader->pos > bits ? (size_t)0 : bits - reader->pos);
+}
+
+/*
+ * Takes +width+ bits, from 1 up to the cached ones, from the cache.
+ */
+static uint64_t
+bit_reader_take(struct LLC_BitReader *reader, unsigned int width) {
+  uint64_t val;
+  if (reader->msb) {
+    val = (reader->cache >> (reader->cached - width)) & BITS_MASK(width);
+  } else {
+    val = reader->cache & BITS_MASK(width);
+    reader->cache = width < 64 ? reader->cache >> width : 0;
+  }
+  reader->cached -= width;
+  reader->pos += width;
+  return val;
+}
+
+/*
+ * Reads +width+ bits, up to 56, raising EOFError if fewer are left.
+ */
+static uint64_t
+bit_reader_read(struct LLC_BitReader *reader, unsigned int width, int peek) {
+  if (reader->cached < width)
+    bit_reader_fill(reader);
+  if (reader->cached < width)
+    bit_reader_check(reader, width);
+  if (!peek)
+    return bit_reader_take(reader, width);
+
+  const uint64_t cache = reader->cache;
+  const unsigned int cached = reader->cached;
+  const uint64_t val = bit_reader_take(reader, width);
+  reader->cache = cache;
+  reader->cached = cached;
+  reader->pos -= width;
+  return val;
+}
+
+/*
+ * Reads a field of up to 64 bits. Fields wider than 56 bits are read in two
+ * parts, as the cache holds whole bytes.
+ */
+static uint64_t
+bit_reader_field(struct LLC_BitReader *reader, unsigned int width, int peek) {
+  if (width <= 56)
+    return bit_reader_read(reader, width, peek);
+
+  const size_t pos = reader->pos;
+  bit_reader_check(reader, width);
+
+  uint64_t val;
+  if (reader->msb) {
+    val = bit_reader_read(reader, width - 32, 0) << 32;
+    val |= bit_reader_read(reader, 32, 0);
+  } else {
+    val = bit_reader_read(reader, 32, 0);
+    val |= bit_reader_read(reader, width - 32, 0) << 32;
+  }
+  if (peek) {
+    reader->pos = pos;
+    reader->cached = 0;
+  }
+  return val;
+}
+
+/*
+ * call-seq:
+ *  initialize(source, order: :lsb)
+ *
+ * Creates a reader of bit fields positioned at the start of +source+.
+ *
+ * The reader reads a 64 bits word ahead at a time, and serves fields from
+ * it. Changes to the bytes already read ahead are not seen.
+ *
+ * Example:
+ *   bits = ArrayBuffer::BitReader.new(view, order: :msb)
+ *   sync = bits.read(12)
+ *   id = bits.read(1)
+ *
+ * @param source [DataView, ArrayBuffer]
+ * @param order [:lsb, :msb] Optional. How bits are numbered, as in
+ *   DataView#getBits. Defaults to +:lsb+
+ */
+static VALUE
+t_bit_reader_initialize(int argc, VALUE *argv, VALUE self) {
+  DECLAREBITREADER(self);
+  VALUE source;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "1:", &source, &kwargs);
+
+  const int msb = bits_order_kwarg(kwargs);
+  if (rb_obj_is_kind_of(source, cDataView)) {
+    RB_OBJ_WRITE(self, &reader->view, source);
+  } else if (rb_obj_is_kind_of(source, cArrayBuffer)) {
+    DECLAREBB(source);
+    RB_OBJ_WRITE(self, &reader->view, llc_dv_new(source, 0, bb->size, 0));
+  } else {
+    rb_raise(rb_eTypeError, "expected an ArrayBuffer or a DataView, got %"PRIsVALUE, CLASS_OF(source));
+  }
+
+  reader->pos = 0;
+  reader->cache = 0;
+  reader->cached = 0;
+  reader->msb = (unsigned char)msb;
+  return self;
+}
+
+/*
+ * Reads the next +width+ bits, up to 64, as an unsigned field.
+ *
+ * Raises EOFError, without moving, if fewer bits are left.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bit_reader_read(VALUE self, VALUE width) {
+  DECLAREBITREADER(self);
+  return ULL2NUM(bit_reader_field(reader, bits_width(width), 0));
+}
+
+/*
+ * Returns the next +width+ bits, like #read, without moving past them.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bit_reader_peek(VALUE self, VALUE width) {
+  DECLAREBITREADER(self);
+  return ULL2NUM(bit_reader_field(reader, bits_width(width), 1));
+}
+
+/*
+ * Returns the DataView the reader moves over.
+ *
+ * @return [DataView]
+ */
+static VALUE
+t_bit_reader_view(VALUE self) {
+  DECLAREBITREADER(self);
+  return reader->view;
+}
+
+/*
+ * Returns the current position, in bits from the start of the view.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bit_reader_pos(VALUE self) {
+  DECLAREBITREADER(self);
+  return SIZET2NUM(reader->pos);
+}
+
+/*
+ * Moves the reader to bit +pos+.
+ *
+ * If passed a negative value, it will be summed with the view size, in
+ * bits.
+ *
+ * @param pos [Integer]
+ */
+static VALUE
+t_bit_reader_setpos(VALUE self, VALUE pos) {
+  DECLAREBITREADER(self);
+  const size_t bits = bit_reader_length(reader);
+  ssize_t val = NUM2SSIZET(pos);
+  if (val < 0)
+    val += (ssize_t)bits;
+  if (val < 0 || (size_t)val > bits)
+    rb_raise(rb_eArgError, "position out of bounds: %"PRIdSIZE, val);
+  reader->pos = (size_t)val;
+  reader->cached = 0;
+  return pos;
+}
+
+/*
+ * Moves the reader +count+ bits forward.
+ *
+ * @param count [Integer]
+ */
+static VALUE
+t_bit_reader_skip(VALUE self, VALUE count) {
+  DECLAREBITREADER(self);
+  const ssize_t n = NUM2SSIZET(count);
+  if (n < 0)
+    rb_raise(rb_eArgError, "count must not be negative: %"PRIdSIZE, n);
+  if (!n)
+    return self;
+  if ((size_t)n <= reader->cached) {
+    bit_reader_take(reader, (unsigned int)n);
+    return self;
+  }
+
+  const size_t bits = bit_reader_length(reader);
+  if (reader->pos > bits || (size_t)n > bits - reader->pos)
+    rb_raise(rb_eEOFError, "can't skip %"PRIdSIZE" bits from bit %"PRIuSIZE, n, reader->pos);
+  reader->pos += (size_t)n;
+  reader->cached = 0;
+  return self;
+}
+
+/*
+ * Moves the reader to the next byte boundary, unless it is already at one.
+ */
+static VALUE
+t_bit_reader_align(VALUE self) {
+  DECLAREBITREADER(self);
+  const unsigned int n = (unsigned int)((8 - (reader->pos & 7)) & 7);
+  if (!n)
+    return self;
+  if (n <= reader->cached) {
+    bit_reader_take(reader, n);
+  } else {
+    reader->pos += n;
+    reader->cached = 0;
+  }
+  return self;
+}
+
+/*
+ * Returns how many bits are left between the position and the end of the
+ * view.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_bit_reader_remaining(VALUE self) {
+  DECLAREBITREADER(self);
+  const size_t bits = bit_reader_length(reader);
+  return SIZET2NUM(reader->pos >= bits ? 0 : bits - reader->pos);
+}
+
+/*
+ * Returns whether the reader reached the end of the view.
+ *
+ * @return [Boolean]
+ */
+static VALUE
+t_bit_reader_eof_p(VALUE self) {
+  DECLAREBITREADER(self);
+  return reader->pos >= bit_reader_length(reader) ? Qtrue : Qfalse;
+}
+
+void
+Init_bits() {
+  idOrder = rb_intern("order");
+  idMsb = rb_intern("msb");
+  idLsb = rb_intern("lsb");
+
+  rb_define_method(cDataView, "getBits", t_dv_getbits, -1);
+  rb_define_method(cDataView, "setBits", t_dv_setbits, -1);
+
+  cBitReader = rb_define_class_under(cArrayBuffer, "BitReader", rb_cObject);
+  rb_define_alloc_func(cBitReader, t_bit_reader_allocator);
+  rb_define_method(cBitReader, "initialize", t_bit_reader_initialize, -1);
+  rb_define_method(cBitReader, "read", t_bit_reader_read, 1);
+  rb_define_method(cBitReader, "peek", t_bit_reader_peek, 1);
+  rb_define_method(cBitReader, "view", t_bit_reader_view, 0);
+  rb_define_method(cBitReader, "pos", t_bit_reader_pos, 0);
+  rb_define_method(cBitReader, "pos=", t_bit_reader_setpos, 1);
+  rb_define_method(cBitReader, "skip", t_bit_reader_skip, 1);
+  rb_define_method(cBitReader, "align", t_bit_reader_align, 0);
+  rb_define_method(cBitReader, "remaining", t_bit_reader_remaining, 0);
+  rb_define_method(cBitReader, "eof?", t_bit_reader_eof_p, 0);
+}
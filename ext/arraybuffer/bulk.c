@@ -0,0 +1,392 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLC_SWAP_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static ID idEndianess = Qundef;
+
+#ifdef LLC_SWAP_SSSE3
+/* Whether the CPU has SSSE3 shuffles, detected at load time */
+static int swap_ssse3 = 0;
+#endif
+
+/*
+ * Converts a position of a range, giving +fallback+ for nil. Converting may
+ * run Ruby code that resizes the buffer, so it must happen before its bytes
+ * are taken.
+ */
+static ssize_t
+range_arg(VALUE index, ssize_t fallback) {
+  return NIL_P(index) ? fallback : NUM2SSIZET(index);
+}
+
+/*
+ * Resolves a position converted by range_arg over +len+ bytes, the way
+ * TypedArray#fill does in JavaScript: negative values are summed with
+ * +len+, and the result is clamped between zero and +len+.
+ */
+static size_t
+range_clamp(ssize_t val, size_t len) {
+  if (val < 0) {
+    val += (ssize_t)len;
+    if (val < 0)
+      val = 0;
+  }
+  return (size_t)val > len ? len : (size_t)val;
+}
+
+struct fill_args {
+  unsigned char *ptr;
+  size_t len;
+  unsigned char pattern[8];
+  size_t width;
+};
+
+static void *
+fill_kernel(void *ptr) {
+  struct fill_args *args = (struct fill_args*)ptr;
+  if (args->width == 1) {
+    memset(args->ptr, args->pattern[0], args->len);
+    return NULL;
+  }
+
+  // Writes one element, then keeps doubling the filled prefix, so the bulk
+  // of the work is done by memcpy
+  memcpy(args->ptr, args->pattern, args->width);
+  for (size_t done = args->width; done < args->len; done *= 2)
+    memcpy(args->ptr + done, args->ptr, done < args->len - done ? done : args->len - done);
+  return NULL;
+}
+
+static VALUE
+bulk_fill(int argc, VALUE *argv, VALUE self, int type) {
+  VALUE value;
+  VALUE start;
+  VALUE end;
+  VALUE kwargs;
+  VALUE endianess = Qundef;
+  static ID keyword_ids[] = { 0 };
+
+  if (type == LLC_U8) {
+    rb_scan_args(argc, argv, "12", &value, &start, &end);
+  } else {
+    rb_scan_args(argc, argv, "12:", &value, &start, &end, &kwargs);
+    if (!keyword_ids[0]) {
+      keyword_ids[0] = idEndianess;
+    }
+    if (!NIL_P(kwargs))
+      rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+  }
+
+  const size_t width = llc_type_widths[type];
+  const uint64_t bits = llc_encode_value(value, type);
+  const ssize_t start_arg = range_arg(start, 0);
+  const ssize_t end_arg = range_arg(end, SSIZE_MAX);
+  const int endianess_arg = endianess != Qundef ? llc_parse_endianess(endianess) : -1;
+
+  size_t len;
+  int little;
+  unsigned char *ptr = llc_view_bytes(self, &len, &little, 1);
+  if (endianess_arg >= 0)
+    little = endianess_arg;
+
+  const size_t from = range_clamp(start_arg, len);
+  const size_t to = range_clamp(end_arg, len);
+  if (to <= from)
+    return self;
+
+  struct fill_args args;
+  args.ptr = ptr + from;
+  args.len = (to - from) / width * width;
+  args.width = width;
+  llc_store_uint(args.pattern, (unsigned int)width, little, bits);
+  if (args.len)
+    llc_run_kernel(args.len, fill_kernel, &args, self, Qnil);
+  return self;
+}
+
+/*
+ * call-seq:
+ *  fill(value, start = 0, end = size)
+ *
+ * Sets every byte from +start+ up to, but not including, +end+ to +value+.
+ *
+ * Positions work like in JavaScript's TypedArray#fill: negative ones are
+ * counted from the end, and all are clamped to the size. On a DataView
+ * they are relative to the view.
+ *
+ * Values lower than zero will be set to 0 and values greater than 255
+ * will be capped.
+ *
+ * Example:
+ *   buffer.fill(0)          # zero the whole buffer
+ *   view.fill(0xFF, 16, -16) # all but the first and last 16 bytes
+ *
+ * @return self
+ */
+static VALUE
+t_fill(int argc, VALUE *argv, VALUE self) {
+  return bulk_fill(argc, argv, self, LLC_U8);
+}
+
+/*
+ * call-seq:
+ *  fill_u16(value, start = 0, end = size, endianess: nil)
+ *
+ * Writes +value+ as consecutive +unsigned short+s from byte +start+ up to
+ * byte +end+, like #fill does for bytes. If the range is not a multiple of
+ * 2 bytes long, the bytes left at its end are not changed.
+ *
+ * @param endianess [:big, :little] Optional. Defaults to the endianess of
+ *   the DataView, or big endian for an ArrayBuffer
+ * @return self
+ */
+static VALUE
+t_fill_u16(int argc, VALUE *argv, VALUE self) {
+  return bulk_fill(argc, argv, self, LLC_U16);
+}
+
+/*
+ * call-seq:
+ *  fill_u32(value, start = 0, end = size, endianess: nil)
+ *
+ * Writes +value+ as consecutive 4 bytes long unsigned integers from byte
+ * +start+ up to byte +end+, like #fill_u16 does.
+ *
+ * @return self
+ */
+static VALUE
+t_fill_u32(int argc, VALUE *argv, VALUE self) {
+  return bulk_fill(argc, argv, self, LLC_U32);
+}
+
+/*
+ * call-seq:
+ *  copy_within(target, start = 0, end = size)
+ *
+ * Copies the bytes from +start+ up to, but not including, +end+ to
+ * +target+, within the same buffer or view. The ranges may overlap.
+ *
+ * Positions work like in JavaScript's TypedArray#copyWithin. The copy
+ * stops at the end of the buffer or view.
+ *
+ * Example:
+ *   # Moves the unread tail of a ring-style buffer to its start
+ *   buffer.copy_within(0, read_pos, write_pos)
+ *
+ * @return self
+ */
+static VALUE
+t_copy_within(int argc, VALUE *argv, VALUE self) {
+  VALUE target;
+  VALUE start;
+  VALUE end;
+  rb_scan_args(argc, argv, "12", &target, &start, &end);
+  const ssize_t target_arg = range_arg(target, 0);
+  const ssize_t start_arg = range_arg(start, 0);
+  const ssize_t end_arg = range_arg(end, SSIZE_MAX);
+
+  size_t len;
+  unsigned char *ptr = llc_view_bytes(self, &len, NULL, 1);
+  const size_t to = range_clamp(target_arg, len);
+  const size_t from = range_clamp(start_arg, len);
+  const size_t from_end = range_clamp(end_arg, len);
+  if (from_end <= from || to == len)
+    return self;
+
+  size_t count = from_end - from;
+  if (count > len - to)
+    count = len - to;
+  llc_copy_bytes(ptr + to, ptr + from, count, self, Qnil);
+  return self;
+}
+
+struct swap_args {
+  unsigned char *ptr;
+  size_t len;
+  size_t width;
+};
+
+static void
+swap_scalar(unsigned char *p, size_t len, size_t width) {
+  switch (width) {
+  case 2:
+    for (; len; p += 2, len -= 2) {
+      uint16_t v;
+      memcpy(&v, p, 2);
+      v = __builtin_bswap16(v);
+      memcpy(p, &v, 2);
+    }
+    break;
+  case 4:
+    for (; len; p += 4, len -= 4) {
+      uint32_t v;
+      memcpy(&v, p, 4);
+      v = __builtin_bswap32(v);
+      memcpy(p, &v, 4);
+    }
+    break;
+  default:
+    for (; len; p += 8, len -= 8) {
+      uint64_t v;
+      memcpy(&v, p, 8);
+      v = __builtin_bswap64(v);
+      memcpy(p, &v, 8);
+    }
+    break;
+  }
+}
+
+#ifdef LLC_SWAP_SSSE3
+/*
+ * Reverses the bytes of every element in 16 bytes blocks with a single
+ * shuffle, leaving what does not fill a block to the scalar loop.
+ */
+__attribute__((target("ssse3")))
+static void
+swap_ssse3_blocks(unsigned char *p, size_t len, size_t width) {
+  __m128i mask;
+  if (width == 2)
+    mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  else if (width == 4)
+    mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  else
+    mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+  for (; len >= 64; p += 64, len -= 64) {
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+    __m128i d = _mm_loadu_si128((const __m128i*)(p + 48));
+    _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(a, mask));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_shuffle_epi8(b, mask));
+    _mm_storeu_si128((__m128i*)(p + 32), _mm_shuffle_epi8(c, mask));
+    _mm_storeu_si128((__m128i*)(p + 48), _mm_shuffle_epi8(d, mask));
+  }
+  for (; len >= 16; p += 16, len -= 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(a, mask));
+  }
+  swap_scalar(p, len, width);
+}
+#endif
+
+static void *
+swap_kernel(void *ptr) {
+  struct swap_args *args = (struct swap_args*)ptr;
+#ifdef LLC_SWAP_SSSE3
+  if (swap_ssse3) {
+    swap_ssse3_blocks(args->ptr, args->len, args->width);
+    return NULL;
+  }
+#endif
+  swap_scalar(args->ptr, args->len, args->width);
+  return NULL;
+}
+
+static VALUE
+bulk_swap(int argc, VALUE *argv, VALUE self, size_t width) {
+  VALUE start;
+  VALUE end;
+  rb_scan_args(argc, argv, "02", &start, &end);
+  const ssize_t start_arg = range_arg(start, 0);
+  const ssize_t end_arg = range_arg(end, SSIZE_MAX);
+
+  size_t len;
+  unsigned char *ptr = llc_view_bytes(self, &len, NULL, 1);
+  const size_t from = range_clamp(start_arg, len);
+  const size_t to = range_clamp(end_arg, len);
+  if (to <= from)
+    return self;
+  if ((to - from) % width)
+    rb_raise(rb_eArgError, "range of %"PRIuSIZE" bytes is not a multiple of %"PRIuSIZE" bytes",
+      to - from, width);
+
+  struct swap_args args = { ptr + from, to - from, width };
+  llc_run_kernel(args.len, swap_kernel, &args, self, Qnil);
+  return self;
+}
+
+/*
+ * call-seq:
+ *  swap16!(start = 0, end = size)
+ *
+ * Reverses, in place, the byte order of every 2 bytes long element from
+ * byte +start+ up to byte +end+, converting them between big and little
+ * endian.
+ *
+ * Positions work like in #fill. The range must be a multiple of 2 bytes
+ * long.
+ *
+ * Example:
+ *   # Big endian samples, read as little endian afterwards
+ *   view.swap16!
+ *   DataView.new(buffer, endianess: :little).getU16(0)
+ *
+ * @return self
+ */
+static VALUE
+t_swap16_bang(int argc, VALUE *argv, VALUE self) {
+  return bulk_swap(argc, argv, self, 2);
+}
+
+/*
+ * call-seq:
+ *  swap32!(start = 0, end = size)
+ *
+ * Reverses, in place, the byte order of every 4 bytes long element in the
+ * range, like #swap16! does.
+ *
+ * @return self
+ */
+static VALUE
+t_swap32_bang(int argc, VALUE *argv, VALUE self) {
+  return bulk_swap(argc, argv, self, 4);
+}
+
+/*
+ * call-seq:
+ *  swap64!(start = 0, end = size)
+ *
+ * Reverses, in place, the byte order of every 8 bytes long element in the
+ * range, like #swap16! does.
+ *
+ * @return self
+ */
+static VALUE
+t_swap64_bang(int argc, VALUE *argv, VALUE self) {
+  return bulk_swap(argc, argv, self, 8);
+}
+
+static void
+define_bulk_methods(VALUE klass) {
+  rb_define_method(klass, "fill", t_fill, -1);
+  rb_define_method(klass, "fill_u16", t_fill_u16, -1);
+  rb_define_method(klass, "fill_u32", t_fill_u32, -1);
+  rb_define_method(klass, "copy_within", t_copy_within, -1);
+  rb_define_method(klass, "swap16!", t_swap16_bang, -1);
+  rb_define_method(klass, "swap32!", t_swap32_bang, -1);
+  rb_define_method(klass, "swap64!", t_swap64_bang, -1);
+}
+
+void
+Init_bulk() {
+  idEndianess = rb_intern("endianess");
+
+#ifdef LLC_SWAP_SSSE3
+  __builtin_cpu_init();
+  swap_ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+  define_bulk_methods(cArrayBuffer);
+  define_bulk_methods(cDataView);
+}
@@ -0,0 +1,48 @@
+#ifndef LLC_BYTEORDER_H
+#define LLC_BYTEORDER_H
+
+#include <stdint.h>
+
+/*
+ * Reads an unsigned integer of +width+ bytes (1 to 8) from +p+.
+ *
+ * Callers pass +width+ and +little+ as constants wherever possible so the
+ * compiler can unroll the loop into a plain load.
+ */
+static inline uint64_t
+llc_load_uint(const unsigned char *p, unsigned int width, int little) {
+  uint64_t val = 0;
+  if (little) {
+    for (unsigned int i = width; i > 0; i--)
+      val = (val << 8) | p[i - 1];
+  } else {
+    for (unsigned int i = 0; i < width; i++)
+      val = (val << 8) | p[i];
+  }
+  return val;
+}
+
+/*
+ * Writes the lower +width+ bytes (1 to 8) of +val+ to +p+.
+ */
+static inline void
+llc_store_uint(unsigned char *p, unsigned int width, int little, uint64_t val) {
+  if (little) {
+    for (unsigned int i = 0; i < width; i++, val >>= 8)
+      p[i] = (unsigned char)(val & 0xFF);
+  } else {
+    for (unsigned int i = width; i > 0; i--, val >>= 8)
+      p[i - 1] = (unsigned char)(val & 0xFF);
+  }
+}
+
+/*
+ * Sign-extends the lower +width+ bytes of +val+.
+ */
+static inline int64_t
+llc_sign_extend(uint64_t val, unsigned int width) {
+  const unsigned int shift = 64 - width * 8;
+  return (int64_t)(val << shift) >> shift;
+}
+
+#endif
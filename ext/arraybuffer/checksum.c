@@ -0,0 +1,384 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLC_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define LLC_CRC32C_ARM 1
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+/* Reflected polynomials of CRC-32 (as in zlib) and CRC-32C (Castagnoli) */
+#define CRC32_POLY 0xEDB88320u
+#define CRC32C_POLY 0x82F63B78u
+
+/*
+ * Slicing-by-8 tables: table[0] is the classic byte-at-a-time table, and
+ * table[k] advances a CRC over a byte followed by k zero bytes.
+ */
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+
+static void
+crc_init_table(uint32_t table[8][256], uint32_t poly) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (poly & (0u - (crc & 1)));
+    table[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int k = 1; k < 8; k++)
+      table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+  }
+}
+
+static uint32_t
+crc_slice8(const uint32_t table[8][256], uint32_t crc, const unsigned char *p, size_t len) {
+  crc = ~crc;
+  while (len >= 8) {
+    // Bytes are combined one by one, so the result does not depend on the
+    // host byte order
+    const uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+      table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+      table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+  return ~crc;
+}
+
+#if defined(LLC_CRC32C_SSE42) || defined(LLC_CRC32C_ARM)
+/* Whether the CPU has CRC-32C instructions, detected at load time */
+static int crc32c_hardware = 0;
+#endif
+
+#ifdef LLC_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+  crc = ~crc;
+  while (len && ((uintptr_t)p & 7)) {
+    crc = _mm_crc32_u8(crc, *p++);
+    len--;
+  }
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = (uint32_t)crc64;
+#endif
+  for (; len >= 4; p += 4, len -= 4) {
+    uint32_t word;
+    memcpy(&word, p, 4);
+    crc = _mm_crc32_u32(crc, word);
+  }
+  while (len--)
+    crc = _mm_crc32_u8(crc, *p++);
+  return ~crc;
+}
+
+static int
+crc32c_detect_hardware(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(LLC_CRC32C_ARM)
+__attribute__((target("+crc")))
+static uint32_t
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+  crc = ~crc;
+  while (len && ((uintptr_t)p & 7)) {
+    crc = __crc32cb(crc, *p++);
+    len--;
+  }
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    crc = __crc32cd(crc, word);
+  }
+  while (len--)
+    crc = __crc32cb(crc, *p++);
+  return ~crc;
+}
+
+static int
+crc32c_detect_hardware(void) {
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif
+
+static uint32_t
+crc32c(uint32_t crc, const unsigned char *p, size_t len) {
+#if defined(LLC_CRC32C_SSE42) || defined(LLC_CRC32C_ARM)
+  if (crc32c_hardware)
+    return crc32c_hw(crc, p, len);
+#endif
+  return crc_slice8(crc32c_table, crc, p, len);
+}
+
+/* Largest n such that 255n(n+1)/2 + (n+1)(65521-1) fits in 32 bits */
+#define ADLER_NMAX 5552
+#define ADLER_MOD 65521u
+
+static uint32_t
+adler32(uint32_t adler, const unsigned char *p, size_t len) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+  while (len) {
+    size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+    len -= n;
+    while (n--) {
+      a += *p++;
+      b += a;
+    }
+    a %= ADLER_MOD;
+    b %= ADLER_MOD;
+  }
+  return (b << 16) | a;
+}
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t
+xxh_rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+xxh_read64(const unsigned char *p) {
+  return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+    (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint32_t
+xxh_read32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t
+xxh64_round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl64(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t
+xxh64_merge_round(uint64_t acc, uint64_t val) {
+  acc ^= xxh64_round(0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/*
+ * XXH64, reading input as little endian so hashes match the reference
+ * implementation on every host.
+ */
+static uint64_t
+xxhash64(uint64_t seed, const unsigned char *p, size_t len) {
+  const unsigned char *end = p + len;
+  uint64_t h;
+
+  if (len >= 32) {
+    // Four independent lanes, which the CPU runs in parallel
+    uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    uint64_t v2 = seed + XXH_PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME64_1;
+    const unsigned char *limit = end - 32;
+    do {
+      v1 = xxh64_round(v1, xxh_read64(p));
+      v2 = xxh64_round(v2, xxh_read64(p + 8));
+      v3 = xxh64_round(v3, xxh_read64(p + 16));
+      v4 = xxh64_round(v4, xxh_read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+    h = xxh64_merge_round(h, v1);
+    h = xxh64_merge_round(h, v2);
+    h = xxh64_merge_round(h, v3);
+    h = xxh64_merge_round(h, v4);
+  } else {
+    h = seed + XXH_PRIME64_5;
+  }
+
+  h += (uint64_t)len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh64_round(0, xxh_read64(p));
+    h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+    h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (uint64_t)(*p) * XXH_PRIME64_5;
+    h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+enum checksum_algorithm {
+  CHECKSUM_CRC32,
+  CHECKSUM_CRC32C,
+  CHECKSUM_ADLER32,
+  CHECKSUM_XXHASH64
+};
+
+struct checksum_args {
+  const unsigned char *ptr;
+  size_t len;
+  int algorithm;
+  uint64_t value;
+};
+
+static void *
+checksum_kernel(void *ptr) {
+  struct checksum_args *args = (struct checksum_args*)ptr;
+  switch (args->algorithm) {
+  case CHECKSUM_CRC32:
+    args->value = crc_slice8(crc32_table, (uint32_t)args->value, args->ptr, args->len);
+    break;
+  case CHECKSUM_CRC32C:
+    args->value = crc32c((uint32_t)args->value, args->ptr, args->len);
+    break;
+  case CHECKSUM_ADLER32:
+    args->value = adler32((uint32_t)args->value, args->ptr, args->len);
+    break;
+  default:
+    args->value = xxhash64(args->value, args->ptr, args->len);
+    break;
+  }
+  return NULL;
+}
+
+static VALUE
+checksum(int argc, VALUE *argv, VALUE self, int algorithm, uint64_t initial) {
+  VALUE start;
+  rb_scan_args(argc, argv, "01", &start);
+
+  struct checksum_args args;
+  args.algorithm = algorithm;
+  if (NIL_P(start))
+    args.value = initial;
+  else if (algorithm == CHECKSUM_XXHASH64)
+    args.value = NUM2ULL(start);
+  else
+    args.value = NUM2UINT(start);
+
+  args.ptr = llc_view_bytes(self, &args.len, NULL, 0);
+  llc_run_kernel(args.len, checksum_kernel, &args, self, Qnil);
+  return algorithm == CHECKSUM_XXHASH64 ? ULL2NUM(args.value) : UINT2NUM((uint32_t)args.value);
+}
+
+/*
+ * call-seq:
+ *  crc32(crc = 0)
+ *
+ * Returns the CRC-32 of the bytes, as computed by Zlib.crc32.
+ *
+ * On a DataView only the bytes the view can see are hashed, in place.
+ *
+ * Example:
+ *   view.crc32 == Zlib.crc32(view.to_s) # true, without the copy
+ *
+ * @param crc [Integer] Optional. The CRC of preceding data, to checksum a
+ *   stream in parts
+ * @return [Integer]
+ */
+static VALUE
+t_crc32(int argc, VALUE *argv, VALUE self) {
+  return checksum(argc, argv, self, CHECKSUM_CRC32, 0);
+}
+
+/*
+ * call-seq:
+ *  crc32c(crc = 0)
+ *
+ * Returns the CRC-32C (Castagnoli) of the bytes, as used by iSCSI, ext4 or
+ * Kafka.
+ *
+ * Uses the CRC instructions of SSE 4.2 or ARMv8 when the CPU has them.
+ *
+ * @param crc [Integer] Optional. The CRC of preceding data
+ * @return [Integer]
+ */
+static VALUE
+t_crc32c(int argc, VALUE *argv, VALUE self) {
+  return checksum(argc, argv, self, CHECKSUM_CRC32C, 0);
+}
+
+/*
+ * call-seq:
+ *  adler32(adler = 1)
+ *
+ * Returns the Adler-32 checksum of the bytes, as computed by Zlib.adler32.
+ *
+ * @param adler [Integer] Optional. The checksum of preceding data
+ * @return [Integer]
+ */
+static VALUE
+t_adler32(int argc, VALUE *argv, VALUE self) {
+  return checksum(argc, argv, self, CHECKSUM_ADLER32, 1);
+}
+
+/*
+ * call-seq:
+ *  xxhash64(seed = 0)
+ *
+ * Returns the 64 bits xxHash (XXH64) of the bytes.
+ *
+ * @param seed [Integer] Optional
+ * @return [Integer]
+ */
+static VALUE
+t_xxhash64(int argc, VALUE *argv, VALUE self) {
+  return checksum(argc, argv, self, CHECKSUM_XXHASH64, 0);
+}
+
+static void
+define_checksum_methods(VALUE klass) {
+  rb_define_method(klass, "crc32", t_crc32, -1);
+  rb_define_method(klass, "crc32c", t_crc32c, -1);
+  rb_define_method(klass, "adler32", t_adler32, -1);
+  rb_define_method(klass, "xxhash64", t_xxhash64, -1);
+}
+
+void
+Init_checksum() {
+  crc_init_table(crc32_table, CRC32_POLY);
+  crc_init_table(crc32c_table, CRC32C_POLY);
+#if defined(LLC_CRC32C_SSE42) || defined(LLC_CRC32C_ARM)
+  crc32c_hardware = crc32c_detect_hardware();
+#endif
+
+  define_checksum_methods(cArrayBuffer);
+  define_checksum_methods(cDataView);
+}
@@ -0,0 +1,515 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLC_CODEC_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static ID idUrlsafe = Qundef;
+static ID idPadding = Qundef;
+
+#ifdef LLC_CODEC_SSSE3
+/* Whether the CPU has SSSE3 shuffles, detected at load time */
+static int codec_ssse3 = 0;
+#endif
+
+#define CODEC_INVALID 0xFF
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char base64_alphabets[2][65] = {
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+/* Both digits of every byte, and the value of every digit or CODEC_INVALID */
+static char hex_pairs[256][2];
+static unsigned char hex_values[256];
+
+/*
+ * Both characters of every 12 bits, so 3 bytes encode with two lookups, and
+ * the value of every character or CODEC_INVALID, for each alphabet.
+ */
+static char base64_pairs[2][4096][2];
+static unsigned char base64_values[2][256];
+
+struct codec_args {
+  const unsigned char *src;
+  size_t len;
+  unsigned char *dst;
+  int urlsafe;
+  int padding;
+  /* Index of the first invalid character, or SIZE_MAX */
+  size_t error;
+};
+
+#ifdef LLC_CODEC_SSSE3
+/*
+ * Encodes 16 bytes at a time, looking both nibbles up among the digits
+ * with a shuffle, and returns how many bytes are left to the scalar loop.
+ */
+__attribute__((target("ssse3")))
+static size_t
+hex_encode_ssse3(const unsigned char *src, unsigned char *dst, size_t len) {
+  const __m128i digits = _mm_loadu_si128((const __m128i*)hex_digits);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  for (; len >= 16; src += 16, dst += 32, len -= 16) {
+    const __m128i bytes = _mm_loadu_si128((const __m128i*)src);
+    const __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+    const __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, nibble));
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi8(high, low));
+  }
+  return len;
+}
+
+/*
+ * Turns 16 characters into their digit values, setting +valid+ to whether
+ * they all are hex digits.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i
+hex_values_ssse3(__m128i chars, int *valid) {
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  // Unsigned comparisons, as signed ones of values shifted by 0x80
+  const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  const __m128i digit_mask = _mm_cmplt_epi8(_mm_xor_si128(digit, bias), _mm_set1_epi8((char)(0x80 + 10)));
+  const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  const __m128i letter_mask = _mm_cmplt_epi8(_mm_xor_si128(letter, bias), _mm_set1_epi8((char)(0x80 + 6)));
+  *valid = _mm_movemask_epi8(_mm_or_si128(digit_mask, letter_mask)) == 0xFFFF;
+  return _mm_or_si128(_mm_and_si128(digit_mask, digit),
+    _mm_and_si128(letter_mask, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+/*
+ * Decodes 32 digits at a time into 16 bytes, merging every pair with a
+ * multiply-add. Stops before the first block holding anything else, and
+ * returns how many digits are left to the scalar loop.
+ */
+__attribute__((target("ssse3")))
+static size_t
+hex_decode_ssse3(const unsigned char *src, unsigned char *dst, size_t len) {
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  for (; len >= 32; src += 32, dst += 16, len -= 32) {
+    int valid_a;
+    int valid_b;
+    const __m128i a = hex_values_ssse3(_mm_loadu_si128((const __m128i*)src), &valid_a);
+    const __m128i b = hex_values_ssse3(_mm_loadu_si128((const __m128i*)(src + 16)), &valid_b);
+    if (!valid_a || !valid_b)
+      break;
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(_mm_maddubs_epi16(a, weights), _mm_maddubs_epi16(b, weights)));
+  }
+  return len;
+}
+#endif
+
+static void *
+hex_encode_kernel(void *ptr) {
+  struct codec_args *args = (struct codec_args*)ptr;
+  const unsigned char *src = args->src;
+  unsigned char *dst = args->dst;
+  // Locals, since stores through the bytes could otherwise alias args
+  const size_t len = args->len;
+  size_t i = 0;
+#ifdef LLC_CODEC_SSSE3
+  if (codec_ssse3)
+    i = len - hex_encode_ssse3(src, dst, len);
+#endif
+  for (; i < len; i++)
+    memcpy(dst + i * 2, hex_pairs[src[i]], 2);
+  return NULL;
+}
+
+static void *
+hex_decode_kernel(void *ptr) {
+  struct codec_args *args = (struct codec_args*)ptr;
+  const unsigned char *src = args->src;
+  unsigned char *dst = args->dst;
+  const size_t len = args->len;
+  size_t i = 0;
+#ifdef LLC_CODEC_SSSE3
+  if (codec_ssse3)
+    i = (len - hex_decode_ssse3(src, dst, len)) / 2;
+#endif
+  for (; i < len / 2; i++) {
+    const unsigned int high = hex_values[src[i * 2]];
+    const unsigned int low = hex_values[src[i * 2 + 1]];
+    if ((high | low) & 0x80) {
+      args->error = i * 2 + (high & 0x80 ? 0 : 1);
+      return NULL;
+    }
+    dst[i] = (unsigned char)(high << 4 | low);
+  }
+  return NULL;
+}
+
+static size_t
+base64_encoded_size(size_t len, int padding) {
+  if (padding)
+    return (len + 2) / 3 * 4;
+  return len / 3 * 4 + (len % 3 ? len % 3 + 1 : 0);
+}
+
+static void *
+base64_encode_kernel(void *ptr) {
+  struct codec_args *args = (struct codec_args*)ptr;
+  const unsigned char *src = args->src;
+  unsigned char *dst = args->dst;
+  const char (*pairs)[2] = base64_pairs[args->urlsafe];
+  const char *alphabet = base64_alphabets[args->urlsafe];
+  const size_t len = args->len;
+  size_t i = 0;
+
+  for (; i + 3 <= len; i += 3, dst += 4) {
+    const uint32_t group = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+    memcpy(dst, pairs[group >> 12], 2);
+    memcpy(dst + 2, pairs[group & 0xFFF], 2);
+  }
+
+  const size_t rest = len - i;
+  if (rest) {
+    const uint32_t group = (uint32_t)src[i] << 16 | (rest > 1 ? (uint32_t)src[i + 1] << 8 : 0);
+    *dst++ = (unsigned char)alphabet[group >> 18];
+    *dst++ = (unsigned char)alphabet[(group >> 12) & 0x3F];
+    if (rest > 1)
+      *dst++ = (unsigned char)alphabet[(group >> 6) & 0x3F];
+    else if (args->padding)
+      *dst++ = '=';
+    if (args->padding)
+      *dst++ = '=';
+  }
+  return NULL;
+}
+
+/*
+ * Returns the index of the first invalid character among the +len+ ones
+ * at +src+, which are known to hold one.
+ */
+static size_t
+base64_invalid_at(const unsigned char *values, const unsigned char *src, size_t len) {
+  size_t i = 0;
+  while (i < len && values[src[i]] != CODEC_INVALID)
+    i++;
+  return i;
+}
+
+/*
+ * Decodes +len+ characters, without padding. A trailing group of 2 or 3
+ * characters must leave its unused low bits clear.
+ */
+static void *
+base64_decode_kernel(void *ptr) {
+  struct codec_args *args = (struct codec_args*)ptr;
+  const unsigned char *values = base64_values[args->urlsafe];
+  const unsigned char *src = args->src;
+  unsigned char *dst = args->dst;
+  const size_t len = args->len;
+  size_t i = 0;
+
+  for (; i + 4 <= len; i += 4, dst += 3) {
+    const unsigned int a = values[src[i]], b = values[src[i + 1]];
+    const unsigned int c = values[src[i + 2]], d = values[src[i + 3]];
+    if ((a | b | c | d) & 0x80) {
+      args->error = i + base64_invalid_at(values, src + i, 4);
+      return NULL;
+    }
+    const uint32_t group = a << 18 | b << 12 | c << 6 | d;
+    dst[0] = (unsigned char)(group >> 16);
+    dst[1] = (unsigned char)(group >> 8);
+    dst[2] = (unsigned char)group;
+  }
+
+  const size_t rest = len - i;
+  if (rest) {
+    const unsigned int a = values[src[i]], b = values[src[i + 1]];
+    const unsigned int c = rest > 2 ? values[src[i + 2]] : 0;
+    if ((a | b | c) & 0x80) {
+      args->error = i + base64_invalid_at(values, src + i, rest);
+      return NULL;
+    }
+    const uint32_t group = a << 18 | b << 12 | c << 6;
+    if (group & (rest > 2 ? 0xFF : 0xFFFF)) {
+      args->error = i + rest - 1;
+      return NULL;
+    }
+    dst[0] = (unsigned char)(group >> 16);
+    if (rest > 2)
+      dst[1] = (unsigned char)(group >> 8);
+  }
+  return NULL;
+}
+
+static void
+codec_kwargs(VALUE kwargs, int *urlsafe, int *padding) {
+  VALUE options[2] = { Qundef, Qundef };
+  static ID keyword_ids[] = { 0, 0 };
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idUrlsafe;
+    keyword_ids[1] = idPadding;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, padding ? 2 : 1, options);
+  *urlsafe = options[0] != Qundef && RTEST(options[0]);
+  if (padding)
+    *padding = options[1] == Qundef || RTEST(options[1]);
+}
+
+static VALUE
+codec_encode(VALUE self, int base64, int urlsafe, int padding) {
+  struct codec_args args;
+  memset(&args, 0, sizeof(args));
+  args.urlsafe = urlsafe;
+  args.padding = padding;
+  llc_view_bytes(self, &args.len, NULL, 0);
+  if (args.len > LONG_MAX / 2)
+    rb_raise(rb_eArgError, "too many bytes to encode: %"PRIuSIZE, args.len);
+
+  const size_t size = base64 ? base64_encoded_size(args.len, padding) : args.len * 2;
+  VALUE str = rb_usascii_str_new(NULL, (long)size);
+  // Allocating may have run GC, but not Ruby code, so the bytes are intact
+  args.src = llc_view_bytes(self, &args.len, NULL, 0);
+  args.dst = (unsigned char*)RSTRING_PTR(str);
+  llc_run_kernel(args.len, base64 ? base64_encode_kernel : hex_encode_kernel, &args, self, Qnil);
+  return str;
+}
+
+/*
+ * Checks the characters of +string+ and returns how many bytes they decode
+ * to, leaving the characters to decode in +args+.
+ */
+static size_t
+codec_decoded_size(VALUE string, int base64, struct codec_args *args) {
+  args->src = (const unsigned char*)RSTRING_PTR(string);
+  args->len = (size_t)RSTRING_LEN(string);
+  args->error = SIZE_MAX;
+
+  if (!base64) {
+    if (args->len % 2)
+      rb_raise(rb_eArgError, "odd number of hex digits: %"PRIuSIZE, args->len);
+    return args->len / 2;
+  }
+
+  // Padding is optional, but when present it must complete the last group
+  if (args->len % 4 == 0) {
+    for (int i = 0; i < 2 && args->len && args->src[args->len - 1] == '='; i++)
+      args->len--;
+  }
+  if (args->len % 4 == 1)
+    rb_raise(rb_eArgError, "invalid base64 length: %ld", RSTRING_LEN(string));
+  return args->len / 4 * 3 + (args->len % 4 ? args->len % 4 - 1 : 0);
+}
+
+static void
+codec_decode(VALUE string, int base64, struct codec_args *args, VALUE target) {
+  string = llc_kernel_string(string, args->len);
+  args->src = (const unsigned char*)RSTRING_PTR(string);
+  llc_run_kernel(args->len, base64 ? base64_decode_kernel : hex_decode_kernel, args, target, Qnil);
+  RB_GC_GUARD(string);
+  if (args->error != SIZE_MAX) {
+    if (base64)
+      rb_raise(rb_eArgError, "invalid base64 at %"PRIuSIZE, args->error);
+    rb_raise(rb_eArgError, "invalid hex digit at %"PRIuSIZE, args->error);
+  }
+}
+
+static VALUE
+codec_decode_new(VALUE string, int base64, int urlsafe) {
+  struct codec_args args;
+  memset(&args, 0, sizeof(args));
+  args.urlsafe = urlsafe;
+  StringValue(string);
+  const size_t size = codec_decoded_size(string, base64, &args);
+
+  size_t len;
+  VALUE bb_obj = llc_bb_new(size, size);
+  args.dst = llc_view_bytes(bb_obj, &len, NULL, 1);
+  codec_decode(string, base64, &args, bb_obj);
+  return bb_obj;
+}
+
+static VALUE
+codec_decode_into(VALUE self, VALUE index, VALUE string, int base64, int urlsafe) {
+  struct codec_args args;
+  memset(&args, 0, sizeof(args));
+  args.urlsafe = urlsafe;
+  // Both conversions may run Ruby code, which could change the string or
+  // resize the buffer, so they come before measuring either
+  ssize_t idx = NUM2SSIZET(index);
+  StringValue(string);
+  const size_t size = codec_decoded_size(string, base64, &args);
+
+  size_t len;
+  unsigned char *ptr = llc_view_bytes(self, &len, NULL, 1);
+  if (idx < 0)
+    idx += (ssize_t)len;
+  if (idx < 0 || (size_t)idx > len)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
+  if (size > len - (size_t)idx)
+    rb_raise(rb_eArgError, "%"PRIuSIZE" bytes needed at %"PRIdSIZE", but only %"PRIuSIZE" available",
+      size, idx, len - (size_t)idx);
+
+  args.dst = ptr + idx;
+  codec_decode(string, base64, &args, self);
+  return SIZET2NUM(size);
+}
+
+/*
+ * Returns the bytes as a lowercase hexadecimal string, two digits per byte,
+ * like +to_s.unpack1("H*")+ without the intermediate copy.
+ *
+ * @return [String]
+ */
+static VALUE
+t_to_hex(VALUE self) {
+  return codec_encode(self, 0, 0, 0);
+}
+
+/*
+ * call-seq:
+ *  to_base64(urlsafe: false, padding: true)
+ *
+ * Returns the bytes encoded as Base64, without line breaks, like
+ * Base64.strict_encode64 without the intermediate copy.
+ *
+ * Example:
+ *   headers["Digest"] = "sha-256=#{digest.to_base64}"
+ *
+ * @param urlsafe [Boolean] Optional. Whether to use "-" and "_" instead of
+ *   "+" and "/"
+ * @param padding [Boolean] Optional. Whether to complete the last group
+ *   with "="
+ * @return [String]
+ */
+static VALUE
+t_to_base64(int argc, VALUE *argv, VALUE self) {
+  VALUE kwargs;
+  int urlsafe;
+  int padding;
+  rb_scan_args(argc, argv, "0:", &kwargs);
+  codec_kwargs(kwargs, &urlsafe, &padding);
+  return codec_encode(self, 1, urlsafe, padding);
+}
+
+/*
+ * Creates an ArrayBuffer with the bytes given as hexadecimal digits, in
+ * either case.
+ *
+ * Raises ArgumentError if there is an odd number of digits or a character
+ * that is not one.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_bb_s_from_hex(VALUE klass, VALUE string) {
+  return codec_decode_new(string, 0, 0);
+}
+
+/*
+ * call-seq:
+ *  ArrayBuffer.from_base64(string, urlsafe: false)
+ *
+ * Creates an ArrayBuffer with the bytes encoded as Base64 in +string+.
+ *
+ * Decoding is strict: whitespace, characters out of the alphabet and
+ * misplaced padding raise ArgumentError. Padding may be left out.
+ *
+ * @param urlsafe [Boolean] Optional. Whether to use "-" and "_" instead of
+ *   "+" and "/"
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_bb_s_from_base64(int argc, VALUE *argv, VALUE klass) {
+  VALUE string;
+  VALUE kwargs;
+  int urlsafe;
+  rb_scan_args(argc, argv, "1:", &string, &kwargs);
+  codec_kwargs(kwargs, &urlsafe, NULL);
+  return codec_decode_new(string, 1, urlsafe);
+}
+
+/*
+ * Writes the bytes given as hexadecimal digits at +index+, like
+ * ArrayBuffer.from_hex decodes them.
+ *
+ * Bytes before an invalid digit may already be written when it raises.
+ *
+ * @return [Integer] How many bytes were written
+ */
+static VALUE
+t_dv_sethex(VALUE self, VALUE index, VALUE string) {
+  return codec_decode_into(self, index, string, 0, 0);
+}
+
+/*
+ * call-seq:
+ *  setBase64(index, string, urlsafe: false)
+ *
+ * Writes the bytes encoded as Base64 in +string+ at +index+, like
+ * ArrayBuffer.from_base64 decodes them.
+ *
+ * Bytes before an invalid character may already be written when it raises.
+ *
+ * @return [Integer] How many bytes were written
+ */
+static VALUE
+t_dv_setbase64(int argc, VALUE *argv, VALUE self) {
+  VALUE index;
+  VALUE string;
+  VALUE kwargs;
+  int urlsafe;
+  rb_scan_args(argc, argv, "2:", &index, &string, &kwargs);
+  codec_kwargs(kwargs, &urlsafe, NULL);
+  return codec_decode_into(self, index, string, 1, urlsafe);
+}
+
+static void
+init_codec_tables(void) {
+  memset(hex_values, CODEC_INVALID, sizeof(hex_values));
+  for (int i = 0; i < 256; i++) {
+    hex_pairs[i][0] = hex_digits[i >> 4];
+    hex_pairs[i][1] = hex_digits[i & 0xF];
+  }
+  for (int i = 0; i < 16; i++) {
+    hex_values[(unsigned char)hex_digits[i]] = (unsigned char)i;
+    hex_values[(unsigned char)"0123456789ABCDEF"[i]] = (unsigned char)i;
+  }
+
+  memset(base64_values, CODEC_INVALID, sizeof(base64_values));
+  for (int alphabet = 0; alphabet < 2; alphabet++) {
+    const char *chars = base64_alphabets[alphabet];
+    for (int i = 0; i < 4096; i++) {
+      base64_pairs[alphabet][i][0] = chars[i >> 6];
+      base64_pairs[alphabet][i][1] = chars[i & 0x3F];
+    }
+    for (int i = 0; i < 64; i++)
+      base64_values[alphabet][(unsigned char)chars[i]] = (unsigned char)i;
+  }
+}
+
+void
+Init_codec() {
+  idUrlsafe = rb_intern("urlsafe");
+  idPadding = rb_intern("padding");
+  init_codec_tables();
+
+#ifdef LLC_CODEC_SSSE3
+  __builtin_cpu_init();
+  codec_ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+  rb_define_method(cArrayBuffer, "to_hex", t_to_hex, 0);
+  rb_define_method(cArrayBuffer, "to_base64", t_to_base64, -1);
+  rb_define_method(cDataView, "to_hex", t_to_hex, 0);
+  rb_define_method(cDataView, "to_base64", t_to_base64, -1);
+
+  rb_define_singleton_method(cArrayBuffer, "from_hex", t_bb_s_from_hex, 1);
+  rb_define_singleton_method(cArrayBuffer, "from_base64", t_bb_s_from_base64, -1);
+
+  rb_define_method(cDataView, "setHex", t_dv_sethex, 2);
+  rb_define_method(cDataView, "setBase64", t_dv_setbase64, -1);
+}
@@ -0,0 +1,128 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static int
+is_buffer(VALUE obj) {
+  return rb_typeddata_is_kind_of(obj, &llc_arraybuffer_type) ||
+    rb_typeddata_is_kind_of(obj, &llc_dataview_type);
+}
+
+struct compare_args {
+  const unsigned char *a;
+  const unsigned char *b;
+  size_t len;
+  int result;
+};
+
+static void *
+compare_kernel(void *ptr) {
+  struct compare_args *args = (struct compare_args*)ptr;
+  args->result = args->len ? memcmp(args->a, args->b, args->len) : 0;
+  return NULL;
+}
+
+/*
+ * Compares the bytes of two buffers or views lexicographically, like
+ * String#<=> does.
+ */
+static int
+compare_bytes(VALUE self, VALUE other) {
+  size_t len_a;
+  size_t len_b;
+  const unsigned char *a = llc_view_bytes(self, &len_a, NULL, 0);
+  const unsigned char *b = llc_view_bytes(other, &len_b, NULL, 0);
+
+  struct compare_args args = { a, b, len_a < len_b ? len_a : len_b, 0 };
+  if (a != b)
+    llc_run_kernel(args.len, compare_kernel, &args, self, other);
+  if (args.result)
+    return args.result < 0 ? -1 : 1;
+  return len_a == len_b ? 0 : (len_a < len_b ? -1 : 1);
+}
+
+/*
+ * Returns whether +other+ is an ArrayBuffer or a DataView with the same
+ * bytes.
+ *
+ * A DataView only compares the bytes it can see. Endianess is not taken
+ * into account.
+ *
+ * @return [Boolean]
+ */
+static VALUE
+t_equal(VALUE self, VALUE other) {
+  if (self == other)
+    return Qtrue;
+  if (!is_buffer(other))
+    return Qfalse;
+
+  size_t len_a;
+  size_t len_b;
+  llc_view_bytes(self, &len_a, NULL, 0);
+  llc_view_bytes(other, &len_b, NULL, 0);
+  if (len_a != len_b)
+    return Qfalse;
+  return compare_bytes(self, other) == 0 ? Qtrue : Qfalse;
+}
+
+/*
+ * Returns whether +other+ is of the same class and has the same bytes.
+ *
+ * Together with #hash, this allows buffers and views to be used as Hash
+ * keys. Like Strings, they must not be modified while used as keys.
+ *
+ * @return [Boolean]
+ */
+static VALUE
+t_eql_p(VALUE self, VALUE other) {
+  if (self == other)
+    return Qtrue;
+  if (rb_obj_class(self) != rb_obj_class(other))
+    return Qfalse;
+  return t_equal(self, other);
+}
+
+/*
+ * Compares the bytes with those of +other+, byte by byte, then by size.
+ *
+ * @return [-1, 0, 1, nil] nil if +other+ is not an ArrayBuffer or a
+ *   DataView
+ */
+static VALUE
+t_cmp(VALUE self, VALUE other) {
+  if (!is_buffer(other))
+    return Qnil;
+  return INT2FIX(compare_bytes(self, other));
+}
+
+/*
+ * Returns a hash of the bytes, consistent with #eql?.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_hash(VALUE self) {
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+  return ST2FIX(rb_memhash(ptr, (long)len));
+}
+
+static void
+define_compare_methods(VALUE klass) {
+  rb_include_module(klass, rb_mComparable);
+  rb_define_method(klass, "==", t_equal, 1);
+  rb_define_method(klass, "eql?", t_eql_p, 1);
+  rb_define_method(klass, "<=>", t_cmp, 1);
+  rb_define_method(klass, "hash", t_hash, 0);
+}
+
+void
+Init_compare() {
+  define_compare_methods(cArrayBuffer);
+  define_compare_methods(cDataView);
+}
@@ -0,0 +1,333 @@
+#include "dataview.h"
+#include "arraybuffer.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+extern VALUE cReader;
+extern VALUE cWriter;
+
+static ID idEndianess = Qundef;
+
+struct LLC_Cursor {
+  VALUE view;
+  size_t pos;
+};
+
+#define DECLARECURSOR(o) \
+  struct LLC_Cursor *cursor = (struct LLC_Cursor*)rb_check_typeddata((o), &cursor_type)
+
+static void
+t_cursor_gc_mark(void *ptr) {
+  struct LLC_Cursor *cursor = (struct LLC_Cursor*)ptr;
+  if (cursor->view)
+    rb_gc_mark_movable(cursor->view);
+}
+
+static void
+t_cursor_free(void *ptr) {
+  xfree(ptr);
+}
+
+static size_t
+t_cursor_memsize(const void *ptr) {
+  return sizeof(struct LLC_Cursor);
+}
+
+static void
+t_cursor_compact(void *ptr) {
+  struct LLC_Cursor *cursor = (struct LLC_Cursor*)ptr;
+  if (cursor->view)
+    cursor->view = rb_gc_location(cursor->view);
+}
+
+static const rb_data_type_t cursor_type = {
+  "ArrayBuffer::Cursor",
+  { t_cursor_gc_mark, t_cursor_free, t_cursor_memsize, t_cursor_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE
+t_cursor_allocator(VALUE klass) {
+  struct LLC_Cursor *cursor;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_Cursor, &cursor_type, cursor);
+  cursor->view = 0;
+  cursor->pos = 0;
+  return obj;
+}
+
+/*
+ * Returns a pointer to the next +n+ bytes and moves the position past them.
+ *
+ * Raises EOFError, without moving, if fewer than +n+ bytes are left.
+ */
+static unsigned char *
+cursor_advance(struct LLC_Cursor *cursor, size_t n, int *little, int writable) {
+  size_t len;
+  unsigned char *ptr = llc_view_bytes(cursor->view, &len, little, writable);
+  if (cursor->pos > len || n > len - cursor->pos)
+    rb_raise(rb_eEOFError, "%"PRIuSIZE" bytes needed at position %"PRIuSIZE", but only %"PRIuSIZE" available",
+      n, cursor->pos, cursor->pos > len ? (size_t)0 : len - cursor->pos);
+  ptr += cursor->pos;
+  cursor->pos += n;
+  return ptr;
+}
+
+static size_t
+cursor_length(struct LLC_Cursor *cursor) {
+  size_t len;
+  llc_view_bytes(cursor->view, &len, NULL, 0);
+  return len;
+}
+
+static VALUE
+cursor_read(VALUE self, int type) {
+  DECLARECURSOR(self);
+  int little;
+  const unsigned char *p = cursor_advance(cursor, llc_type_widths[type], &little, 0);
+  return llc_decode_value(p, type, little);
+}
+
+static VALUE
+cursor_write(VALUE self, VALUE value, int type) {
+  DECLARECURSOR(self);
+  const uint64_t bits = llc_encode_value(value, type);
+  int little;
+  unsigned char *p = cursor_advance(cursor, llc_type_widths[type], &little, 1);
+  llc_store_uint(p, llc_type_widths[type], little, bits);
+  return self;
+}
+
+/*
+ * call-seq:
+ *  initialize(source, endianess: nil)
+ *
+ * Creates a cursor positioned at the start of +source+.
+ *
+ * Example:
+ *   reader = ArrayBuffer::Reader.new(view)
+ *   length = reader.read_u16
+ *   payload = reader.read_bytes(length)
+ *
+ * @param source [DataView, ArrayBuffer] When given an ArrayBuffer, the
+ *   cursor covers the whole buffer as it is now
+ * @param endianess [:big, :little] Optional. Defaults to the endianess of
+ *   the DataView, or big endian for an ArrayBuffer
+ */
+static VALUE
+t_cursor_initialize(int argc, VALUE *argv, VALUE self) {
+  DECLARECURSOR(self);
+  VALUE source;
+  VALUE kwargs;
+  VALUE endianess = Qundef;
+  static ID keyword_ids[] = { 0 };
+
+  rb_scan_args(argc, argv, "1:", &source, &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idEndianess;
+  }
+
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+
+  if (rb_obj_is_kind_of(source, cDataView)) {
+    if (endianess == Qundef) {
+      RB_OBJ_WRITE(self, &cursor->view, source);
+    } else {
+      DECLAREDV(source);
+      RB_OBJ_WRITE(self, &cursor->view, llc_dv_new(dv->bb_obj, dv->offset, dv->size, llc_parse_endianess(endianess)));
+    }
+  } else if (rb_obj_is_kind_of(source, cArrayBuffer)) {
+    DECLAREBB(source);
+    const int little = endianess == Qundef ? 0 : llc_parse_endianess(endianess);
+    RB_OBJ_WRITE(self, &cursor->view, llc_dv_new(source, 0, bb->size, little));
+  } else {
+    rb_raise(rb_eTypeError, "expected an ArrayBuffer or a DataView, got %"PRIsVALUE, CLASS_OF(source));
+  }
+
+  cursor->pos = 0;
+  return self;
+}
+
+/*
+ * Returns the DataView the cursor moves over.
+ *
+ * @return [DataView]
+ */
+static VALUE
+t_cursor_view(VALUE self) {
+  DECLARECURSOR(self);
+  return cursor->view;
+}
+
+/*
+ * Returns the current position, in bytes from the start of the view.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_cursor_pos(VALUE self) {
+  DECLARECURSOR(self);
+  return SIZET2NUM(cursor->pos);
+}
+
+/*
+ * Moves the cursor to +pos+.
+ *
+ * If passed a negative value, it will be summed with the view size.
+ *
+ * @param pos [Integer] Between zero and the view size
+ */
+static VALUE
+t_cursor_setpos(VALUE self, VALUE pos) {
+  DECLARECURSOR(self);
+  const size_t len = cursor_length(cursor);
+  ssize_t val = NUM2SSIZET(pos);
+  if (val < 0)
+    val += (ssize_t)len;
+  if (val < 0 || (size_t)val > len)
+    rb_raise(rb_eArgError, "position out of bounds: %"PRIdSIZE, val);
+  cursor->pos = (size_t)val;
+  return pos;
+}
+
+/*
+ * Moves the cursor +count+ bytes forward, or backwards if negative.
+ *
+ * @param count [Integer]
+ */
+static VALUE
+t_cursor_skip(VALUE self, VALUE count) {
+  DECLARECURSOR(self);
+  const size_t len = cursor_length(cursor);
+  const ssize_t n = NUM2SSIZET(count);
+  if (n < 0 ? (size_t)(-n) > cursor->pos : (cursor->pos > len || (size_t)n > len - cursor->pos))
+    rb_raise(rb_eEOFError, "can't skip %"PRIdSIZE" bytes from position %"PRIuSIZE, n, cursor->pos);
+  cursor->pos = (size_t)((ssize_t)cursor->pos + n);
+  return self;
+}
+
+/*
+ * Returns how many bytes are left between the position and the end of the
+ * view.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_cursor_remaining(VALUE self) {
+  DECLARECURSOR(self);
+  const size_t len = cursor_length(cursor);
+  return SIZET2NUM(cursor->pos >= len ? 0 : len - cursor->pos);
+}
+
+/*
+ * Returns whether the cursor reached the end of the view.
+ *
+ * @return [Boolean]
+ */
+static VALUE
+t_cursor_eof_p(VALUE self) {
+  DECLARECURSOR(self);
+  return cursor->pos >= cursor_length(cursor) ? Qtrue : Qfalse;
+}
+
+/*
+ * Reads the next +count+ bytes into a new ASCII-8BIT string.
+ *
+ * @return [String]
+ */
+static VALUE
+t_reader_read_bytes(VALUE self, VALUE count) {
+  DECLARECURSOR(self);
+  const ssize_t n = NUM2SSIZET(count);
+  if (n < 0)
+    rb_raise(rb_eArgError, "count must not be negative: %"PRIdSIZE, n);
+  const unsigned char *p = cursor_advance(cursor, (size_t)n, NULL, 0);
+  return rb_str_new((const char*)p, (long)n);
+}
+
+/*
+ * Writes the bytes of +bytes+ at the position and moves past them.
+ *
+ * @param bytes [String, ArrayBuffer, DataView]
+ */
+static VALUE
+t_writer_write_bytes(VALUE self, VALUE bytes) {
+  DECLARECURSOR(self);
+  const unsigned char *src;
+  size_t length;
+
+  if (RB_TYPE_P(bytes, T_STRING)) {
+    src = (const unsigned char*)RSTRING_PTR(bytes);
+    length = (size_t)RSTRING_LEN(bytes);
+  } else {
+    src = llc_view_bytes(bytes, &length, NULL, 0);
+  }
+
+  unsigned char *p = cursor_advance(cursor, length, NULL, 1);
+  memmove(p, src, length);
+  return self;
+}
+
+#define CURSOR_ACCESSORS(name, type) \
+  static VALUE t_reader_read_##name(VALUE self) { return cursor_read(self, (type)); } \
+  static VALUE t_writer_write_##name(VALUE self, VALUE value) { return cursor_write(self, value, (type)); }
+
+CURSOR_ACCESSORS(u8, LLC_U8)
+CURSOR_ACCESSORS(u16, LLC_U16)
+CURSOR_ACCESSORS(u24, LLC_U24)
+CURSOR_ACCESSORS(u32, LLC_U32)
+CURSOR_ACCESSORS(u64, LLC_U64)
+CURSOR_ACCESSORS(i8, LLC_I8)
+CURSOR_ACCESSORS(i16, LLC_I16)
+CURSOR_ACCESSORS(i24, LLC_I24)
+CURSOR_ACCESSORS(i32, LLC_I32)
+CURSOR_ACCESSORS(i64, LLC_I64)
+CURSOR_ACCESSORS(f32, LLC_F32)
+CURSOR_ACCESSORS(f64, LLC_F64)
+
+#define DEFINE_CURSOR_ACCESSORS(name) \
+  rb_define_method(cReader, "read_" #name, t_reader_read_##name, 0); \
+  rb_define_method(cWriter, "write_" #name, t_writer_write_##name, 1);
+
+static void
+define_cursor_methods(VALUE klass) {
+  rb_define_alloc_func(klass, t_cursor_allocator);
+  rb_define_method(klass, "initialize", t_cursor_initialize, -1);
+  rb_define_method(klass, "view", t_cursor_view, 0);
+  rb_define_method(klass, "pos", t_cursor_pos, 0);
+  rb_define_method(klass, "pos=", t_cursor_setpos, 1);
+  rb_define_method(klass, "skip", t_cursor_skip, 1);
+  rb_define_method(klass, "remaining", t_cursor_remaining, 0);
+  rb_define_method(klass, "eof?", t_cursor_eof_p, 0);
+}
+
+void
+Init_cursor() {
+  idEndianess = rb_intern("endianess");
+
+  cReader = rb_define_class_under(cArrayBuffer, "Reader", rb_cObject);
+  define_cursor_methods(cReader);
+  rb_define_method(cReader, "read_bytes", t_reader_read_bytes, 1);
+
+  cWriter = rb_define_class_under(cArrayBuffer, "Writer", rb_cObject);
+  define_cursor_methods(cWriter);
+  rb_define_method(cWriter, "write_bytes", t_writer_write_bytes, 1);
+
+  DEFINE_CURSOR_ACCESSORS(u8);
+  DEFINE_CURSOR_ACCESSORS(u16);
+  DEFINE_CURSOR_ACCESSORS(u24);
+  DEFINE_CURSOR_ACCESSORS(u32);
+  DEFINE_CURSOR_ACCESSORS(u64);
+  DEFINE_CURSOR_ACCESSORS(i8);
+  DEFINE_CURSOR_ACCESSORS(i16);
+  DEFINE_CURSOR_ACCESSORS(i24);
+  DEFINE_CURSOR_ACCESSORS(i32);
+  DEFINE_CURSOR_ACCESSORS(i64);
+  DEFINE_CURSOR_ACCESSORS(f32);
+  DEFINE_CURSOR_ACCESSORS(f64);
+}
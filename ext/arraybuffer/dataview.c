@@ -1,5 +1,6 @@
 #include "dataview.h"
 #include "arraybuffer.h"
+#include "byteorder.h"
 #include "extconf.h"
 
 #ifdef HAVE_STRING_H
@@ -19,52 +20,151 @@ static ID idLittle = Qundef;
 
 #define FLAG_LITTLE_ENDIAN 1
 
-#define DECLAREDV(o) \
-  struct LLC_DataView *dv = (struct LLC_DataView*)rb_data_object_get((o))
-#define DECLAREBB(o) \
-  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_data_object_get((o))
 #define CHECK_LITTLEENDIAN(dv) ((dv)->flags & FLAG_LITTLE_ENDIAN)
 
+/*
+ * Returns how many bytes of the view actually lie within the underlying
+ * buffer. A view may be larger than its buffer, or start past its end.
+ */
+static size_t
+dv_visible_size(const struct LLC_DataView *dv, const struct LLC_ArrayBuffer *bb) {
+  if (dv->offset >= bb->size)
+    return 0;
+  if (dv->size > bb->size - dv->offset)
+    return bb->size - dv->offset;
+  return dv->size;
+}
+
 static void
-t_dv_gc_mark(struct LLC_DataView *dv) {
+t_dv_gc_mark(void *ptr) {
+  struct LLC_DataView *dv = (struct LLC_DataView*)ptr;
   if (dv->bb_obj)
-    rb_gc_mark(dv->bb_obj);
+    rb_gc_mark_movable(dv->bb_obj);
+}
+
+static void
+t_dv_free(void *ptr) {
+  xfree(ptr);
+}
+
+static size_t
+t_dv_memsize(const void *ptr) {
+  return sizeof(struct LLC_DataView);
 }
 
 static void
-t_dv_free(struct LLC_DataView *dv) {
-  xfree(dv);
+t_dv_compact(void *ptr) {
+  struct LLC_DataView *dv = (struct LLC_DataView*)ptr;
+  if (dv->bb_obj)
+    dv->bb_obj = rb_gc_location(dv->bb_obj);
 }
 
+const rb_data_type_t llc_dataview_type = {
+  "DataView",
+  { t_dv_gc_mark, t_dv_free, t_dv_memsize, t_dv_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
 static VALUE
 t_dv_allocator(VALUE klass) {
-  struct LLC_DataView *dv = (struct LLC_DataView*)xmalloc(sizeof(struct LLC_DataView));
+  struct LLC_DataView *dv;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_DataView, &llc_dataview_type, dv);
   dv->bb_obj = Qundef;
   dv->size = 0;
   dv->offset = 0;
   dv->flags = 0;
-  return Data_Wrap_Struct(klass, t_dv_gc_mark, t_dv_free, dv);
+  return obj;
+}
+
+/*
+ * Resolves the bytes visible through +obj+, which must be either an
+ * ArrayBuffer or a DataView, and stores their count in +len+.
+ *
+ * If +little+ is not NULL it is set to whether +obj+ is a little endian
+ * view. ArrayBuffers are always big endian. When +writable+ is set, raises
+ * if the bytes are read-only.
+ */
+unsigned char *
+llc_view_bytes(VALUE obj, size_t *len, int *little, int writable) {
+  if (rb_obj_is_kind_of(obj, cDataView)) {
+    DECLAREDV(obj);
+    DECLAREBB(dv->bb_obj);
+    if (writable)
+      CHECK_BB_WRITABLE(bb);
+    if (little)
+      *little = CHECK_LITTLEENDIAN(dv) ? 1 : 0;
+    *len = dv_visible_size(dv, bb);
+    return *len ? bb->ptr + dv->offset : bb->ptr;
+  }
+
+  if (rb_obj_is_kind_of(obj, cArrayBuffer)) {
+    DECLAREBB(obj);
+    if (writable)
+      CHECK_BB_WRITABLE(bb);
+    if (little)
+      *little = 0;
+    *len = bb->size;
+    return bb->ptr;
+  }
+
+  rb_raise(rb_eTypeError, "expected an ArrayBuffer or a DataView, got %"PRIsVALUE, CLASS_OF(obj));
+  return NULL;
+}
+
+/*
+ * Returns whether +endianess+, which must be +:big+ or +:little+, is
+ * little endian.
+ */
+int
+llc_parse_endianess(VALUE endianess) {
+  Check_Type(endianess, T_SYMBOL);
+  ID id = SYM2ID(endianess);
+  if (id == idLittle)
+    return 1;
+  if (id != idBig)
+    rb_raise(rb_eArgError, "endianess must be either :big or :little");
+  return 0;
+}
+
+/*
+ * Creates a DataView over +bb_obj+ without going through #initialize.
+ */
+VALUE
+llc_dv_new(VALUE bb_obj, size_t offset, size_t size, int little) {
+  VALUE obj = t_dv_allocator(cDataView);
+  DECLAREDV(obj);
+  RB_OBJ_WRITE(obj, &dv->bb_obj, bb_obj);
+  dv->offset = offset;
+  dv->size = size;
+  dv->flags = little ? FLAG_LITTLE_ENDIAN : 0;
+  return obj;
 }
 
 #ifdef HAVE_RUBY_MEMORY_VIEW_H
 static bool
 r_dv_mv_get(VALUE self, rb_memory_view_t *view, int flags) {
   DECLAREDV(self);
-  if (!dv->size)
-    return 0;
-
   DECLAREBB(dv->bb_obj);
+  const size_t size = dv_visible_size(dv, bb);
+  if (!size)
+    return 0;
 
-  char *ptr = (char*)bb->ptr + (size_t)dv->offset;
+  char *ptr = (char*)bb->ptr + dv->offset;
+  const bool readonly = (bb->flags & BB_FLAG_READONLY) != 0;
+  if (readonly && (flags & RUBY_MEMORY_VIEW_WRITABLE))
+    return 0;
 
-  rb_memory_view_init_as_byte_array(view, self, ptr, (const ssize_t)dv->size, 0);
+  rb_memory_view_init_as_byte_array(view, self, ptr, (const ssize_t)size, readonly);
+  llc_bb_pin(self);
   return 1;
 }
 
-// static bool
-// r_dv_mv_release(VALUE self, rb_memory_view_t *view) {
-//   return 1;
-// }
+static bool
+r_dv_mv_release(VALUE self, rb_memory_view_t *view) {
+  llc_bb_unpin(self);
+  return 1;
+}
 
 static bool
 r_dv_mv_available_p(VALUE self) {
@@ -74,7 +174,7 @@ r_dv_mv_available_p(VALUE self) {
 
 static rb_memory_view_entry_t cDataViewMemoryView = {
   r_dv_mv_get,
-  NULL, // r_dv_mv_release,
+  r_dv_mv_release,
   r_dv_mv_available_p
 };
 #endif
@@ -119,21 +219,21 @@ t_dv_initialize(int argc, VALUE *argv, VALUE self) {
 
   DECLAREBB(bb_obj);
 
-  int size_val = NIL_P(size) ? (int)bb->size : NUM2INT(size);
+  ssize_t size_val = NIL_P(size) ? (ssize_t)bb->size : NUM2SSIZET(size);
   if (size_val < 0)
-    size_val += (int)bb->size;
+    size_val += (ssize_t)bb->size;
   if (size_val < 0)
-    rb_raise(rb_eArgError, "calculated size is negative: %d", size_val);
+    rb_raise(rb_eArgError, "calculated size is negative: %"PRIdSIZE, size_val);
 
-  int offset_val = NIL_P(offset) ? 0 : NUM2INT(offset);
+  ssize_t offset_val = NIL_P(offset) ? 0 : NUM2SSIZET(offset);
   if (offset_val < 0)
-    offset_val += (int)bb->size;
+    offset_val += (ssize_t)bb->size;
   if (offset_val < 0)
-    rb_raise(rb_eArgError, "calculated offset is negative: %d", offset_val);
+    rb_raise(rb_eArgError, "calculated offset is negative: %"PRIdSIZE, offset_val);
 
-  dv->offset = (unsigned int)offset_val;
-  dv->size = (unsigned int)size_val;
-  dv->bb_obj = bb_obj;
+  dv->offset = (size_t)offset_val;
+  dv->size = (size_t)size_val;
+  RB_OBJ_WRITE(self, &dv->bb_obj, bb_obj);
 
   if (!keyword_ids[0]) {
     keyword_ids[0] = idEndianess;
@@ -142,14 +242,8 @@ t_dv_initialize(int argc, VALUE *argv, VALUE self) {
   if (!NIL_P(kwargs)) {
     VALUE endianess;
     rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
-    if (endianess != Qundef) {
-      Check_Type(endianess, T_SYMBOL);
-      ID id = SYM2ID(endianess);
-      if (id == idLittle)
-        dv->flags |= FLAG_LITTLE_ENDIAN;
-      else if (id != idBig)
-        rb_raise(rb_eArgError, "endianess must be either :big or :little");
-    }
+    if (endianess != Qundef && llc_parse_endianess(endianess))
+      dv->flags |= FLAG_LITTLE_ENDIAN;
   }
 
   return self;
@@ -158,13 +252,30 @@ t_dv_initialize(int argc, VALUE *argv, VALUE self) {
 static VALUE
 t_dv_size(VALUE self) {
   DECLAREDV(self);
-  return UINT2NUM(dv->size);
+  return SIZET2NUM(dv->size);
 }
 
 static VALUE
 t_dv_offset(VALUE self) {
   DECLAREDV(self);
-  return UINT2NUM(dv->offset);
+  return SIZET2NUM(dv->offset);
+}
+
+/*
+ * Makes the copy see the same bytes of the same buffer as +orig+, with the
+ * same endianess. The bytes themselves are not copied.
+ */
+static VALUE
+t_dv_initialize_copy(VALUE self, VALUE orig) {
+  DECLAREDV(self);
+  if (self == orig)
+    return self;
+  const struct LLC_DataView *src = (const struct LLC_DataView*)rb_check_typeddata(orig, &llc_dataview_type);
+  RB_OBJ_WRITE(self, &dv->bb_obj, src->bb_obj);
+  dv->offset = src->offset;
+  dv->size = src->size;
+  dv->flags = src->flags;
+  return self;
 }
 
 static VALUE
@@ -180,12 +291,9 @@ t_dv_each(VALUE self) {
   DECLAREDV(self);
   DECLAREBB(dv->bb_obj);
 
-  int size = dv->size;
-  if (size + dv->offset >= bb->size)
-    size = bb->size - dv->offset;
-
   if (rb_block_given_p()) {
-    for (int i = 0; i < size; i++) {
+    // The block may resize the buffer, so bounds are checked on every step
+    for (size_t i = 0; i < dv_visible_size(dv, bb); i++) {
       unsigned int val = (unsigned int)bb->ptr[i + dv->offset];
       rb_yield(UINT2NUM(val));
     }
@@ -208,13 +316,13 @@ static VALUE
 t_dv_setoffset(VALUE self, VALUE offset) {
   DECLAREDV(self);
   DECLAREBB(dv->bb_obj);
-  int offset_val = NIL_P(offset) ? 0 : NUM2INT(offset);
+  ssize_t offset_val = NIL_P(offset) ? 0 : NUM2SSIZET(offset);
   if (offset_val < 0)
-    offset_val += (int)bb->size;
+    offset_val += (ssize_t)bb->size;
   if (offset_val < 0)
-    rb_raise(rb_eArgError, "calculated offset is negative: %d", offset_val);
+    rb_raise(rb_eArgError, "calculated offset is negative: %"PRIdSIZE, offset_val);
 
-  dv->offset = (unsigned int)offset_val;
+  dv->offset = (size_t)offset_val;
   return self;
 }
 
@@ -231,22 +339,25 @@ static VALUE
 t_dv_setsize(VALUE self, VALUE size) {
   DECLAREDV(self);
   DECLAREBB(dv->bb_obj);
-  int size_val = NIL_P(size) ? (int)bb->size : NUM2INT(size);
+  ssize_t size_val = NIL_P(size) ? (ssize_t)bb->size : NUM2SSIZET(size);
   if (size_val < 0)
-    size_val += (int)bb->size;
+    size_val += (ssize_t)bb->size;
   if (size_val < 0)
-    rb_raise(rb_eArgError, "calculated size is negative: %d", size_val);
+    rb_raise(rb_eArgError, "calculated size is negative: %"PRIdSIZE, size_val);
 
-  dv->size = (unsigned int)size_val;
+  dv->size = (size_t)size_val;
   return self;
 }
 
-#define DECLARENCHECKIDX(index) int idx = NUM2INT(index); \
-  if (idx < 0) idx += (int)dv->size; \
-  if (idx < 0 || idx >= (int)dv->size) rb_raise(rb_eArgError, "index out of bounds: %d", idx);
+#define DECLARENCHECKIDX(index) ssize_t idx = NUM2SSIZET(index); \
+  if (idx < 0) idx += (ssize_t)dv->size; \
+  if (idx < 0 || (size_t)idx >= dv->size) rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
 
-#define CHECKBOUNDSBB(v) if ((v) < 0 || (v) >= (bb)->size) \
-  rb_raise(rb_eArgError, "index out of underlying buffer bounds: %d", (v));
+#define CHECKBOUNDSBB(v) if ((v) >= (bb)->size) \
+  rb_raise(rb_eArgError, "index out of underlying buffer bounds: %"PRIuSIZE, (size_t)(v));
+/* Checks +length+ bytes from +start+, which must already be in bounds */
+#define CHECKRANGEBB(start, length) if ((length) > (bb)->size - (start)) \
+  rb_raise(rb_eArgError, "index out of underlying buffer bounds: %"PRIuSIZE, (size_t)(start) + (size_t)(length) - 1);
 
 /*
  * Reads a bit at index.
@@ -260,14 +371,14 @@ t_dv_setsize(VALUE self, VALUE size) {
 static VALUE
 t_dv_getbit(VALUE self, VALUE index) {
   DECLAREDV(self); DECLAREBB(dv->bb_obj);
-  int idx = NUM2INT(index);
+  ssize_t idx = NUM2SSIZET(index);
   if (idx < 0)
-    idx += (int)dv->size * 8;
-  if (idx < 0 || idx >= (int)dv->size * 8)
-    rb_raise(rb_eArgError, "index out of bounds: %d", idx);
+    idx += (ssize_t)dv->size * 8;
+  if (idx < 0 || (size_t)idx >= dv->size * 8)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
 
   unsigned int bit_idx = ((unsigned int)idx) & 7;
-  unsigned int byte_idx = (((unsigned int)idx) >> 3) + dv->offset;
+  size_t byte_idx = (((size_t)idx) >> 3) + dv->offset;
   unsigned char bit_mask = 1 << bit_idx;
 
   CHECKBOUNDSBB(byte_idx);
@@ -282,7 +393,7 @@ t_dv_getbit(VALUE self, VALUE index) {
 static VALUE
 t_dv_getu8(VALUE self, VALUE index) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int real_idx = dv->offset + (unsigned int)idx;
+  size_t real_idx = dv->offset + (size_t)idx;
   CHECKBOUNDSBB(real_idx);
   return UINT2NUM(bb->ptr[real_idx]);
 }
@@ -295,8 +406,8 @@ t_dv_getu8(VALUE self, VALUE index) {
 static VALUE
 t_dv_getu16(VALUE self, VALUE index) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx1);
   unsigned short val = 0;
@@ -318,9 +429,9 @@ t_dv_getu16(VALUE self, VALUE index) {
 static VALUE
 t_dv_getu24(VALUE self, VALUE index) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
-  unsigned int idx2 = dv->offset + (unsigned int)idx + 2;
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
+  size_t idx2 = dv->offset + (size_t)idx + 2;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx2);
   unsigned int val = 0;
@@ -344,10 +455,10 @@ t_dv_getu24(VALUE self, VALUE index) {
 static VALUE
 t_dv_getu32(VALUE self, VALUE index) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
-  unsigned int idx2 = dv->offset + (unsigned int)idx + 2;
-  unsigned int idx3 = dv->offset + (unsigned int)idx + 3;
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
+  size_t idx2 = dv->offset + (size_t)idx + 2;
+  size_t idx3 = dv->offset + (size_t)idx + 3;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx3);
   unsigned int val = 0;
@@ -376,7 +487,8 @@ t_dv_getu32(VALUE self, VALUE index) {
 static VALUE
 t_dv_setu8(VALUE self, VALUE index, VALUE value) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
+  CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
   CHECKBOUNDSBB(idx0);
   int val = NUM2INT(value);
   ADJUSTBOUNDS(val, 0xFF);
@@ -393,8 +505,9 @@ t_dv_setu8(VALUE self, VALUE index, VALUE value) {
 static VALUE
 t_dv_setu16(VALUE self, VALUE index, VALUE value) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
+  CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx1);
   int val = NUM2INT(value);
@@ -419,9 +532,10 @@ t_dv_setu16(VALUE self, VALUE index, VALUE value) {
 static VALUE
 t_dv_setu24(VALUE self, VALUE index, VALUE value) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
-  unsigned int idx2 = dv->offset + (unsigned int)idx + 2;
+  CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
+  size_t idx2 = dv->offset + (size_t)idx + 2;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx2);
   int val = NUM2INT(value);
@@ -448,10 +562,11 @@ t_dv_setu24(VALUE self, VALUE index, VALUE value) {
 static VALUE
 t_dv_setu32(VALUE self, VALUE index, VALUE value) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
-  unsigned int idx1 = dv->offset + (unsigned int)idx + 1;
-  unsigned int idx2 = dv->offset + (unsigned int)idx + 2;
-  unsigned int idx3 = dv->offset + (unsigned int)idx + 3;
+  CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idx1 = dv->offset + (size_t)idx + 1;
+  size_t idx2 = dv->offset + (size_t)idx + 2;
+  size_t idx3 = dv->offset + (size_t)idx + 3;
   CHECKBOUNDSBB(idx0);
   CHECKBOUNDSBB(idx3);
   long val = NUM2LONG(value);
@@ -471,53 +586,646 @@ t_dv_setu32(VALUE self, VALUE index, VALUE value) {
   return self;
 }
 
+/*
+ * Checks that +width+ bytes starting at index fit both in the view and in
+ * the underlying buffer and returns a pointer to the first one.
+ */
+static unsigned char *
+dv_element_ptr(struct LLC_DataView *dv, VALUE index, unsigned int width, int writable) {
+  DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
+  if (writable)
+    CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
+  size_t idxn = idx0 + width - 1;
+  CHECKBOUNDSBB(idx0);
+  CHECKBOUNDSBB(idxn);
+  return bb->ptr + idx0;
+}
+
+/*
+ * Converts +value+ to an integer capped to the range [min, max].
+ *
+ * Unlike NUM2LL, Bignums outside of the range are capped instead of raising.
+ */
+int64_t
+llc_capped_int(VALUE value, int64_t min, int64_t max) {
+  if (!RB_INTEGER_TYPE_P(value))
+    value = rb_to_int(value);
+
+  if (RB_FIXNUM_P(value)) {
+    long val = FIX2LONG(value);
+    if (val < min)
+      return min;
+    if (val > max)
+      return max;
+    return (int64_t)val;
+  }
+
+  if (FIX2INT(rb_big_cmp(value, LL2NUM(min))) < 0)
+    return min;
+  if (FIX2INT(rb_big_cmp(value, LL2NUM(max))) > 0)
+    return max;
+  return (int64_t)NUM2LL(value);
+}
+
+/*
+ * Same as llc_capped_int, for the full unsigned 64 bits range.
+ */
+uint64_t
+llc_capped_uint64(VALUE value) {
+  if (!RB_INTEGER_TYPE_P(value))
+    value = rb_to_int(value);
+
+  if (RB_FIXNUM_P(value)) {
+    long val = FIX2LONG(value);
+    return val < 0 ? 0 : (uint64_t)val;
+  }
+
+  if (FIX2INT(rb_big_cmp(value, INT2FIX(0))) < 0)
+    return 0;
+  if (FIX2INT(rb_big_cmp(value, ULL2NUM(UINT64_MAX))) > 0)
+    return UINT64_MAX;
+  return (uint64_t)NUM2ULL(value);
+}
+
+const unsigned char llc_type_widths[LLC_TYPE_COUNT] = {
+  1, 2, 3, 4, 8,
+  1, 2, 3, 4, 8,
+  4, 8
+};
+
+static const char *type_names[LLC_TYPE_COUNT] = {
+  "u8", "u16", "u24", "u32", "u64",
+  "i8", "i16", "i24", "i32", "i64",
+  "f32", "f64"
+};
+
+static ID type_ids[LLC_TYPE_COUNT];
+
+/*
+ * Maps a type name such as +:u16+ or +:f64+ to its llc_value_type, or -1
+ * when there is no such type.
+ */
+int
+llc_find_type(VALUE type) {
+  Check_Type(type, T_SYMBOL);
+  ID id = SYM2ID(type);
+  for (int i = 0; i < LLC_TYPE_COUNT; i++) {
+    if (type_ids[i] == id)
+      return i;
+  }
+  return -1;
+}
+
+/*
+ * Like llc_find_type, but raises for unknown types.
+ */
+int
+llc_parse_type(VALUE type) {
+  const int found = llc_find_type(type);
+  if (found < 0)
+    rb_raise(rb_eArgError, "unknown type: %"PRIsVALUE, type);
+  return found;
+}
+
+VALUE
+llc_type_symbol(int type) {
+  return ID2SYM(type_ids[type]);
+}
+
+/*
+ * Decodes one value of the given llc_value_type stored at +p+.
+ */
+VALUE
+llc_decode_value(const unsigned char *p, int type, int little) {
+  const unsigned int width = llc_type_widths[type];
+  uint64_t bits = llc_load_uint(p, width, little);
+  switch (type) {
+  case LLC_U8:
+  case LLC_U16:
+  case LLC_U24:
+  case LLC_U32:
+    return UINT2NUM((unsigned int)bits);
+  case LLC_U64:
+    return ULL2NUM(bits);
+  case LLC_F32: {
+    uint32_t bits32 = (uint32_t)bits;
+    float val;
+    memcpy(&val, &bits32, sizeof(val));
+    return DBL2NUM((double)val);
+  }
+  case LLC_F64: {
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return DBL2NUM(val);
+  }
+  default:
+    return LL2NUM(llc_sign_extend(bits, width));
+  }
+}
+
+/*
+ * Converts +value+ to the bits stored for the given llc_value_type.
+ *
+ * Integers are capped to the range of the type, like the setters do. This
+ * may call back into Ruby (e.g. +to_int+), so it must run before any
+ * pointer into a buffer is taken.
+ */
+uint64_t
+llc_encode_value(VALUE value, int type) {
+  const unsigned int width = llc_type_widths[type];
+  switch (type) {
+  case LLC_U64:
+    return llc_capped_uint64(value);
+  case LLC_F32: {
+    float val = (float)NUM2DBL(value);
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+  }
+  case LLC_F64: {
+    double val = NUM2DBL(value);
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+  }
+  case LLC_U8:
+  case LLC_U16:
+  case LLC_U24:
+  case LLC_U32:
+    return (uint64_t)llc_capped_int(value, 0, (int64_t)(UINT64_MAX >> (64 - width * 8)));
+  default: {
+    const int64_t max = (int64_t)(UINT64_MAX >> (65 - width * 8));
+    return (uint64_t)llc_capped_int(value, -max - 1, max);
+  }
+  }
+}
+
+static VALUE
+dv_get_int(VALUE self, VALUE index, unsigned int width) {
+  DECLAREDV(self);
+  const unsigned char *p = dv_element_ptr(dv, index, width, 0);
+  return LL2NUM(llc_sign_extend(llc_load_uint(p, width, CHECK_LITTLEENDIAN(dv)), width));
+}
+
+static VALUE
+dv_set_int(VALUE self, VALUE index, VALUE value, unsigned int width) {
+  DECLAREDV(self);
+  const int64_t max = (int64_t)(UINT64_MAX >> (65 - width * 8));
+  const int64_t val = llc_capped_int(value, -max - 1, max);
+  unsigned char *p = dv_element_ptr(dv, index, width, 1);
+  llc_store_uint(p, width, CHECK_LITTLEENDIAN(dv), (uint64_t)val);
+  return self;
+}
+
+/*
+ * Reads the byte at index as a +signed char+
+ *
+ * @return [Integer] Integer between -128 and 127
+ */
+static VALUE
+t_dv_geti8(VALUE self, VALUE index) {
+  return dv_get_int(self, index, 1);
+}
+
+/*
+ * Reads two bytes starting at index as a +signed short+
+ *
+ * @return [Integer] Integer between -32768 and 32767
+ */
+static VALUE
+t_dv_geti16(VALUE self, VALUE index) {
+  return dv_get_int(self, index, 2);
+}
+
+/*
+ * Reads three bytes starting at index as a 3 bytes long signed integer
+ *
+ * @return [Integer] Integer between -8388608 and 8388607
+ */
+static VALUE
+t_dv_geti24(VALUE self, VALUE index) {
+  return dv_get_int(self, index, 3);
+}
+
+/*
+ * Reads four bytes starting at index as a 4 bytes long signed integer
+ *
+ * @return [Integer] Integer between -2147483648 and 2147483647
+ */
+static VALUE
+t_dv_geti32(VALUE self, VALUE index) {
+  return dv_get_int(self, index, 4);
+}
+
+/*
+ * Reads eight bytes starting at index as a 8 bytes long signed integer
+ *
+ * @return [Integer] Integer between -(2**63) and (2**63) - 1
+ */
+static VALUE
+t_dv_geti64(VALUE self, VALUE index) {
+  return dv_get_int(self, index, 8);
+}
+
+/*
+ * Reads eight bytes starting at index as a 8 bytes long unsigned integer
+ *
+ * A Bignum is only allocated when the value does not fit in a Fixnum.
+ *
+ * @return [Integer] Integer between 0 and (2**64) - 1
+ */
+static VALUE
+t_dv_getu64(VALUE self, VALUE index) {
+  DECLAREDV(self);
+  const unsigned char *p = dv_element_ptr(dv, index, 8, 0);
+  return ULL2NUM(llc_load_uint(p, 8, CHECK_LITTLEENDIAN(dv)));
+}
+
+/*
+ * Reads four bytes starting at index as an IEEE-754 single precision float
+ *
+ * @return [Float]
+ */
+static VALUE
+t_dv_getf32(VALUE self, VALUE index) {
+  DECLAREDV(self);
+  const unsigned char *p = dv_element_ptr(dv, index, 4, 0);
+  uint32_t bits = (uint32_t)llc_load_uint(p, 4, CHECK_LITTLEENDIAN(dv));
+  float val;
+  memcpy(&val, &bits, sizeof(val));
+  return DBL2NUM((double)val);
+}
+
+/*
+ * Reads eight bytes starting at index as an IEEE-754 double precision float
+ *
+ * @return [Float]
+ */
+static VALUE
+t_dv_getf64(VALUE self, VALUE index) {
+  DECLAREDV(self);
+  const unsigned char *p = dv_element_ptr(dv, index, 8, 0);
+  uint64_t bits = llc_load_uint(p, 8, CHECK_LITTLEENDIAN(dv));
+  double val;
+  memcpy(&val, &bits, sizeof(val));
+  return DBL2NUM(val);
+}
+
+/*
+ * Interprets one byte at index and assigns it a signed value
+ *
+ * Values lower than -128 or greater than 127 will be capped.
+ */
+static VALUE
+t_dv_seti8(VALUE self, VALUE index, VALUE value) {
+  return dv_set_int(self, index, value, 1);
+}
+
+/*
+ * Interprets two bytes starting at index and sets them a signed value
+ *
+ * Values lower than -32768 or greater than 32767 will be capped.
+ */
+static VALUE
+t_dv_seti16(VALUE self, VALUE index, VALUE value) {
+  return dv_set_int(self, index, value, 2);
+}
+
+/*
+ * Interprets three bytes starting at index and sets them a signed value
+ *
+ * Values lower than -8388608 or greater than 8388607 will be capped.
+ */
+static VALUE
+t_dv_seti24(VALUE self, VALUE index, VALUE value) {
+  return dv_set_int(self, index, value, 3);
+}
+
+/*
+ * Interprets four bytes starting at index and sets them a signed value
+ *
+ * Values lower than -2147483648 or greater than 2147483647 will be capped.
+ */
+static VALUE
+t_dv_seti32(VALUE self, VALUE index, VALUE value) {
+  return dv_set_int(self, index, value, 4);
+}
+
+/*
+ * Interprets eight bytes starting at index and sets them a signed value
+ *
+ * Values lower than -(2**63) or greater than (2**63) - 1 will be capped.
+ */
+static VALUE
+t_dv_seti64(VALUE self, VALUE index, VALUE value) {
+  return dv_set_int(self, index, value, 8);
+}
+
+/*
+ * Interprets eight bytes starting at index and sets them an unsigned value
+ *
+ * Values lower than zero will be set to 0 and values greater than
+ * (2**64) - 1 will be capped.
+ */
+static VALUE
+t_dv_setu64(VALUE self, VALUE index, VALUE value) {
+  DECLAREDV(self);
+  const uint64_t val = llc_capped_uint64(value);
+  unsigned char *p = dv_element_ptr(dv, index, 8, 1);
+  llc_store_uint(p, 8, CHECK_LITTLEENDIAN(dv), val);
+  return self;
+}
+
+/*
+ * Interprets four bytes starting at index and sets them an IEEE-754 single
+ * precision float
+ */
+static VALUE
+t_dv_setf32(VALUE self, VALUE index, VALUE value) {
+  DECLAREDV(self);
+  const float val = (float)NUM2DBL(value);
+  uint32_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  unsigned char *p = dv_element_ptr(dv, index, 4, 1);
+  llc_store_uint(p, 4, CHECK_LITTLEENDIAN(dv), bits);
+  return self;
+}
+
+/*
+ * Interprets eight bytes starting at index and sets them an IEEE-754 double
+ * precision float
+ */
+static VALUE
+t_dv_setf64(VALUE self, VALUE index, VALUE value) {
+  DECLAREDV(self);
+  const double val = NUM2DBL(value);
+  uint64_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  unsigned char *p = dv_element_ptr(dv, index, 8, 1);
+  llc_store_uint(p, 8, CHECK_LITTLEENDIAN(dv), bits);
+  return self;
+}
+
+/*
+ * Checks that +count+ elements of +width+ bytes each, starting at +index+,
+ * fit both in the view and in the underlying buffer.
+ *
+ * Returns a pointer to the first byte of the run.
+ */
+static unsigned char *
+dv_bulk_ptr(struct LLC_DataView *dv, VALUE index, VALUE count, unsigned int width, long *count_out) {
+  DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
+  long n = NUM2LONG(count);
+  if (n < 0)
+    rb_raise(rb_eArgError, "count must not be negative: %ld", n);
+
+  const size_t start = dv->offset + (size_t)idx;
+  if ((size_t)n > (dv->size - (size_t)idx) / width)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIuSIZE, (size_t)idx + (size_t)n * width - 1);
+  const size_t span = (size_t)n * width;
+  if (start >= bb->size || span > bb->size - start)
+    rb_raise(rb_eArgError, "index out of underlying buffer bounds: %"PRIuSIZE, start + span - 1);
+
+  *count_out = n;
+  return bb->ptr + start;
+}
+
+static VALUE
+dv_get_uint_array(VALUE self, VALUE index, VALUE count, unsigned int width) {
+  DECLAREDV(self);
+  long n;
+  const unsigned char *p = dv_bulk_ptr(dv, index, count, width, &n);
+  VALUE ary = rb_ary_new_capa(n);
+
+  if (width == 1) {
+    for (long i = 0; i < n; i++)
+      rb_ary_push(ary, UINT2NUM(p[i]));
+  } else if (CHECK_LITTLEENDIAN(dv)) {
+    switch (width) {
+    case 2:
+      for (long i = 0; i < n; i++, p += 2)
+        rb_ary_push(ary, UINT2NUM((unsigned int)p[0] | ((unsigned int)p[1] << 8)));
+      break;
+    case 3:
+      for (long i = 0; i < n; i++, p += 3)
+        rb_ary_push(ary, UINT2NUM((unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+          ((unsigned int)p[2] << 16)));
+      break;
+    case 4:
+      for (long i = 0; i < n; i++, p += 4)
+        rb_ary_push(ary, UINT2NUM((unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+          ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24)));
+      break;
+    }
+  } else {
+    switch (width) {
+    case 2:
+      for (long i = 0; i < n; i++, p += 2)
+        rb_ary_push(ary, UINT2NUM(((unsigned int)p[0] << 8) | (unsigned int)p[1]));
+      break;
+    case 3:
+      for (long i = 0; i < n; i++, p += 3)
+        rb_ary_push(ary, UINT2NUM(((unsigned int)p[0] << 16) | ((unsigned int)p[1] << 8) |
+          (unsigned int)p[2]));
+      break;
+    case 4:
+      for (long i = 0; i < n; i++, p += 4)
+        rb_ary_push(ary, UINT2NUM(((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+          ((unsigned int)p[2] << 8) | (unsigned int)p[3]));
+      break;
+    }
+  }
+
+  return ary;
+}
+
+static VALUE
+dv_set_uint_array(VALUE self, VALUE index, VALUE values, unsigned int width, long max) {
+  DECLAREDV(self);
+  Check_Type(values, T_ARRAY);
+  const long length = rb_array_len(values);
+  const VALUE *items = rb_array_const_ptr(values);
+
+  for (long i = 0; i < length; i++) {
+    if (!RB_FIXNUM_P(items[i]))
+      rb_raise(rb_eRuntimeError, "array contains non fixnum value at index %ld", i);
+  }
+
+  DECLAREBB(dv->bb_obj);
+  CHECK_BB_WRITABLE(bb);
+
+  long n;
+  unsigned char *p = dv_bulk_ptr(dv, index, LONG2NUM(length), width, &n);
+  const int little = CHECK_LITTLEENDIAN(dv) ? 1 : 0;
+
+  for (long i = 0; i < n; i++, p += width) {
+    long val = FIX2LONG(items[i]);
+    ADJUSTBOUNDS(val, max);
+    unsigned long uval = (unsigned long)val;
+
+    if (little) {
+      for (unsigned int b = 0; b < width; b++)
+        p[b] = (unsigned char)((uval >> (b * 8)) & 0xFF);
+    } else {
+      for (unsigned int b = 0; b < width; b++)
+        p[width - b - 1] = (unsigned char)((uval >> (b * 8)) & 0xFF);
+    }
+  }
+
+  return self;
+}
+
+/*
+ * call-seq:
+ *  getU8Array(index, count)
+ *
+ * Reads +count+ consecutive bytes starting at index.
+ *
+ * The whole range is bounds-checked once, before any byte is read.
+ *
+ * @return [Array<Integer>] Integers between 0 and 255
+ */
+static VALUE
+t_dv_getu8array(VALUE self, VALUE index, VALUE count) {
+  return dv_get_uint_array(self, index, count, 1);
+}
+
+/*
+ * call-seq:
+ *  getU16Array(index, count)
+ *
+ * Reads +count+ consecutive +unsigned short+ values starting at index.
+ *
+ * @return [Array<Integer>] Integers between 0 and 65535
+ */
+static VALUE
+t_dv_getu16array(VALUE self, VALUE index, VALUE count) {
+  return dv_get_uint_array(self, index, count, 2);
+}
+
+/*
+ * call-seq:
+ *  getU24Array(index, count)
+ *
+ * Reads +count+ consecutive 3 bytes long unsigned integers starting at index.
+ *
+ * @return [Array<Integer>] Integers between 0 and 16777215
+ */
+static VALUE
+t_dv_getu24array(VALUE self, VALUE index, VALUE count) {
+  return dv_get_uint_array(self, index, count, 3);
+}
+
+/*
+ * call-seq:
+ *  getU32Array(index, count)
+ *
+ * Reads +count+ consecutive 4 bytes long unsigned integers starting at index.
+ *
+ * @return [Array<Integer>] Integers between 0 and 4294967295
+ */
+static VALUE
+t_dv_getu32array(VALUE self, VALUE index, VALUE count) {
+  return dv_get_uint_array(self, index, count, 4);
+}
+
+/*
+ * Writes every value of +values+ as consecutive bytes starting at index.
+ *
+ * Values are capped the same way as in #setU8.
+ *
+ * @param values [Array<Integer>]
+ */
+static VALUE
+t_dv_setu8array(VALUE self, VALUE index, VALUE values) {
+  return dv_set_uint_array(self, index, values, 1, 0xFF);
+}
+
+/*
+ * Writes every value of +values+ as consecutive +unsigned short+ values
+ * starting at index.
+ *
+ * Values are capped the same way as in #setU16.
+ *
+ * @param values [Array<Integer>]
+ */
+static VALUE
+t_dv_setu16array(VALUE self, VALUE index, VALUE values) {
+  return dv_set_uint_array(self, index, values, 2, 0xFFFF);
+}
+
+/*
+ * Writes every value of +values+ as consecutive 3 bytes long unsigned
+ * integers starting at index.
+ *
+ * Values are capped the same way as in #setU24.
+ *
+ * @param values [Array<Integer>]
+ */
+static VALUE
+t_dv_setu24array(VALUE self, VALUE index, VALUE values) {
+  return dv_set_uint_array(self, index, values, 3, 0xFFFFFF);
+}
+
+/*
+ * Writes every value of +values+ as consecutive 4 bytes long unsigned
+ * integers starting at index.
+ *
+ * Values are capped the same way as in #setU32.
+ *
+ * @param values [Array<Integer>]
+ */
+static VALUE
+t_dv_setu32array(VALUE self, VALUE index, VALUE values) {
+  return dv_set_uint_array(self, index, values, 4, 0xFFFFFFFF);
+}
+
 static VALUE
 t_dv_setbytes(VALUE self, VALUE index, VALUE bytes) {
   DECLAREDV(self); DECLARENCHECKIDX(index); DECLAREBB(dv->bb_obj);
-  unsigned int idx0 = dv->offset + (unsigned int)idx;
+  CHECK_BB_WRITABLE(bb);
+  size_t idx0 = dv->offset + (size_t)idx;
   CHECKBOUNDSBB(idx0);
 
   if (RB_TYPE_P(bytes, T_ARRAY)) {
-    const unsigned int length = (unsigned int)rb_array_len(bytes);
+    const size_t length = (size_t)rb_array_len(bytes);
     const VALUE* items = rb_array_const_ptr(bytes);
-    CHECKBOUNDSBB(idx0 + length);
+    CHECKRANGEBB(idx0, length);
 
-    for (unsigned int i = 0; i < length; i++) {
+    for (size_t i = 0; i < length; i++) {
       if (!RB_FIXNUM_P(items[i]))
-        rb_raise(rb_eRuntimeError, "array contains non fixnum value at index %d", i);
+        rb_raise(rb_eRuntimeError, "array contains non fixnum value at index %"PRIuSIZE, i);
       int num = NUM2INT(items[i]);
       ADJUSTBOUNDS(num, 0xFF);
       bb->ptr[idx0 + i] = (unsigned char)num;
     }
   } else if (RB_TYPE_P(bytes, T_STRING)) {
     const char *str_ptr = RSTRING_PTR(bytes);
-    const unsigned int length = (unsigned int)RSTRING_LEN(bytes);
-    CHECKBOUNDSBB(idx0 + length);
-
-    for (unsigned int i = 0; i < length; i++) {
-      bb->ptr[idx0 + i] = (unsigned char)str_ptr[i];
-    }
+    const size_t length = (size_t)RSTRING_LEN(bytes);
+    CHECKRANGEBB(idx0, length);
+    llc_copy_bytes(bb->ptr + idx0, (const unsigned char*)str_ptr, length, dv->bb_obj, bytes);
   } else if (RB_TYPE_P(bytes, T_DATA) &&
     (CLASS_OF(bytes) == cArrayBuffer || CLASS_OF(bytes) == cDataView)) {
-    unsigned int length;
+    size_t length;
     const char *src_bytes;
     if (CLASS_OF(bytes) == cArrayBuffer) {
-      struct LLC_ArrayBuffer *src_bb = (struct LLC_ArrayBuffer*)rb_data_object_get(bytes);
+      struct LLC_ArrayBuffer *src_bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(bytes, &llc_arraybuffer_type);
       length = src_bb->size;
       src_bytes = (const char*)src_bb->ptr;
     } else {
-      struct LLC_DataView *src_dv = (struct LLC_DataView*)rb_data_object_get(bytes);
-      struct LLC_ArrayBuffer *src_bb = (struct LLC_ArrayBuffer*)rb_data_object_get(src_dv->bb_obj);
+      struct LLC_DataView *src_dv = (struct LLC_DataView*)rb_check_typeddata(bytes, &llc_dataview_type);
+      struct LLC_ArrayBuffer *src_bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(src_dv->bb_obj, &llc_arraybuffer_type);
       length = src_dv->size;
-      src_bytes = (const char*)(src_bb->ptr + (size_t)src_dv->offset);
+      src_bytes = (const char*)(src_bb->ptr + src_dv->offset);
       if (src_dv->offset >= src_bb->size)
         rb_raise(rb_eRuntimeError, "offset exceeds the underlying source buffer size");
-      if (src_dv->offset + length >= src_bb->size)
+      if (length > src_bb->size - src_dv->offset)
         rb_raise(rb_eRuntimeError, "offset + size exceeds the underlying source buffer size");
     }
 
-    CHECKBOUNDSBB(idx0 + length);
-    memcpy((void*)(bb->ptr + (size_t)idx0), src_bytes, (size_t)length);
+    CHECKRANGEBB(idx0, length);
+    llc_copy_bytes(bb->ptr + idx0, (const unsigned char*)src_bytes, length, dv->bb_obj, bytes);
   } else {
     rb_raise(rb_eArgError, "Invalid type: %+"PRIsVALUE, CLASS_OF(bytes));
   }
@@ -530,10 +1238,10 @@ t_dv_to_s(VALUE self) {
   DECLAREDV(self);
   DECLAREBB(dv->bb_obj);
 
-  const char *ptr = (const char*)bb->ptr + (size_t)dv->offset;
-  size_t len = (size_t)dv->size;
+  const char *ptr = (const char*)bb->ptr + dv->offset;
+  size_t len = dv_visible_size(dv, bb);
 
-  return rb_str_new(ptr, len);
+  return rb_str_new(ptr, (long)len);
 }
 
 void
@@ -541,12 +1249,15 @@ Init_dataview() {
   idEndianess = rb_intern("endianess");
   idLittle = rb_intern("little");
   idBig = rb_intern("big");
+  for (int i = 0; i < LLC_TYPE_COUNT; i++)
+    type_ids[i] = rb_intern(type_names[i]);
 
   cDataView = rb_define_class("DataView", rb_cObject);
   rb_define_alloc_func(cDataView, t_dv_allocator);
   rb_include_module(cDataView, rb_mEnumerable);
 
   rb_define_method(cDataView, "initialize", t_dv_initialize, -1);
+  rb_define_method(cDataView, "initialize_copy", t_dv_initialize_copy, 1);
   rb_define_method(cDataView, "getBit", t_dv_getbit, 1);
   rb_define_method(cDataView, "getU8", t_dv_getu8, 1);
   rb_define_method(cDataView, "getU16", t_dv_getu16, 1);
@@ -558,6 +1269,34 @@ Init_dataview() {
   rb_define_method(cDataView, "setU24", t_dv_setu24, 2);
   rb_define_method(cDataView, "setU32", t_dv_setu32, 2);
 
+  rb_define_method(cDataView, "getI8", t_dv_geti8, 1);
+  rb_define_method(cDataView, "getI16", t_dv_geti16, 1);
+  rb_define_method(cDataView, "getI24", t_dv_geti24, 1);
+  rb_define_method(cDataView, "getI32", t_dv_geti32, 1);
+  rb_define_method(cDataView, "getI64", t_dv_geti64, 1);
+  rb_define_method(cDataView, "getU64", t_dv_getu64, 1);
+  rb_define_method(cDataView, "getF32", t_dv_getf32, 1);
+  rb_define_method(cDataView, "getF64", t_dv_getf64, 1);
+
+  rb_define_method(cDataView, "setI8", t_dv_seti8, 2);
+  rb_define_method(cDataView, "setI16", t_dv_seti16, 2);
+  rb_define_method(cDataView, "setI24", t_dv_seti24, 2);
+  rb_define_method(cDataView, "setI32", t_dv_seti32, 2);
+  rb_define_method(cDataView, "setI64", t_dv_seti64, 2);
+  rb_define_method(cDataView, "setU64", t_dv_setu64, 2);
+  rb_define_method(cDataView, "setF32", t_dv_setf32, 2);
+  rb_define_method(cDataView, "setF64", t_dv_setf64, 2);
+
+  rb_define_method(cDataView, "getU8Array", t_dv_getu8array, 2);
+  rb_define_method(cDataView, "getU16Array", t_dv_getu16array, 2);
+  rb_define_method(cDataView, "getU24Array", t_dv_getu24array, 2);
+  rb_define_method(cDataView, "getU32Array", t_dv_getu32array, 2);
+
+  rb_define_method(cDataView, "setU8Array", t_dv_setu8array, 2);
+  rb_define_method(cDataView, "setU16Array", t_dv_setu16array, 2);
+  rb_define_method(cDataView, "setU24Array", t_dv_setu24array, 2);
+  rb_define_method(cDataView, "setU32Array", t_dv_setu32array, 2);
+
   rb_define_method(cDataView, "setBytes", t_dv_setbytes, 2);
 
   rb_define_method(cDataView, "endianess", t_dv_endianess, 0);
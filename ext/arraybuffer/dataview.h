@@ -2,12 +2,40 @@
 #define LLC_DATAVIEW_H
 
 #include <ruby.h>
+#include <stdint.h>
 
 struct LLC_DataView {
   VALUE bb_obj;
-  unsigned int offset;
-  unsigned int size;
+  size_t offset;
+  size_t size;
   unsigned char flags;
 };
 
+extern const rb_data_type_t llc_dataview_type;
+
+#define DECLAREDV(o) \
+  struct LLC_DataView *dv = (struct LLC_DataView*)rb_check_typeddata((o), &llc_dataview_type)
+
+/* Element types shared by the native decoders, named :u8, :i16, :f64... */
+enum llc_value_type {
+  LLC_U8, LLC_U16, LLC_U24, LLC_U32, LLC_U64,
+  LLC_I8, LLC_I16, LLC_I24, LLC_I32, LLC_I64,
+  LLC_F32, LLC_F64,
+  LLC_TYPE_COUNT
+};
+
+extern const unsigned char llc_type_widths[LLC_TYPE_COUNT];
+
+int llc_find_type(VALUE type);
+int llc_parse_type(VALUE type);
+VALUE llc_type_symbol(int type);
+VALUE llc_decode_value(const unsigned char *p, int type, int little);
+uint64_t llc_encode_value(VALUE value, int type);
+
+int llc_parse_endianess(VALUE endianess);
+VALUE llc_dv_new(VALUE bb_obj, size_t offset, size_t size, int little);
+unsigned char *llc_view_bytes(VALUE obj, size_t *len, int *little, int writable);
+int64_t llc_capped_int(VALUE value, int64_t min, int64_t max);
+uint64_t llc_capped_uint64(VALUE value);
+
 #endif
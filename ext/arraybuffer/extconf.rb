@@ -7,5 +7,23 @@ if have_header("ruby/memory_view.h")
   have_type("rb_memory_view_t", ["ruby/memory_view.h"])
 end
 
+if have_header("ruby/io/buffer.h")
+  have_func("rb_io_buffer_get_bytes", "ruby/io/buffer.h")
+end
+
+if have_header("sys/mman.h")
+  have_func("mmap", "sys/mman.h")
+  have_func("msync", "sys/mman.h")
+end
+
+have_func("pread", "unistd.h")
+have_func("pwrite", "unistd.h")
+have_header("sys/uio.h")
+have_func("rb_io_descriptor", "ruby/io.h")
+have_func("rb_io_maybe_wait_readable", "ruby/io.h")
+
+have_func("memrchr", "string.h")
+have_func("memmem", "string.h")
+
 create_header
 create_makefile 'arraybuffer_ext'
@@ -0,0 +1,520 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <ruby/io.h>
+#include <ruby/thread.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static ID idPos = Qundef;
+static ID idReadpartial = Qundef;
+
+struct io_args {
+  int fd;
+  int write;
+  unsigned char *ptr;
+  size_t length;
+#ifdef HAVE_SYS_UIO_H
+  struct iovec *iov;
+  int iovcnt;
+#endif
+  int positional;
+  off_t pos;
+  ssize_t result;
+  int error;
+};
+
+/*
+ * Makes a single read(2), write(2), pread(2), pwrite(2), readv(2) or
+ * writev(2) call. Runs without the GVL.
+ */
+static void *
+io_kernel(void *ptr) {
+  struct io_args *args = (struct io_args*)ptr;
+  ssize_t n;
+#ifdef HAVE_SYS_UIO_H
+  if (args->iov) {
+    n = args->write ?
+      writev(args->fd, args->iov, args->iovcnt) :
+      readv(args->fd, args->iov, args->iovcnt);
+  } else
+#endif
+  if (args->positional) {
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+    n = args->write ?
+      pwrite(args->fd, args->ptr, args->length, args->pos) :
+      pread(args->fd, args->ptr, args->length, args->pos);
+#else
+    n = -1;
+    errno = ENOSYS;
+#endif
+  } else {
+    n = args->write ?
+      write(args->fd, args->ptr, args->length) :
+      read(args->fd, args->ptr, args->length);
+  }
+  args->result = n;
+  args->error = n < 0 ? errno : 0;
+  return NULL;
+}
+
+/*
+ * Waits until +io+ is ready after a call failed with +error+, which goes
+ * through the Fiber scheduler when there is one. Returns zero if the error
+ * is not about the IO being not ready yet.
+ */
+static int
+io_wait(VALUE io, int fd, int error, int write) {
+#ifdef HAVE_RB_IO_MAYBE_WAIT_READABLE
+  return write ?
+    rb_io_maybe_wait_writable(error, io, Qnil) :
+    rb_io_maybe_wait_readable(error, io, Qnil);
+#else
+  errno = error;
+  return write ? rb_io_wait_writable(fd) : rb_io_wait_readable(fd);
+#endif
+}
+
+/*
+ * Advances the pending part of a write past +n+ bytes that were written.
+ * Returns whether anything is left.
+ */
+static int
+io_advance(struct io_args *args, size_t n) {
+#ifdef HAVE_SYS_UIO_H
+  if (args->iov) {
+    while (args->iovcnt && n >= args->iov->iov_len) {
+      n -= args->iov->iov_len;
+      args->iov++;
+      args->iovcnt--;
+    }
+    if (args->iovcnt) {
+      args->iov->iov_base = (char*)args->iov->iov_base + n;
+      args->iov->iov_len -= n;
+    }
+    return args->iovcnt > 0;
+  }
+#endif
+  args->ptr += n;
+  args->length -= n;
+  args->pos += (off_t)n;
+  return args->length > 0;
+}
+
+struct io_call {
+  VALUE io;
+  struct io_args *args;
+  const VALUE *objs;
+  long count;
+  long pinned;
+  size_t done;
+};
+
+static VALUE
+io_call_body(VALUE data) {
+  struct io_call *call = (struct io_call*)data;
+  struct io_args *args = call->args;
+  for (; call->pinned < call->count; call->pinned++)
+    llc_bb_pin(call->objs[call->pinned]);
+
+  for (;;) {
+    rb_thread_call_without_gvl(io_kernel, args, RUBY_UBF_IO, NULL);
+    if (args->result < 0) {
+      if (!io_wait(call->io, args->fd, args->error, args->write))
+        rb_syserr_fail(args->error, args->write ? "write" : "read");
+      continue;
+    }
+
+    // Reads return as soon as there is something, writes go on until
+    // everything is written
+    call->done += (size_t)args->result;
+    if (!args->write || !io_advance(args, (size_t)args->result))
+      return Qnil;
+  }
+}
+
+static VALUE
+io_call_ensure(VALUE data) {
+  struct io_call *call = (struct io_call*)data;
+  while (call->pinned > 0)
+    llc_bb_unpin(call->objs[--call->pinned]);
+  return Qnil;
+}
+
+/*
+ * Runs the system call described by +args+ over the memory of +objs+,
+ * which stay pinned until it is done. Waits for +io+ whenever it would
+ * block. Returns how many bytes were transferred.
+ */
+static size_t
+io_call(VALUE io, struct io_args *args, const VALUE *objs, long count) {
+  struct io_call call = { io, args, objs, count, 0, 0 };
+  rb_ensure(io_call_body, (VALUE)&call, io_call_ensure, (VALUE)&call);
+  return call.done;
+}
+
+/*
+ * Checks that +io+ can be read from, or written to, and returns its file
+ * descriptor. Data buffered by Ruby for writing is flushed first, so it
+ * goes out before ours.
+ */
+static int
+io_prepare(VALUE io, int write, int *pending) {
+  rb_io_t *fptr;
+  GetOpenFile(io, fptr);
+  if (write) {
+    rb_io_check_writable(fptr);
+    rb_io_flush(io);
+  } else {
+    rb_io_check_byte_readable(fptr);
+    if (pending)
+      *pending = rb_io_read_pending(fptr);
+  }
+#ifdef HAVE_RB_IO_DESCRIPTOR
+  return rb_io_descriptor(io);
+#else
+  return fptr->fd;
+#endif
+}
+
+/*
+ * Parses the +pos:+ keyword. Returns whether it was given.
+ */
+static int
+io_parse_pos(VALUE kwargs, off_t *pos) {
+  static ID keyword_ids[] = { 0 };
+  VALUE value = Qundef;
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idPos;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &value);
+  if (value == Qundef || NIL_P(value))
+    return 0;
+
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+  *pos = NUM2OFFT(value);
+  if (*pos < 0)
+    rb_raise(rb_eArgError, "position must not be negative");
+  return 1;
+#else
+  rb_notimplement();
+  return 0;
+#endif
+}
+
+/*
+ * The offset and length arguments of #read_from and #write_to, converted
+ * before the bytes are taken, as converting may run Ruby code that resizes
+ * the buffer. A nil length stands for all the bytes from the offset on.
+ */
+struct io_span {
+  size_t from;
+  size_t length;
+  int all;
+};
+
+static void
+io_span_convert(VALUE offset, VALUE length, struct io_span *span) {
+  span->from = NIL_P(offset) ? 0 : NUM2SIZET(offset);
+  span->all = NIL_P(length);
+  span->length = span->all ? 0 : NUM2SIZET(length);
+}
+
+/*
+ * Resolves +span+ within the bytes of +self+.
+ */
+static unsigned char *
+io_range(VALUE self, const struct io_span *span, int writable, size_t *count) {
+  size_t size;
+  unsigned char *ptr = llc_view_bytes(self, &size, NULL, writable);
+  if (span->from > size)
+    rb_raise(rb_eArgError, "offset out of bounds: %"PRIuSIZE, span->from);
+  *count = span->all ? size - span->from : span->length;
+  if (*count > size - span->from)
+    rb_raise(rb_eArgError, "length out of bounds: %"PRIuSIZE, *count);
+  return ptr + span->from;
+}
+
+/*
+ * Reads data Ruby already buffered for +io+, which must be consumed before
+ * reading from the file descriptor, into +self+.
+ */
+static size_t
+io_read_pending(VALUE io, VALUE self, size_t from, size_t count) {
+  VALUE str = rb_funcall(io, idReadpartial, 1, SIZET2NUM(count));
+  const size_t n = (size_t)RSTRING_LEN(str);
+  // Resolved again, as reading ran Ruby code
+  const struct io_span rest = { from, 0, 1 };
+  size_t available;
+  unsigned char *ptr = io_range(self, &rest, 1, &available);
+  if (n > available)
+    rb_raise(rb_eRuntimeError, "buffer shrank while reading");
+  memcpy(ptr, RSTRING_PTR(str), n);
+  return n;
+}
+
+/*
+ * call-seq:
+ *  read_from(io, offset = 0, length = nil, pos: nil)
+ *
+ * Reads up to +length+ bytes from +io+ straight into the memory at
+ * +offset+, without going through a String.
+ *
+ * Like IO#readpartial, it returns as soon as some data is available. When
+ * +io+ is non-blocking, it waits for data through IO#wait, and so through
+ * the Fiber scheduler if there is one. The GVL is released while reading.
+ *
+ * With +pos+, reads from that position of the file with pread(2), without
+ * moving its offset.
+ *
+ * Example:
+ *   n = buffer.read_from(socket, filled)
+ *   filled += n if n
+ *
+ * @param io [IO]
+ * @param length [Integer] Optional. Defaults to the bytes from +offset+ on
+ * @param pos [Integer] Optional. Position in the file to read from
+ * @return [Integer, nil] The count of bytes read, or nil at end of file
+ */
+static VALUE
+t_read_from(int argc, VALUE *argv, VALUE self) {
+  VALUE io;
+  VALUE offset;
+  VALUE length;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "12:", &io, &offset, &length, &kwargs);
+  struct io_span span;
+  io_span_convert(offset, length, &span);
+
+  struct io_args args;
+  memset(&args, 0, sizeof(args));
+  args.positional = io_parse_pos(kwargs, &args.pos);
+
+  io = rb_io_get_io(io);
+  int pending = 0;
+  args.fd = io_prepare(io, 0, &pending);
+  args.ptr = io_range(self, &span, 1, &args.length);
+  if (!args.length)
+    return INT2FIX(0);
+
+  size_t n;
+  if (pending && !args.positional)
+    n = io_read_pending(io, self, span.from, args.length);
+  else
+    n = io_call(io, &args, &self, 1);
+  return n ? SIZET2NUM(n) : Qnil;
+}
+
+/*
+ * call-seq:
+ *  write_to(io, offset = 0, length = nil, pos: nil)
+ *
+ * Writes +length+ bytes from +offset+ to +io+, straight from the memory,
+ * without going through a String.
+ *
+ * Like IO#write, it writes all the bytes, waiting whenever +io+ is not
+ * ready. The GVL is released while writing.
+ *
+ * With +pos+, writes at that position of the file with pwrite(2), without
+ * moving its offset.
+ *
+ * @param io [IO]
+ * @param length [Integer] Optional. Defaults to the bytes from +offset+ on
+ * @param pos [Integer] Optional. Position in the file to write at
+ * @return [Integer] The count of bytes written
+ */
+static VALUE
+t_write_to(int argc, VALUE *argv, VALUE self) {
+  VALUE io;
+  VALUE offset;
+  VALUE length;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "12:", &io, &offset, &length, &kwargs);
+  struct io_span span;
+  io_span_convert(offset, length, &span);
+
+  struct io_args args;
+  memset(&args, 0, sizeof(args));
+  args.write = 1;
+  args.positional = io_parse_pos(kwargs, &args.pos);
+
+  io = rb_io_get_io(io);
+  args.fd = io_prepare(io, 1, NULL);
+  args.ptr = io_range(self, &span, 0, &args.length);
+  if (!args.length)
+    return INT2FIX(0);
+  return SIZET2NUM(io_call(io, &args, &self, 1));
+}
+
+#ifdef HAVE_SYS_UIO_H
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/*
+ * Fills +iov+ with the bytes of each of +views+ and returns their total.
+ */
+static size_t
+io_fill_iov(struct iovec *iov, VALUE views, int writable) {
+  size_t total = 0;
+  for (long i = 0; i < RARRAY_LEN(views); i++) {
+    size_t len;
+    iov[i].iov_base = llc_view_bytes(RARRAY_AREF(views, i), &len, NULL, writable);
+    iov[i].iov_len = len;
+    total += len;
+  }
+  return total;
+}
+#endif
+
+/*
+ * Copies the Array +views+, so the views pinned during a system call can't
+ * be swapped by other threads meanwhile.
+ */
+static VALUE
+io_views(VALUE views) {
+  Check_Type(views, T_ARRAY);
+  views = rb_ary_dup(views);
+#ifdef HAVE_SYS_UIO_H
+  if (RARRAY_LEN(views) > IOV_MAX)
+    rb_raise(rb_eArgError, "too many views: %ld, at most %d", RARRAY_LEN(views), IOV_MAX);
+#endif
+  return views;
+}
+
+/*
+ * call-seq:
+ *  DataView.readv(io, views)
+ *
+ * Reads from +io+ into +views+, filling one after the other, with a single
+ * readv(2) call. Returns as soon as some data is available, like #read_from.
+ *
+ * Example:
+ *   header = DataView.new(buffer, 0, 16)
+ *   body = DataView.new(buffer, 16)
+ *   DataView.readv(socket, [header, body])
+ *
+ * @param io [IO]
+ * @param views [Array<DataView, ArrayBuffer>]
+ * @return [Integer, nil] The count of bytes read, or nil at end of file
+ */
+static VALUE
+t_dv_s_readv(VALUE klass, VALUE io, VALUE views) {
+#ifdef HAVE_SYS_UIO_H
+  views = io_views(views);
+  io = rb_io_get_io(io);
+  int pending = 0;
+  struct io_args args;
+  memset(&args, 0, sizeof(args));
+  args.fd = io_prepare(io, 0, &pending);
+
+  VALUE iov_store;
+  const long count = RARRAY_LEN(views);
+  args.iov = ALLOCV_N(struct iovec, iov_store, count ? count : 1);
+  args.iovcnt = (int)count;
+  size_t total = io_fill_iov(args.iov, views, 1);
+
+  size_t n = 0;
+  if (total && pending) {
+    VALUE str = rb_funcall(io, idReadpartial, 1, SIZET2NUM(total));
+    n = (size_t)RSTRING_LEN(str);
+    // Resolved again, as reading ran Ruby code
+    if (io_fill_iov(args.iov, views, 1) < n)
+      rb_raise(rb_eRuntimeError, "views shrank while reading");
+    const char *src = RSTRING_PTR(str);
+    size_t left = n;
+    for (int i = 0; left; i++) {
+      const size_t chunk = left < args.iov[i].iov_len ? left : args.iov[i].iov_len;
+      memcpy(args.iov[i].iov_base, src, chunk);
+      src += chunk;
+      left -= chunk;
+    }
+  } else if (total) {
+    n = io_call(io, &args, RARRAY_CONST_PTR(views), count);
+  }
+  ALLOCV_END(iov_store);
+  RB_GC_GUARD(views);
+
+  if (!total)
+    return INT2FIX(0);
+  return n ? SIZET2NUM(n) : Qnil;
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
+/*
+ * call-seq:
+ *  DataView.writev(io, views)
+ *
+ * Writes the bytes of all +views+ to +io+, in order, with writev(2), so
+ * a frame made of separate views goes out without being joined first.
+ *
+ * Like #write_to, it writes all the bytes, waiting whenever +io+ is not
+ * ready.
+ *
+ * Example:
+ *   header.setU32(0, body.size)
+ *   DataView.writev(socket, [header, body])
+ *
+ * @param io [IO]
+ * @param views [Array<DataView, ArrayBuffer>]
+ * @return [Integer] The count of bytes written
+ */
+static VALUE
+t_dv_s_writev(VALUE klass, VALUE io, VALUE views) {
+#ifdef HAVE_SYS_UIO_H
+  views = io_views(views);
+  io = rb_io_get_io(io);
+  struct io_args args;
+  memset(&args, 0, sizeof(args));
+  args.write = 1;
+  args.fd = io_prepare(io, 1, NULL);
+
+  VALUE iov_store;
+  const long count = RARRAY_LEN(views);
+  args.iov = ALLOCV_N(struct iovec, iov_store, count ? count : 1);
+  args.iovcnt = (int)count;
+  const size_t total = io_fill_iov(args.iov, views, 0);
+
+  size_t n = 0;
+  if (total)
+    n = io_call(io, &args, RARRAY_CONST_PTR(views), count);
+  ALLOCV_END(iov_store);
+  RB_GC_GUARD(views);
+  return SIZET2NUM(n);
+#else
+  rb_notimplement();
+  return Qnil;
+#endif
+}
+
+static void
+define_io_methods(VALUE klass) {
+  rb_define_method(klass, "read_from", t_read_from, -1);
+  rb_define_method(klass, "write_to", t_write_to, -1);
+}
+
+void
+Init_io() {
+  idPos = rb_intern("pos");
+  idReadpartial = rb_intern("readpartial");
+
+  define_io_methods(cArrayBuffer);
+  define_io_methods(cDataView);
+  rb_define_singleton_method(cDataView, "readv", t_dv_s_readv, 2);
+  rb_define_singleton_method(cDataView, "writev", t_dv_s_writev, 2);
+}
@@ -0,0 +1,448 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static ID idDelta = Qundef;
+static ID idEndianess = Qundef;
+static ID idRealloc = Qundef;
+static ID idShrinkToFit = Qundef;
+
+/*
+ * Packed integers are stored as a 17 bytes header, a flags byte then the
+ * count of values and the first one, or zero without delta encoding, as
+ * little endian 64 bits integers, followed by blocks of PACK_BLOCK values,
+ * the last one possibly shorter.
+ *
+ * Each block holds its smallest value, the reference, as a little endian
+ * integer as wide as the values, then a byte with the bit width of the
+ * largest difference to the reference, then those differences bit-packed
+ * LSB-first in that width. With delta encoding, the differences between
+ * consecutive values are packed instead of the values themselves.
+ */
+#define PACK_BLOCK 128
+#define PACK_HEADER_SIZE 17
+#define PACK_FLAG_DELTA 1
+#define PACK_FLAG_64 2
+
+struct pack_args {
+  const unsigned char *src;
+  unsigned char *dst;
+  size_t count;
+  size_t size;
+  uint64_t base;
+  unsigned int width;
+  int little;
+  int delta;
+  int error;
+};
+
+static inline uint64_t
+pack_mask(unsigned int width) {
+  return width == 8 ? UINT64_MAX : UINT64_C(0xFFFFFFFF);
+}
+
+static inline unsigned int
+pack_bit_width(uint64_t range) {
+  return range ? 64 - (unsigned int)__builtin_clzll(range) : 0;
+}
+
+static inline size_t
+pack_block_bytes(size_t n, unsigned int bits) {
+  return (n * bits + 7) / 8;
+}
+
+/*
+ * Loads the +n+ values of a block, replacing them with their deltas when
+ * delta encoding. +prev+ carries the last value over to the next block.
+ * Returns the smallest one and stores the bit width of the block in +bits+.
+ */
+static inline uint64_t
+pack_load_block(const unsigned char *src, size_t n, unsigned int width, int little, int delta,
+    uint64_t *prev, uint64_t *values, unsigned int *bits) {
+  const uint64_t mask = pack_mask(width);
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+  for (size_t i = 0; i < n; i++, src += width) {
+    const uint64_t val = llc_load_uint(src, width, little);
+    values[i] = delta ? (val - *prev) & mask : val;
+    *prev = val;
+    if (values[i] < min)
+      min = values[i];
+    if (values[i] > max)
+      max = values[i];
+  }
+  *bits = pack_bit_width(max - min);
+  return min;
+}
+
+/*
+ * Appends the lower +bits+ bits, at most 32, of +val+ to the bits pending
+ * in +acc+, writing them out 4 bytes at a time.
+ */
+#define PACK_PUSH(val, bits) do { \
+    acc |= (val) << pending; \
+    pending += (bits); \
+    if (pending >= 32) { \
+      llc_store_uint(p, 4, 1, acc); \
+      p += 4; \
+      acc >>= 32; \
+      pending -= 32; \
+    } \
+  } while (0)
+
+/*
+ * Bit-packs the differences of +values+ to +min+ in +bits+ bits each.
+ */
+static inline unsigned char *
+pack_bits(unsigned char *p, const uint64_t *values, size_t n, uint64_t min, unsigned int bits) {
+  uint64_t acc = 0;
+  unsigned int pending = 0;
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t val = values[i] - min;
+    if (bits > 32) {
+      PACK_PUSH(val & UINT64_C(0xFFFFFFFF), 32);
+      PACK_PUSH(val >> 32, bits - 32);
+    } else {
+      PACK_PUSH(val, bits);
+    }
+  }
+  for (; pending > 0; pending = pending > 8 ? pending - 8 : 0, acc >>= 8)
+    *p++ = (unsigned char)acc;
+  return p;
+}
+
+/*
+ * Encodes the values of +args+ into +dst+, which must have room for the
+ * widest blocks, and stores how many bytes were written in +size+.
+ * +width+ and +little+ are given as constants by PACK_DISPATCH so the loads
+ * are inlined.
+ */
+static inline void
+pack_blocks(struct pack_args *args, unsigned int width, int little) {
+  uint64_t values[PACK_BLOCK];
+  uint64_t prev = args->base;
+  unsigned char *p = args->dst;
+
+  *p++ = (unsigned char)((args->delta ? PACK_FLAG_DELTA : 0) | (width == 8 ? PACK_FLAG_64 : 0));
+  llc_store_uint(p, 8, 1, (uint64_t)args->count);
+  llc_store_uint(p + 8, 8, 1, args->base);
+  p += 16;
+
+  for (size_t start = 0; start < args->count; start += PACK_BLOCK) {
+    const size_t n = args->count - start < PACK_BLOCK ? args->count - start : PACK_BLOCK;
+    unsigned int bits;
+    const uint64_t min = pack_load_block(args->src + start * width, n, width, little, args->delta,
+      &prev, values, &bits);
+    llc_store_uint(p, width, 1, min);
+    p += width;
+    *p++ = (unsigned char)bits;
+    if (bits)
+      p = pack_bits(p, values, n, min, bits);
+  }
+  args->size = (size_t)(p - args->dst);
+}
+
+/*
+ * Extracts the +bits+ bits long value at +pos+ out of the +len+ bytes of
+ * a block, with a single 8 bytes load wherever they are available.
+ */
+static inline uint64_t
+unpack_value(const unsigned char *p, size_t len, size_t pos, unsigned int bits) {
+  const size_t idx = pos / 8;
+  const unsigned int shift = pos % 8;
+  uint64_t val;
+  if (idx + 8 <= len) {
+    val = llc_load_uint(p + idx, 8, 1) >> shift;
+    // Only widths above 56 bits can spill into a ninth byte
+    if (shift + bits > 64)
+      val |= (uint64_t)p[idx + 8] << (64 - shift);
+  } else {
+    val = 0;
+    for (size_t i = 0; idx + i < len; i++)
+      val |= (uint64_t)p[idx + i] << (8 * i);
+    val >>= shift;
+  }
+  return bits == 64 ? val : val & ((UINT64_C(1) << bits) - 1);
+}
+
+static inline void
+unpack_blocks(struct pack_args *args, unsigned int width, int little) {
+  const uint64_t mask = pack_mask(width);
+  const unsigned char *p = args->src + PACK_HEADER_SIZE;
+  const unsigned char *end = args->src + args->size;
+  unsigned char *dst = args->dst;
+  uint64_t prev = args->base;
+
+  for (size_t start = 0; start < args->count; start += PACK_BLOCK) {
+    const size_t n = args->count - start < PACK_BLOCK ? args->count - start : PACK_BLOCK;
+    if ((size_t)(end - p) < width + 1) {
+      args->error = 1;
+      return;
+    }
+    const uint64_t min = llc_load_uint(p, width, 1);
+    p += width;
+    const unsigned int bits = *p++;
+    const size_t len = pack_block_bytes(n, bits);
+    if (bits > width * 8 || (size_t)(end - p) < len) {
+      args->error = 1;
+      return;
+    }
+
+    if (!args->delta) {
+      for (size_t i = 0; i < n; i++, dst += width) {
+        const uint64_t val = bits ? unpack_value(p, len, i * bits, bits) : 0;
+        llc_store_uint(dst, width, little, (val + min) & mask);
+      }
+    } else {
+      for (size_t i = 0; i < n; i++, dst += width) {
+        const uint64_t val = bits ? unpack_value(p, len, i * bits, bits) : 0;
+        prev = (prev + val + min) & mask;
+        llc_store_uint(dst, width, little, prev);
+      }
+    }
+    p += len;
+  }
+}
+
+/*
+ * Calls +func+ with the width and byte order of +args+ as constants.
+ */
+#define PACK_DISPATCH(func, args) do { \
+    if ((args)->width == 8) { \
+      if ((args)->little) func((args), 8, 1); else func((args), 8, 0); \
+    } else { \
+      if ((args)->little) func((args), 4, 1); else func((args), 4, 0); \
+    } \
+  } while (0)
+
+static void *
+pack_kernel(void *ptr) {
+  PACK_DISPATCH(pack_blocks, (struct pack_args*)ptr);
+  return NULL;
+}
+
+static void *
+unpack_kernel(void *ptr) {
+  PACK_DISPATCH(unpack_blocks, (struct pack_args*)ptr);
+  return NULL;
+}
+
+static int
+pack_endianess_kwarg(VALUE endianess, int little) {
+  return endianess == Qundef ? little : llc_parse_endianess(endianess);
+}
+
+static VALUE
+pack_encode(int argc, VALUE *argv, VALUE self, unsigned int width) {
+  VALUE index;
+  VALUE count;
+  VALUE kwargs;
+  VALUE options[2] = { Qundef, Qundef };
+  static ID keyword_ids[] = { 0, 0 };
+  rb_scan_args(argc, argv, "02:", &index, &count, &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idDelta;
+    keyword_ids[1] = idEndianess;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 2, options);
+
+  const size_t from = NIL_P(index) ? 0 : NUM2SIZET(index);
+  const size_t n = NIL_P(count) ? 0 : NUM2SIZET(count);
+
+  struct pack_args args;
+  memset(&args, 0, sizeof(args));
+  args.width = width;
+  args.delta = options[0] != Qundef && RTEST(options[0]);
+
+  size_t len;
+  int little;
+  args.src = llc_view_bytes(self, &len, &little, 0);
+  args.little = pack_endianess_kwarg(options[1], little);
+  if (from > len)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIuSIZE, from);
+  args.count = NIL_P(count) ? (len - from) / width : n;
+  if (args.count > (len - from) / width)
+    rb_raise(rb_eArgError, "count out of bounds: %"PRIuSIZE, args.count);
+  args.src += from;
+  // Starting deltas from the first value keeps the first block narrow
+  if (args.delta && args.count)
+    args.base = llc_load_uint(args.src, width, args.little);
+
+  /*
+   * Encoding in a single pass into room for the worst case, so another
+   * thread changing the values while the GVL is released can't make blocks
+   * wider than what was allocated.
+   */
+  const size_t blocks = (args.count + PACK_BLOCK - 1) / PACK_BLOCK;
+  // There are no more blocks than values
+  if (args.count > (LONG_MAX - PACK_HEADER_SIZE) / (2 * width + 1))
+    rb_raise(rb_eArgError, "too many values: %"PRIuSIZE, args.count);
+  const size_t max_size = PACK_HEADER_SIZE + blocks * (width + 1) + args.count * width;
+
+  VALUE packed = llc_bb_new(max_size, max_size);
+  // Allocating may have run GC, but not Ruby code, so the source is intact
+  args.src = llc_view_bytes(self, &len, NULL, 0) + from;
+  args.dst = llc_view_bytes(packed, &len, NULL, 1);
+  llc_run_kernel(args.count * width, pack_kernel, &args, self, packed);
+
+  rb_funcall(packed, idRealloc, 1, SIZET2NUM(args.size));
+  rb_funcall(packed, idShrinkToFit, 0);
+  return packed;
+}
+
+static VALUE
+pack_decode(int argc, VALUE *argv, VALUE self, unsigned int width) {
+  VALUE target;
+  VALUE index;
+  VALUE kwargs;
+  VALUE endianess = Qundef;
+  static ID keyword_ids[] = { 0 };
+  rb_scan_args(argc, argv, "02:", &target, &index, &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idEndianess;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+
+  struct pack_args args;
+  memset(&args, 0, sizeof(args));
+  args.width = width;
+  args.src = llc_view_bytes(self, &args.size, NULL, 0);
+  if (args.size < PACK_HEADER_SIZE)
+    rb_raise(rb_eArgError, "not packed integers: too short");
+  const unsigned int flags = args.src[0];
+  if (flags & ~(PACK_FLAG_DELTA | PACK_FLAG_64))
+    rb_raise(rb_eArgError, "not packed integers: unknown flags %u", flags);
+  if (((flags & PACK_FLAG_64) ? 8 : 4) != width)
+    rb_raise(rb_eArgError, "packed integers are %u bytes long, not %u", (flags & PACK_FLAG_64) ? 8 : 4, width);
+  args.delta = (flags & PACK_FLAG_DELTA) != 0;
+  const uint64_t count = llc_load_uint(args.src + 1, 8, 1);
+  // Every block takes at least width + 1 bytes
+  if (count / PACK_BLOCK > args.size / (width + 1) || count > LONG_MAX / width)
+    rb_raise(rb_eArgError, "malformed packed integers");
+  args.count = (size_t)count;
+  args.base = llc_load_uint(args.src + 9, 8, 1);
+
+  const size_t from = NIL_P(index) ? 0 : NUM2SIZET(index);
+  size_t len;
+  int little = 0;
+  if (NIL_P(target)) {
+    if (from)
+      rb_raise(rb_eArgError, "index is only allowed with a target");
+    target = llc_bb_new(args.count * width, args.count * width);
+  }
+  args.dst = llc_view_bytes(target, &len, &little, 1);
+  args.little = pack_endianess_kwarg(endianess, little);
+  if (from > len || args.count > (len - from) / width)
+    rb_raise(rb_eArgError, "%"PRIuSIZE" bytes needed at %"PRIuSIZE", but only %"PRIuSIZE" available",
+      args.count * width, from, from > len ? (size_t)0 : len - from);
+  args.dst += from;
+
+  // Allocating the target may have run GC, but not Ruby code
+  args.src = llc_view_bytes(self, &args.size, NULL, 0);
+  llc_run_kernel(args.count * width, unpack_kernel, &args, self, target);
+  if (args.error)
+    rb_raise(rb_eArgError, "malformed packed integers");
+  return target;
+}
+
+/*
+ * call-seq:
+ *  encode_u32(index = 0, count = nil, delta: false, endianess: nil)
+ *
+ * Compresses +count+ 4 bytes long unsigned integers starting at +index+
+ * into a new ArrayBuffer.
+ *
+ * Values are split into blocks of 128. Each block stores its smallest
+ * value and the differences to it, bit-packed in as many bits as the
+ * largest one needs (frame of reference). With +delta+, the differences
+ * between consecutive values are packed instead, which suits sorted ids
+ * and timestamps best.
+ *
+ * Example:
+ *   packed = ids.encode_u32(delta: true)
+ *   packed.decode_u32(column, 0)
+ *
+ * @param count [Integer] Optional. Defaults to all the values from +index+
+ * @param delta [Boolean] Optional. Whether to pack consecutive differences
+ * @param endianess [:big, :little] Optional. Defaults to the endianess of
+ *   the DataView, or big endian for an ArrayBuffer
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_encode_u32(int argc, VALUE *argv, VALUE self) {
+  return pack_encode(argc, argv, self, 4);
+}
+
+/*
+ * call-seq:
+ *  encode_u64(index = 0, count = nil, delta: false, endianess: nil)
+ *
+ * Compresses 8 bytes long unsigned integers, like #encode_u32 does.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_encode_u64(int argc, VALUE *argv, VALUE self) {
+  return pack_encode(argc, argv, self, 8);
+}
+
+/*
+ * call-seq:
+ *  decode_u32(target = nil, index = 0, endianess: nil)
+ *
+ * Decompresses integers packed by #encode_u32, writing them to +target+
+ * from +index+ on, or to a new ArrayBuffer if no target is given.
+ *
+ * Raises ArgumentError if the bytes are not integers packed by
+ * #encode_u32, or if the target is too small.
+ *
+ * @param target [ArrayBuffer, DataView] Optional
+ * @param endianess [:big, :little] Optional. Defaults to the endianess of
+ *   the target DataView, or big endian for an ArrayBuffer
+ * @return [ArrayBuffer, DataView] The target
+ */
+static VALUE
+t_decode_u32(int argc, VALUE *argv, VALUE self) {
+  return pack_decode(argc, argv, self, 4);
+}
+
+/*
+ * call-seq:
+ *  decode_u64(target = nil, index = 0, endianess: nil)
+ *
+ * Decompresses integers packed by #encode_u64, like #decode_u32 does.
+ *
+ * @return [ArrayBuffer, DataView] The target
+ */
+static VALUE
+t_decode_u64(int argc, VALUE *argv, VALUE self) {
+  return pack_decode(argc, argv, self, 8);
+}
+
+static void
+define_pack_methods(VALUE klass) {
+  rb_define_method(klass, "encode_u32", t_encode_u32, -1);
+  rb_define_method(klass, "encode_u64", t_encode_u64, -1);
+  rb_define_method(klass, "decode_u32", t_decode_u32, -1);
+  rb_define_method(klass, "decode_u64", t_decode_u64, -1);
+}
+
+void
+Init_pack() {
+  idDelta = rb_intern("delta");
+  idEndianess = rb_intern("endianess");
+  idRealloc = rb_intern("realloc");
+  idShrinkToFit = rb_intern("shrink_to_fit");
+
+  define_pack_methods(cArrayBuffer);
+  define_pack_methods(cDataView);
+}
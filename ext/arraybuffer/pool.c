@@ -0,0 +1,308 @@
+#include "arraybuffer.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cPool;
+
+static ID idSizeClasses = Qundef;
+static ID idMaxPerClass = Qundef;
+
+static const size_t default_size_classes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+
+struct LLC_Pool {
+  size_t *classes;
+  long class_count;
+  long max_per_class;
+  VALUE free_lists;
+  size_t hits;
+  size_t misses;
+  size_t releases;
+  size_t discards;
+};
+
+#define DECLAREPOOL(o) \
+  struct LLC_Pool *pool = (struct LLC_Pool*)rb_check_typeddata((o), &pool_type)
+
+static void
+t_pool_gc_mark(void *ptr) {
+  struct LLC_Pool *pool = (struct LLC_Pool*)ptr;
+  if (pool->free_lists)
+    rb_gc_mark_movable(pool->free_lists);
+}
+
+static void
+t_pool_free(void *ptr) {
+  struct LLC_Pool *pool = (struct LLC_Pool*)ptr;
+  xfree(pool->classes);
+  xfree(pool);
+}
+
+static size_t
+t_pool_memsize(const void *ptr) {
+  const struct LLC_Pool *pool = (const struct LLC_Pool*)ptr;
+  return sizeof(struct LLC_Pool) + (size_t)pool->class_count * sizeof(size_t);
+}
+
+static void
+t_pool_compact(void *ptr) {
+  struct LLC_Pool *pool = (struct LLC_Pool*)ptr;
+  if (pool->free_lists)
+    pool->free_lists = rb_gc_location(pool->free_lists);
+}
+
+static const rb_data_type_t pool_type = {
+  "ArrayBuffer::Pool",
+  { t_pool_gc_mark, t_pool_free, t_pool_memsize, t_pool_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE
+t_pool_allocator(VALUE klass) {
+  struct LLC_Pool *pool;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_Pool, &pool_type, pool);
+  pool->classes = NULL;
+  pool->class_count = 0;
+  pool->max_per_class = 0;
+  pool->free_lists = 0;
+  pool->hits = 0;
+  pool->misses = 0;
+  pool->releases = 0;
+  pool->discards = 0;
+  return obj;
+}
+
+/*
+ * call-seq:
+ *  initialize(size_classes: [64, 256, 1024, 4096, 16384, 65536], max_per_class: 64)
+ *
+ * Creates a pool that recycles ArrayBuffers by size class.
+ *
+ * A request is served from the smallest class that fits it. Requests larger
+ * than the largest class are always served with a new, unpooled buffer.
+ *
+ * Example:
+ *   pool = ArrayBuffer::Pool.new
+ *   pool.with(100) do |buffer|
+ *     # buffer.size == 100, all bytes are zero
+ *   end
+ *
+ * @param size_classes [Array<Integer>] Optional. Capacities of the recycled
+ *   buffers, in bytes
+ * @param max_per_class [Integer] Optional. How many released buffers are
+ *   kept for each class. Extra ones are left to the GC
+ */
+static VALUE
+t_pool_initialize(int argc, VALUE *argv, VALUE self) {
+  DECLAREPOOL(self);
+  VALUE kwargs;
+  VALUE options[2] = { Qundef, Qundef };
+  static ID keyword_ids[] = { 0, 0 };
+
+  rb_scan_args(argc, argv, ":", &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idSizeClasses;
+    keyword_ids[1] = idMaxPerClass;
+  }
+
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 2, options);
+
+  long max_per_class = options[1] == Qundef ? 64 : NUM2LONG(options[1]);
+  if (max_per_class < 0)
+    rb_raise(rb_eArgError, "max_per_class must not be negative: %ld", max_per_class);
+
+  long count;
+  size_t *classes;
+  if (options[0] == Qundef) {
+    count = (long)(sizeof(default_size_classes) / sizeof(default_size_classes[0]));
+    classes = ALLOC_N(size_t, count);
+    memcpy(classes, default_size_classes, sizeof(default_size_classes));
+  } else {
+    Check_Type(options[0], T_ARRAY);
+    VALUE sorted = rb_ary_sort(options[0]);
+    count = rb_array_len(sorted);
+    if (count <= 0)
+      rb_raise(rb_eArgError, "size_classes must not be empty");
+    for (long i = 0; i < count; i++) {
+      if (NUM2SSIZET(rb_ary_entry(sorted, i)) <= 0)
+        rb_raise(rb_eArgError, "size classes must be positive");
+    }
+    classes = ALLOC_N(size_t, count);
+    for (long i = 0; i < count; i++)
+      classes[i] = NUM2SIZET(rb_ary_entry(sorted, i));
+  }
+
+  xfree(pool->classes);
+  pool->classes = classes;
+  pool->class_count = count;
+  pool->max_per_class = max_per_class;
+  RB_OBJ_WRITE(self, &pool->free_lists, rb_ary_new_capa(count));
+  for (long i = 0; i < count; i++)
+    rb_ary_push(pool->free_lists, rb_ary_new());
+
+  return self;
+}
+
+/*
+ * Acquires a zero-filled buffer of +size+ bytes.
+ *
+ * The buffer is taken from the pool when one of the right class is
+ * available, counting as a hit. Otherwise a new buffer with the capacity of
+ * the class is allocated, counting as a miss.
+ *
+ * @param size [Integer]
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_pool_acquire(VALUE self, VALUE size) {
+  DECLAREPOOL(self);
+  const size_t s = NUM2SIZET(size);
+
+  long idx = 0;
+  while (idx < pool->class_count && pool->classes[idx] < s)
+    idx++;
+
+  if (idx == pool->class_count) {
+    pool->misses++;
+    return llc_bb_new(s, s);
+  }
+
+  VALUE free_list = rb_ary_entry(pool->free_lists, idx);
+  VALUE obj;
+  struct LLC_ArrayBuffer *bb;
+  // A released buffer cannot be resized, but drop any that lost its room
+  do {
+    obj = rb_ary_pop(free_list);
+    if (NIL_P(obj)) {
+      pool->misses++;
+      return llc_bb_new(s, pool->classes[idx]);
+    }
+    bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(obj, &llc_arraybuffer_type);
+    bb->flags &= ~BB_FLAG_POOLED;
+  } while (rb_str_capacity(bb->backing_str) < s);
+
+  llc_bb_reset(bb, s);
+  pool->hits++;
+  return obj;
+}
+
+/*
+ * Gives a buffer back to the pool so a later #acquire can reuse it.
+ *
+ * The buffer is shrunk to size zero and must no longer be used. Buffers
+ * that do not fit any size class, or that find their class full, are left
+ * to the GC.
+ *
+ * @param buffer [ArrayBuffer]
+ */
+static VALUE
+t_pool_release(VALUE self, VALUE buffer) {
+  DECLAREPOOL(self);
+  if (!rb_obj_is_kind_of(buffer, cArrayBuffer))
+    rb_raise(rb_eTypeError, "expected an ArrayBuffer, got %"PRIsVALUE, CLASS_OF(buffer));
+
+  DECLAREBB(buffer);
+  if (bb->flags & BB_FLAG_POOLED)
+    rb_raise(rb_eArgError, "buffer was already released");
+  CHECK_BB_UNPINNED(bb);
+
+  pool->releases++;
+  if ((bb->flags & BB_FLAG_MAPPED) || !bb->backing_str || OBJ_FROZEN(bb->backing_str)) {
+    pool->discards++;
+    return Qnil;
+  }
+
+  const size_t capacity = rb_str_capacity(bb->backing_str);
+  long idx = pool->class_count - 1;
+  while (idx >= 0 && pool->classes[idx] > capacity)
+    idx--;
+
+  VALUE free_list = idx < 0 ? Qnil : rb_ary_entry(pool->free_lists, idx);
+  if (NIL_P(free_list) || rb_array_len(free_list) >= pool->max_per_class) {
+    pool->discards++;
+    return Qnil;
+  }
+
+  llc_bb_reset(bb, 0);
+  bb->flags |= BB_FLAG_POOLED;
+  rb_ary_push(free_list, buffer);
+  return Qnil;
+}
+
+static VALUE
+pool_release_ensure(VALUE args) {
+  return t_pool_release(rb_ary_entry(args, 0), rb_ary_entry(args, 1));
+}
+
+/*
+ * call-seq:
+ *  with(size) { |buffer| ... }
+ *
+ * Acquires a buffer, yields it and releases it when the block exits, even
+ * if it raises.
+ *
+ * @return The value returned by the block
+ */
+static VALUE
+t_pool_with(VALUE self, VALUE size) {
+  VALUE buffer = t_pool_acquire(self, size);
+  return rb_ensure(rb_yield, buffer, pool_release_ensure, rb_ary_new_from_args(2, self, buffer));
+}
+
+/*
+ * Returns counters to help tuning the pool.
+ *
+ * The Hash has the number of +:hits+, +:misses+, +:releases+ and
+ * +:discards+ (releases that did not go back to the pool) so far, and how
+ * many buffers are currently +:pooled+.
+ *
+ * @return [Hash]
+ */
+static VALUE
+t_pool_stats(VALUE self) {
+  DECLAREPOOL(self);
+  long pooled = 0;
+  for (long i = 0; i < pool->class_count; i++)
+    pooled += rb_array_len(rb_ary_entry(pool->free_lists, i));
+
+  VALUE stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("hits")), SIZET2NUM(pool->hits));
+  rb_hash_aset(stats, ID2SYM(rb_intern("misses")), SIZET2NUM(pool->misses));
+  rb_hash_aset(stats, ID2SYM(rb_intern("releases")), SIZET2NUM(pool->releases));
+  rb_hash_aset(stats, ID2SYM(rb_intern("discards")), SIZET2NUM(pool->discards));
+  rb_hash_aset(stats, ID2SYM(rb_intern("pooled")), LONG2NUM(pooled));
+  return stats;
+}
+
+/*
+ * Returns the size classes, from the smallest to the largest.
+ *
+ * @return [Array<Integer>]
+ */
+static VALUE
+t_pool_size_classes(VALUE self) {
+  DECLAREPOOL(self);
+  VALUE result = rb_ary_new_capa(pool->class_count);
+  for (long i = 0; i < pool->class_count; i++)
+    rb_ary_push(result, SIZET2NUM(pool->classes[i]));
+  return result;
+}
+
+void
+Init_pool() {
+  idSizeClasses = rb_intern("size_classes");
+  idMaxPerClass = rb_intern("max_per_class");
+
+  cPool = rb_define_class_under(cArrayBuffer, "Pool", rb_cObject);
+  rb_define_alloc_func(cPool, t_pool_allocator);
+
+  rb_define_method(cPool, "initialize", t_pool_initialize, -1);
+  rb_define_method(cPool, "acquire", t_pool_acquire, 1);
+  rb_define_method(cPool, "release", t_pool_release, 1);
+  rb_define_method(cPool, "with", t_pool_with, 1);
+  rb_define_method(cPool, "stats", t_pool_stats, 0);
+  rb_define_method(cPool, "size_classes", t_pool_size_classes, 0);
+}
@@ -0,0 +1,534 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <math.h>
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+static ID idEndianess = Qundef;
+
+#define SIGN_BIT (UINT64_C(1) << 63)
+
+/* Integer sums are accumulated in 64 bits for at most this many values */
+#define SUM_CHUNK (UINT64_C(1) << 31)
+
+enum reduce_op { REDUCE_SUM, REDUCE_MIN_MAX, REDUCE_COUNT };
+
+struct reduce_args {
+  const unsigned char *ptr;
+  size_t count;
+  int type;
+  int little;
+  enum reduce_op op;
+
+  /* Integer sums as 128 bits two's complement, and float sums */
+  uint64_t sum_low;
+  int64_t sum_high;
+  double sum;
+
+  /* Integers as order-preserving unsigned keys, see reduce_key */
+  uint64_t min_key;
+  uint64_t max_key;
+  double min;
+  double max;
+  int found;
+
+  /* The raw bits, or the value for floats, to count */
+  uint64_t target;
+  double float_target;
+  size_t matches;
+};
+
+static inline int
+type_is_signed(int type) {
+  return type >= LLC_I8 && type <= LLC_I64;
+}
+
+static inline int
+type_is_float(int type) {
+  return type == LLC_F32 || type == LLC_F64;
+}
+
+/*
+ * Loads the integer at +p+ as a key whose unsigned order is the order of
+ * the values, flipping the sign bit of signed ones.
+ */
+static inline uint64_t
+reduce_key(const unsigned char *p, unsigned int width, int little, int is_signed) {
+  const uint64_t val = llc_load_uint(p, width, little);
+  return is_signed ? (uint64_t)llc_sign_extend(val, width) ^ SIGN_BIT : val;
+}
+
+/*
+ * Same as reduce_key, for values narrower than 8 bytes.
+ */
+static inline uint32_t
+reduce_key32(const unsigned char *p, unsigned int width, int little, int is_signed) {
+  const uint64_t val = llc_load_uint(p, width, little);
+  return is_signed ? (uint32_t)llc_sign_extend(val, width) ^ UINT32_C(0x80000000) : (uint32_t)val;
+}
+
+static inline uint64_t
+widen_key32(uint32_t key, int is_signed) {
+  if (!is_signed)
+    return key;
+  return (uint64_t)(int64_t)(int32_t)(key ^ UINT32_C(0x80000000)) ^ SIGN_BIT;
+}
+
+static inline double
+reduce_float(const unsigned char *p, unsigned int width, int little) {
+  const uint64_t bits = llc_load_uint(p, width, little);
+  if (width == 4) {
+    const uint32_t bits32 = (uint32_t)bits;
+    float val;
+    memcpy(&val, &bits32, sizeof(val));
+    return val;
+  }
+  double val;
+  memcpy(&val, &bits, sizeof(val));
+  return val;
+}
+
+/*
+ * Runs +op+ over integers. +width+, +little+ and +is_signed+ are given as
+ * constants by reduce_kernel so the loops can be unrolled and vectorized.
+ */
+static inline void
+reduce_ints(struct reduce_args *args, unsigned int width, int little, int is_signed) {
+  const unsigned char *p = args->ptr;
+  const size_t count = args->count;
+
+  switch (args->op) {
+  case REDUCE_SUM: {
+    uint64_t low = 0;
+    int64_t high = 0;
+    const size_t chunk = width < 8 ? SUM_CHUNK : 1;
+    for (size_t i = 0; i < count;) {
+      const size_t end = count - i < chunk ? count : i + chunk;
+      if (is_signed) {
+        int64_t sum = 0;
+        for (; i < end; i++)
+          sum += llc_sign_extend(llc_load_uint(p + i * width, width, little), width);
+        const uint64_t prev = low;
+        low += (uint64_t)sum;
+        high += (int64_t)(low < prev) - (sum < 0);
+      } else {
+        uint64_t sum = 0;
+        for (; i < end; i++)
+          sum += llc_load_uint(p + i * width, width, little);
+        low += sum;
+        high += low < sum;
+      }
+    }
+    args->sum_low = low;
+    args->sum_high = high;
+    break;
+  }
+  case REDUCE_MIN_MAX: {
+    if (width < 8) {
+      // Keys of narrower values fit 32 bits lanes, twice as many per vector
+      uint32_t min = UINT32_MAX;
+      uint32_t max = 0;
+      for (size_t i = 0; i < count; i++) {
+        const uint32_t key = reduce_key32(p + i * width, width, little, is_signed);
+        min = key < min ? key : min;
+        max = key > max ? key : max;
+      }
+      args->min_key = widen_key32(min, is_signed);
+      args->max_key = widen_key32(max, is_signed);
+    } else {
+      uint64_t min = UINT64_MAX;
+      uint64_t max = 0;
+      for (size_t i = 0; i < count; i++) {
+        const uint64_t key = reduce_key(p + i * width, width, little, is_signed);
+        min = key < min ? key : min;
+        max = key > max ? key : max;
+      }
+      args->min_key = min;
+      args->max_key = max;
+    }
+    args->found = count > 0;
+    break;
+  }
+  case REDUCE_COUNT: {
+    const uint64_t target = args->target;
+    size_t matches = 0;
+    // Counting in lanes as narrow as the values keeps comparisons vectorized
+    if (width == 1) {
+      size_t i = 0;
+      for (; i + 255 <= count; i += 255) {
+        uint8_t chunk = 0;
+        for (size_t j = 0; j < 255; j++)
+          chunk += p[i + j] == (uint8_t)target;
+        matches += chunk;
+      }
+      for (; i < count; i++)
+        matches += p[i] == target;
+      args->matches = matches;
+      break;
+    }
+    for (size_t i = 0; i < count;) {
+      const size_t end = count - i < UINT32_MAX ? count : i + UINT32_MAX;
+      uint32_t chunk = 0;
+      for (; i < end; i++)
+        chunk += llc_load_uint(p + i * width, width, little) == target;
+      matches += chunk;
+    }
+    args->matches = matches;
+    break;
+  }
+  }
+}
+
+static inline void
+reduce_floats(struct reduce_args *args, unsigned int width, int little) {
+  const unsigned char *p = args->ptr;
+  const size_t count = args->count;
+
+  switch (args->op) {
+  case REDUCE_SUM: {
+    // Independent partial sums let the additions overlap
+    double sums[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      for (int j = 0; j < 4; j++)
+        sums[j] += reduce_float(p + (i + j) * width, width, little);
+    }
+    for (; i < count; i++)
+      sums[0] += reduce_float(p + i * width, width, little);
+    args->sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    break;
+  }
+  case REDUCE_MIN_MAX: {
+    double min = INFINITY;
+    double max = -INFINITY;
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+      const double val = reduce_float(p + i * width, width, little);
+      if (isnan(val))
+        continue;
+      min = val < min ? val : min;
+      max = val > max ? val : max;
+      found = 1;
+    }
+    args->min = min;
+    args->max = max;
+    args->found = found;
+    break;
+  }
+  case REDUCE_COUNT: {
+    const double target = args->float_target;
+    size_t matches = 0;
+    for (size_t i = 0; i < count; i++)
+      matches += reduce_float(p + i * width, width, little) == target;
+    args->matches = matches;
+    break;
+  }
+  }
+}
+
+#define REDUCE_INTS(width, is_signed) \
+  if (args->little) reduce_ints(args, (width), 1, (is_signed)); else reduce_ints(args, (width), 0, (is_signed)); \
+  break
+
+#define REDUCE_FLOATS(width) \
+  if (args->little) reduce_floats(args, (width), 1); else reduce_floats(args, (width), 0); \
+  break
+
+static void *
+reduce_kernel(void *ptr) {
+  struct reduce_args *args = (struct reduce_args*)ptr;
+  switch (args->type) {
+  case LLC_U8: REDUCE_INTS(1, 0);
+  case LLC_U16: REDUCE_INTS(2, 0);
+  case LLC_U24: REDUCE_INTS(3, 0);
+  case LLC_U32: REDUCE_INTS(4, 0);
+  case LLC_U64: REDUCE_INTS(8, 0);
+  case LLC_I8: REDUCE_INTS(1, 1);
+  case LLC_I16: REDUCE_INTS(2, 1);
+  case LLC_I24: REDUCE_INTS(3, 1);
+  case LLC_I32: REDUCE_INTS(4, 1);
+  case LLC_I64: REDUCE_INTS(8, 1);
+  case LLC_F32: REDUCE_FLOATS(4);
+  case LLC_F64: REDUCE_FLOATS(8);
+  }
+  return NULL;
+}
+
+/*
+ * Resolves the element type and endianess of a reduction, with -1 standing
+ * for the endianess of the view. The bytes are only taken by reduce_run,
+ * once any argument that may run Ruby code has been converted.
+ */
+static void
+reduce_prepare(VALUE self, VALUE type, VALUE kwargs, enum reduce_op op, struct reduce_args *args) {
+  VALUE endianess = Qundef;
+  static ID keyword_ids[] = { 0 };
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idEndianess;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+
+  memset(args, 0, sizeof(*args));
+  args->op = op;
+  args->type = NIL_P(type) ? LLC_U8 : llc_parse_type(type);
+  args->little = endianess == Qundef ? -1 : llc_parse_endianess(endianess);
+}
+
+/*
+ * Runs the reduction over the bytes of +self+. Trailing bytes that do not
+ * make a whole element are left out.
+ */
+static void
+reduce_run(VALUE self, struct reduce_args *args) {
+  size_t len;
+  int little;
+  args->ptr = llc_view_bytes(self, &len, &little, 0);
+  if (args->little < 0)
+    args->little = little;
+  args->count = len / llc_type_widths[args->type];
+  llc_run_kernel(args->count * llc_type_widths[args->type], reduce_kernel, args, self, Qnil);
+}
+
+static VALUE
+reduce_key_value(uint64_t key, int type) {
+  return type_is_signed(type) ? LL2NUM((int64_t)(key ^ SIGN_BIT)) : ULL2NUM(key);
+}
+
+/*
+ * Whether a call given +argc+ arguments, the first of which may be an
+ * element type, is left to Enumerable.
+ */
+static int
+reduce_enumerable_p(int argc, VALUE *argv) {
+  return rb_block_given_p() || (argc > 0 && !SYMBOL_P(argv[0]) && !RB_TYPE_P(argv[0], T_HASH));
+}
+
+/*
+ * call-seq:
+ *  sum(type = :u8, endianess: nil)
+ *
+ * Sums the values of the given type natively. Integers are summed exactly
+ * and floats in double precision.
+ *
+ * With a block or an initial value instead of a type, it behaves like
+ * Enumerable#sum over the bytes.
+ *
+ * Example:
+ *   view.sum(:u32) # => 1234567890123
+ *
+ * @param type [Symbol] Optional. One of +:u8+, +:i16+, +:f64+...
+ * @param endianess [:big, :little] Optional. Defaults to the endianess of
+ *   the DataView, or big endian for an ArrayBuffer
+ * @return [Integer, Float]
+ */
+static VALUE
+t_sum(int argc, VALUE *argv, VALUE self) {
+  if (reduce_enumerable_p(argc, argv))
+    return rb_call_super(argc, argv);
+
+  VALUE type;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "01:", &type, &kwargs);
+
+  struct reduce_args args;
+  reduce_prepare(self, type, kwargs, REDUCE_SUM, &args);
+  reduce_run(self, &args);
+
+  if (type_is_float(args.type))
+    return DBL2NUM(args.sum);
+  if (args.sum_high == 0)
+    return ULL2NUM(args.sum_low);
+  if (args.sum_high == -1 && (args.sum_low & SIGN_BIT))
+    return LL2NUM((int64_t)args.sum_low);
+  VALUE high = rb_funcall(LL2NUM(args.sum_high), rb_intern("<<"), 1, INT2FIX(64));
+  return rb_funcall(high, '+', 1, ULL2NUM(args.sum_low));
+}
+
+static VALUE
+reduce_min_max(int argc, VALUE *argv, VALUE self, int max) {
+  if (reduce_enumerable_p(argc, argv))
+    return rb_call_super(argc, argv);
+
+  VALUE type;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "01:", &type, &kwargs);
+
+  struct reduce_args args;
+  reduce_prepare(self, type, kwargs, REDUCE_MIN_MAX, &args);
+  reduce_run(self, &args);
+
+  if (!args.found)
+    return Qnil;
+  if (type_is_float(args.type))
+    return DBL2NUM(max ? args.max : args.min);
+  return reduce_key_value(max ? args.max_key : args.min_key, args.type);
+}
+
+/*
+ * call-seq:
+ *  min(type = :u8, endianess: nil)
+ *
+ * Returns the smallest value of the given type, or nil if there are none.
+ * NaN floats are left out.
+ *
+ * With a block or a count instead of a type, it behaves like
+ * Enumerable#min over the bytes.
+ *
+ * @return [Integer, Float, nil]
+ */
+static VALUE
+t_min(int argc, VALUE *argv, VALUE self) {
+  return reduce_min_max(argc, argv, self, 0);
+}
+
+/*
+ * call-seq:
+ *  max(type = :u8, endianess: nil)
+ *
+ * Returns the largest value of the given type, like #min does.
+ *
+ * @return [Integer, Float, nil]
+ */
+static VALUE
+t_max(int argc, VALUE *argv, VALUE self) {
+  return reduce_min_max(argc, argv, self, 1);
+}
+
+/*
+ * Stores in +args+ what #count looks for. Returns zero when +value+ can not
+ * be stored in the type, so nothing can match it.
+ */
+static int
+reduce_count_target(VALUE value, struct reduce_args *args) {
+  const int type = args->type;
+  if (type_is_float(type)) {
+    args->float_target = NUM2DBL(value);
+    return 1;
+  }
+  // Other numbers match the integers they are equal to, as 1.0 == 1
+  if (!RB_INTEGER_TYPE_P(value)) {
+    if (RB_FLOAT_TYPE_P(value) && !isfinite(RFLOAT_VALUE(value)))
+      return 0;
+    VALUE integer = rb_check_to_integer(value, "to_int");
+    if (NIL_P(integer) || !rb_equal(integer, value))
+      return 0;
+    value = integer;
+  }
+
+  const unsigned int width = llc_type_widths[type];
+  uint64_t bits;
+  if (type_is_signed(type)) {
+    const int64_t max = (int64_t)(UINT64_MAX >> (65 - width * 8));
+    const int64_t val = llc_capped_int(value, -max - 1, max);
+    if (!rb_equal(LL2NUM(val), value))
+      return 0;
+    bits = (uint64_t)val;
+  } else {
+    bits = llc_capped_uint64(value);
+    if (!rb_equal(ULL2NUM(bits), value) || (width < 8 && bits >> (width * 8)))
+      return 0;
+  }
+  args->target = width == 8 ? bits : bits & ((UINT64_C(1) << (width * 8)) - 1);
+  return 1;
+}
+
+/*
+ * call-seq:
+ *  count(value, type = :u8, endianess: nil)
+ *
+ * Counts the values of the given type equal to +value+.
+ *
+ * Without a value, with a block or with an object other than a number, it
+ * behaves like Enumerable#count over the bytes.
+ *
+ * Example:
+ *   view.count(0, :u16) # => 12
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_count(int argc, VALUE *argv, VALUE self) {
+  if (rb_block_given_p() || argc == 0 || !rb_obj_is_kind_of(argv[0], rb_cNumeric) ||
+      (argc > 1 && !SYMBOL_P(argv[1]) && !RB_TYPE_P(argv[1], T_HASH)))
+    return rb_call_super(argc, argv);
+
+  VALUE value;
+  VALUE type;
+  VALUE kwargs;
+  rb_scan_args(argc, argv, "11:", &value, &type, &kwargs);
+
+  struct reduce_args args;
+  reduce_prepare(self, type, kwargs, REDUCE_COUNT, &args);
+  if (!reduce_count_target(value, &args))
+    return INT2FIX(0);
+  reduce_run(self, &args);
+  return SIZET2NUM(args.matches);
+}
+
+struct histogram_args {
+  const unsigned char *ptr;
+  size_t len;
+  size_t counts[4][256];
+};
+
+static void *
+histogram_kernel(void *ptr) {
+  struct histogram_args *args = (struct histogram_args*)ptr;
+  const unsigned char *p = args->ptr;
+  size_t i = 0;
+  // Runs of equal bytes would serialize on a single table
+  for (; i + 4 <= args->len; i += 4) {
+    args->counts[0][p[i]]++;
+    args->counts[1][p[i + 1]]++;
+    args->counts[2][p[i + 2]]++;
+    args->counts[3][p[i + 3]]++;
+  }
+  for (; i < args->len; i++)
+    args->counts[0][p[i]]++;
+  return NULL;
+}
+
+/*
+ * Counts how many times each byte value occurs.
+ *
+ * Example:
+ *   view.histogram[0x0A] # => how many newlines
+ *
+ * @return [Array<Integer>] 256 counts, indexed by byte value
+ */
+static VALUE
+t_histogram(VALUE self) {
+  struct histogram_args args;
+  memset(&args, 0, sizeof(args));
+  args.ptr = llc_view_bytes(self, &args.len, NULL, 0);
+  llc_run_kernel(args.len, histogram_kernel, &args, self, Qnil);
+
+  VALUE histogram = rb_ary_new_capa(256);
+  for (int i = 0; i < 256; i++) {
+    const size_t count = args.counts[0][i] + args.counts[1][i] + args.counts[2][i] + args.counts[3][i];
+    rb_ary_push(histogram, SIZET2NUM(count));
+  }
+  return histogram;
+}
+
+static void
+define_reduce_methods(VALUE klass) {
+  rb_define_method(klass, "sum", t_sum, -1);
+  rb_define_method(klass, "min", t_min, -1);
+  rb_define_method(klass, "max", t_max, -1);
+  rb_define_method(klass, "count", t_count, -1);
+  rb_define_method(klass, "histogram", t_histogram, 0);
+}
+
+void
+Init_reduce() {
+  idEndianess = rb_intern("endianess");
+
+  define_reduce_methods(cArrayBuffer);
+  define_reduce_methods(cDataView);
+}
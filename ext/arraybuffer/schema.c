@@ -0,0 +1,376 @@
+#include "dataview.h"
+#include "arraybuffer.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cDataView;
+extern VALUE cSchema;
+
+static ID idAs = Qundef;
+static ID idArray = Qundef;
+static ID idHash = Qundef;
+
+enum llc_schema_output {
+  SCHEMA_OUTPUT_HASH,
+  SCHEMA_OUTPUT_ARRAY,
+  SCHEMA_OUTPUT_STRUCT
+};
+
+struct LLC_SchemaField {
+  VALUE name;
+  size_t offset;
+  unsigned char type;
+  unsigned char width;
+};
+
+struct LLC_Schema {
+  struct LLC_SchemaField *fields;
+  long count;
+  size_t size;
+  unsigned char output;
+  VALUE struct_class;
+};
+
+#define DECLARESCHEMA(o) \
+  struct LLC_Schema *schema = (struct LLC_Schema*)rb_check_typeddata((o), &schema_type)
+
+static void
+t_schema_gc_mark(void *ptr) {
+  struct LLC_Schema *schema = (struct LLC_Schema*)ptr;
+  for (long i = 0; i < schema->count; i++)
+    rb_gc_mark_movable(schema->fields[i].name);
+  if (schema->struct_class)
+    rb_gc_mark_movable(schema->struct_class);
+}
+
+static void
+t_schema_free(void *ptr) {
+  struct LLC_Schema *schema = (struct LLC_Schema*)ptr;
+  xfree(schema->fields);
+  xfree(schema);
+}
+
+static size_t
+t_schema_memsize(const void *ptr) {
+  const struct LLC_Schema *schema = (const struct LLC_Schema*)ptr;
+  return sizeof(struct LLC_Schema) + (size_t)schema->count * sizeof(struct LLC_SchemaField);
+}
+
+static void
+t_schema_compact(void *ptr) {
+  struct LLC_Schema *schema = (struct LLC_Schema*)ptr;
+  for (long i = 0; i < schema->count; i++)
+    schema->fields[i].name = rb_gc_location(schema->fields[i].name);
+  if (schema->struct_class)
+    schema->struct_class = rb_gc_location(schema->struct_class);
+}
+
+static const rb_data_type_t schema_type = {
+  "DataView::Schema",
+  { t_schema_gc_mark, t_schema_free, t_schema_memsize, t_schema_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE
+t_schema_allocator(VALUE klass) {
+  struct LLC_Schema *schema;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_Schema, &schema_type, schema);
+  schema->fields = NULL;
+  schema->count = 0;
+  schema->size = 0;
+  schema->output = SCHEMA_OUTPUT_HASH;
+  schema->struct_class = 0;
+  return obj;
+}
+
+static unsigned char
+schema_parse_type(VALUE type) {
+  const int found = llc_find_type(type);
+  if (found < 0)
+    rb_raise(rb_eArgError, "unknown field type: %"PRIsVALUE, type);
+  return (unsigned char)found;
+}
+
+/*
+ * Returns a pointer to +count+ records starting at +offset+ of +view+,
+ * raising if they do not fit in the bytes the view can see.
+ */
+static unsigned char *
+schema_records_ptr(struct LLC_Schema *schema, VALUE view, VALUE offset, long count, int *little, int writable) {
+  size_t len;
+  unsigned char *ptr = llc_view_bytes(view, &len, little, writable);
+  ssize_t off = NIL_P(offset) ? 0 : NUM2SSIZET(offset);
+  if (off < 0)
+    off += (ssize_t)len;
+  if (off < 0 || (size_t)off > len)
+    rb_raise(rb_eArgError, "offset out of bounds: %"PRIdSIZE, off);
+  if (count < 0)
+    rb_raise(rb_eArgError, "count must not be negative: %ld", count);
+  if (schema->size && (size_t)count > (len - (size_t)off) / schema->size)
+    rb_raise(rb_eArgError, "%ld records of %"PRIuSIZE" bytes do not fit at offset %"PRIdSIZE,
+      count, schema->size, off);
+  return ptr + off;
+}
+
+static VALUE
+schema_decode_record(struct LLC_Schema *schema, const unsigned char *p, int little) {
+  VALUE record;
+  switch (schema->output) {
+  case SCHEMA_OUTPUT_HASH:
+    record = rb_hash_new();
+    for (long i = 0; i < schema->count; i++) {
+      const struct LLC_SchemaField *field = &schema->fields[i];
+      rb_hash_aset(record, field->name, llc_decode_value(p + field->offset, field->type, little));
+    }
+    return record;
+  case SCHEMA_OUTPUT_ARRAY:
+    record = rb_ary_new_capa(schema->count);
+    for (long i = 0; i < schema->count; i++) {
+      const struct LLC_SchemaField *field = &schema->fields[i];
+      rb_ary_push(record, llc_decode_value(p + field->offset, field->type, little));
+    }
+    return record;
+  default: {
+    VALUE values = rb_ary_new_capa(schema->count);
+    for (long i = 0; i < schema->count; i++) {
+      const struct LLC_SchemaField *field = &schema->fields[i];
+      rb_ary_push(values, llc_decode_value(p + field->offset, field->type, little));
+    }
+    return rb_class_new_instance((int)schema->count, RARRAY_CONST_PTR(values), schema->struct_class);
+  }
+  }
+}
+
+/*
+ * call-seq:
+ *  initialize(fields, as: :hash)
+ *
+ * Compiles a fixed record layout into a native field table.
+ *
+ * Fields are laid out back to back, in the given order, with no padding.
+ * Each field is a pair of name and type, where type is one of +:u8+,
+ * +:u16+, +:u24+, +:u32+, +:u64+, +:i8+, +:i16+, +:i24+, +:i32+, +:i64+,
+ * +:f32+ or +:f64+. Multi-byte fields use the endianess of the DataView
+ * they are read from.
+ *
+ * Example:
+ *   schema = DataView::Schema.new([[:id, :u32], [:kind, :u16], [:flags, :u8], [:ts, :f64]])
+ *   schema.size # 15
+ *   schema.read(view, 0) # { id: 1, kind: 2, flags: 0, ts: 1700000000.0 }
+ *
+ * @param fields [Array<Array(Symbol, Symbol)>] The record layout
+ * @param as [:hash, :array, Class] Optional. How records are returned by
+ *   #read: as a Hash keyed by field name, as an Array of values in field
+ *   order, or as an instance of the given Struct class
+ */
+static VALUE
+t_schema_initialize(int argc, VALUE *argv, VALUE self) {
+  DECLARESCHEMA(self);
+  VALUE fields;
+  VALUE kwargs;
+  static ID keyword_ids[] = { 0 };
+
+  rb_scan_args(argc, argv, "1:", &fields, &kwargs);
+  Check_Type(fields, T_ARRAY);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idAs;
+  }
+
+  if (!NIL_P(kwargs)) {
+    VALUE as;
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &as);
+    if (as != Qundef) {
+      if (RB_TYPE_P(as, T_CLASS)) {
+        if (as == rb_cStruct || !RTEST(rb_class_inherited_p(as, rb_cStruct)))
+          rb_raise(rb_eArgError, "as must be :hash, :array or a Struct class, got %"PRIsVALUE, as);
+        schema->output = SCHEMA_OUTPUT_STRUCT;
+        RB_OBJ_WRITE(self, &schema->struct_class, as);
+      } else {
+        Check_Type(as, T_SYMBOL);
+        ID id = SYM2ID(as);
+        if (id == idArray)
+          schema->output = SCHEMA_OUTPUT_ARRAY;
+        else if (id == idHash)
+          schema->output = SCHEMA_OUTPUT_HASH;
+        else
+          rb_raise(rb_eArgError, "as must be :hash, :array or a Struct class");
+      }
+    }
+  }
+
+  const long count = rb_array_len(fields);
+  for (long i = 0; i < count; i++) {
+    VALUE field = rb_ary_entry(fields, i);
+    if (!RB_TYPE_P(field, T_ARRAY) || rb_array_len(field) != 2)
+      rb_raise(rb_eArgError, "field at index %ld must be a [name, type] pair", i);
+    schema_parse_type(rb_ary_entry(field, 1));
+  }
+
+  struct LLC_SchemaField *table = ALLOC_N(struct LLC_SchemaField, count > 0 ? count : 1);
+  size_t offset = 0;
+  for (long i = 0; i < count; i++) {
+    VALUE field = rb_ary_entry(fields, i);
+    RB_OBJ_WRITE(self, &table[i].name, rb_ary_entry(field, 0));
+    table[i].type = schema_parse_type(rb_ary_entry(field, 1));
+    table[i].width = llc_type_widths[table[i].type];
+    table[i].offset = offset;
+    offset += table[i].width;
+  }
+
+  xfree(schema->fields);
+  schema->fields = table;
+  schema->count = count;
+  schema->size = offset;
+  return self;
+}
+
+/*
+ * Returns the size in bytes of one record.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_schema_size(VALUE self) {
+  DECLARESCHEMA(self);
+  return SIZET2NUM(schema->size);
+}
+
+/*
+ * Returns the compiled layout as an Array of [name, type, offset] triples.
+ *
+ * @return [Array]
+ */
+static VALUE
+t_schema_fields(VALUE self) {
+  DECLARESCHEMA(self);
+  VALUE result = rb_ary_new_capa(schema->count);
+  for (long i = 0; i < schema->count; i++) {
+    const struct LLC_SchemaField *field = &schema->fields[i];
+    rb_ary_push(result, rb_ary_new_from_args(3, field->name,
+      llc_type_symbol(field->type), SIZET2NUM(field->offset)));
+  }
+  return result;
+}
+
+/*
+ * call-seq:
+ *  read(view, offset = 0)
+ *
+ * Decodes one record starting at +offset+ of +view+.
+ *
+ * The whole record is bounds-checked once.
+ *
+ * @param view [DataView, ArrayBuffer]
+ * @return [Hash, Array, Struct] Depending on the +as+ option
+ */
+static VALUE
+t_schema_read(int argc, VALUE *argv, VALUE self) {
+  DECLARESCHEMA(self);
+  VALUE view;
+  VALUE offset;
+  rb_scan_args(argc, argv, "11", &view, &offset);
+
+  int little;
+  const unsigned char *p = schema_records_ptr(schema, view, offset, 1, &little, 0);
+  return schema_decode_record(schema, p, little);
+}
+
+/*
+ * call-seq:
+ *  read_many(view, offset, count)
+ *
+ * Decodes +count+ consecutive records starting at +offset+ of +view+.
+ *
+ * @param view [DataView, ArrayBuffer]
+ * @return [Array]
+ */
+static VALUE
+t_schema_read_many(VALUE self, VALUE view, VALUE offset, VALUE count) {
+  DECLARESCHEMA(self);
+  const long n = NUM2LONG(count);
+  int little;
+  schema_records_ptr(schema, view, offset, n, &little, 0);
+
+  VALUE result = rb_ary_new_capa(n);
+  for (long i = 0; i < n; i++) {
+    // Struct constructors may run Ruby code, so the records are looked up
+    // again for every one of them
+    const unsigned char *p = schema_records_ptr(schema, view, offset, n, &little, 0);
+    rb_ary_push(result, schema_decode_record(schema, p + (size_t)i * schema->size, little));
+  }
+  return result;
+}
+
+static VALUE
+schema_record_value(struct LLC_Schema *schema, VALUE record, long i) {
+  if (RB_TYPE_P(record, T_ARRAY)) {
+    if (i >= rb_array_len(record))
+      rb_raise(rb_eArgError, "record has no value for field %"PRIsVALUE, schema->fields[i].name);
+    return rb_ary_entry(record, i);
+  }
+  if (RB_TYPE_P(record, T_HASH)) {
+    VALUE value = rb_hash_lookup2(record, schema->fields[i].name, Qundef);
+    if (value == Qundef)
+      rb_raise(rb_eKeyError, "record has no value for field %"PRIsVALUE, schema->fields[i].name);
+    return value;
+  }
+  if (RB_TYPE_P(record, T_STRUCT))
+    return rb_struct_aref(record, schema->fields[i].name);
+
+  rb_raise(rb_eTypeError, "record must be a Hash, an Array or a Struct");
+  return Qnil;
+}
+
+/*
+ * call-seq:
+ *  write(view, offset, record)
+ *
+ * Encodes +record+ starting at +offset+ of +view+.
+ *
+ * The record may be a Hash keyed by field name, an Array of values in field
+ * order, or a Struct. Integer values are capped to the range of their field
+ * type, like the DataView setters do.
+ *
+ * @param view [DataView, ArrayBuffer]
+ */
+static VALUE
+t_schema_write(VALUE self, VALUE view, VALUE offset, VALUE record) {
+  DECLARESCHEMA(self);
+  VALUE tmp;
+  uint64_t *bits = ALLOCV_N(uint64_t, tmp, schema->count);
+
+  // Converting values may run Ruby code, so it is done before the buffer
+  // is looked up
+  for (long i = 0; i < schema->count; i++)
+    bits[i] = llc_encode_value(schema_record_value(schema, record, i), schema->fields[i].type);
+
+  int little;
+  unsigned char *p = schema_records_ptr(schema, view, offset, 1, &little, 1);
+  for (long i = 0; i < schema->count; i++) {
+    const struct LLC_SchemaField *field = &schema->fields[i];
+    llc_store_uint(p + field->offset, field->width, little, bits[i]);
+  }
+
+  ALLOCV_END(tmp);
+  return self;
+}
+
+void
+Init_schema() {
+  idAs = rb_intern("as");
+  idArray = rb_intern("array");
+  idHash = rb_intern("hash");
+
+  cSchema = rb_define_class_under(cDataView, "Schema", rb_cObject);
+  rb_define_alloc_func(cSchema, t_schema_allocator);
+
+  rb_define_method(cSchema, "initialize", t_schema_initialize, -1);
+  rb_define_method(cSchema, "size", t_schema_size, 0);
+  rb_define_method(cSchema, "fields", t_schema_fields, 0);
+  rb_define_method(cSchema, "read", t_schema_read, -1);
+  rb_define_method(cSchema, "read_many", t_schema_read_many, 3);
+  rb_define_method(cSchema, "write", t_schema_write, 3);
+}
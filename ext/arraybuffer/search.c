@@ -0,0 +1,399 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cArrayBuffer;
+extern VALUE cDataView;
+
+#ifndef HAVE_MEMRCHR
+static void *
+memrchr(const void *s, int c, size_t n) {
+  const unsigned char *p = (const unsigned char*)s + n;
+  while (p > (const unsigned char*)s) {
+    if (*--p == (unsigned char)c)
+      return (void*)p;
+  }
+  return NULL;
+}
+#endif
+
+#ifndef HAVE_MEMMEM
+static void *
+memmem(const void *haystack, size_t haystack_len, const void *needle, size_t needle_len) {
+  const unsigned char *h = (const unsigned char*)haystack;
+  const unsigned char *n = (const unsigned char*)needle;
+  if (!needle_len)
+    return (void*)h;
+  if (needle_len > haystack_len)
+    return NULL;
+
+  const unsigned char *last = h + (haystack_len - needle_len);
+  while (h <= last) {
+    h = (const unsigned char*)memchr(h, n[0], (size_t)(last - h) + 1);
+    if (!h)
+      return NULL;
+    if (!memcmp(h + 1, n + 1, needle_len - 1))
+      return (void*)h;
+    h++;
+  }
+  return NULL;
+}
+#endif
+
+struct search_args {
+  const unsigned char *haystack;
+  size_t haystack_len;
+  const unsigned char *needle;
+  size_t needle_len;
+  int byte;
+  const unsigned char *found;
+};
+
+static void *
+index_kernel(void *ptr) {
+  struct search_args *args = (struct search_args*)ptr;
+  args->found = (const unsigned char*)memchr(args->haystack, args->byte, args->haystack_len);
+  return NULL;
+}
+
+static void *
+last_index_kernel(void *ptr) {
+  struct search_args *args = (struct search_args*)ptr;
+  args->found = (const unsigned char*)memrchr(args->haystack, args->byte, args->haystack_len);
+  return NULL;
+}
+
+static void *
+index_sequence_kernel(void *ptr) {
+  struct search_args *args = (struct search_args*)ptr;
+  args->found = (const unsigned char*)memmem(args->haystack, args->haystack_len, args->needle, args->needle_len);
+  return NULL;
+}
+
+/*
+ * Converts the optional position of a search, giving +fallback+ for nil.
+ * Converting may run Ruby code that resizes the buffer, so it must happen
+ * before its bytes are taken.
+ */
+static ssize_t
+search_from(VALUE from, ssize_t fallback) {
+  return NIL_P(from) ? fallback : NUM2SSIZET(from);
+}
+
+/*
+ * Resolves the start position of a search over +len+ bytes, converted by
+ * search_from.
+ *
+ * Negative values are summed with +len+, and still negative ones start the
+ * search at zero. Returns -1 when the position is past the end.
+ */
+static ssize_t
+search_start(ssize_t val, size_t len) {
+  if (val < 0)
+    val += (ssize_t)len;
+  if (val < 0)
+    val = 0;
+  return (size_t)val > len ? -1 : val;
+}
+
+/*
+ * Returns the byte searched for, or -1 if +byte+ is not in 0..255 and so
+ * can't be found.
+ */
+static int
+search_byte(VALUE byte) {
+  const long val = NUM2LONG(byte);
+  return val < 0 || val > 0xFF ? -1 : (int)val;
+}
+
+/*
+ * call-seq:
+ *  indexOf(byte, from = 0)
+ *
+ * Returns the index of the first occurrence of +byte+, searching from
+ * +from+ onwards, or nil if not found.
+ *
+ * On a DataView, the search covers the bytes the view can see and indices
+ * are relative to the view. The scan runs at memory speed, releasing the
+ * GVL over large ranges.
+ *
+ * Example:
+ *   view.indexOf(0)          # position of the first null byte
+ *   view.indexOf(10, pos + 1) # next newline after pos
+ *
+ * @param byte [Integer] Between 0 and 255
+ * @param from [Integer] Optional. If negative, it will be summed with the
+ *   size
+ * @return [Integer, nil]
+ */
+static VALUE
+t_index_of(int argc, VALUE *argv, VALUE self) {
+  VALUE byte;
+  VALUE from;
+  rb_scan_args(argc, argv, "11", &byte, &from);
+
+  const int b = search_byte(byte);
+  const ssize_t from_arg = search_from(from, 0);
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+  const ssize_t start = search_start(from_arg, len);
+  if (b < 0 || start < 0)
+    return Qnil;
+
+  struct search_args args = { ptr + start, len - (size_t)start, NULL, 0, b, NULL };
+  llc_run_kernel(args.haystack_len, index_kernel, &args, self, Qnil);
+  return args.found ? SIZET2NUM((size_t)(args.found - ptr)) : Qnil;
+}
+
+/*
+ * call-seq:
+ *  lastIndexOf(byte, from = size - 1)
+ *
+ * Returns the index of the last occurrence of +byte+ at or before +from+,
+ * or nil if not found.
+ *
+ * @param byte [Integer] Between 0 and 255
+ * @param from [Integer] Optional. If negative, it will be summed with the
+ *   size
+ * @return [Integer, nil]
+ */
+static VALUE
+t_last_index_of(int argc, VALUE *argv, VALUE self) {
+  VALUE byte;
+  VALUE from;
+  rb_scan_args(argc, argv, "11", &byte, &from);
+
+  const int b = search_byte(byte);
+  ssize_t val = search_from(from, SSIZE_MAX);
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+  if (b < 0 || !len)
+    return Qnil;
+
+  size_t end = len;
+  if (val < 0)
+    val += (ssize_t)len;
+  if (val < 0)
+    return Qnil;
+  if ((size_t)val < len)
+    end = (size_t)val + 1;
+
+  struct search_args args = { ptr, end, NULL, 0, b, NULL };
+  llc_run_kernel(end, last_index_kernel, &args, self, Qnil);
+  return args.found ? SIZET2NUM((size_t)(args.found - ptr)) : Qnil;
+}
+
+/*
+ * call-seq:
+ *  indexOfSequence(sequence, from = 0)
+ *
+ * Returns the index of the first occurrence of the bytes of +sequence+,
+ * searching from +from+ onwards, or nil if not found.
+ *
+ * Example:
+ *   view.indexOfSequence("\r\n")
+ *
+ * @param sequence [String, ArrayBuffer, DataView]
+ * @param from [Integer] Optional. If negative, it will be summed with the
+ *   size
+ * @return [Integer, nil]
+ */
+static VALUE
+t_index_of_sequence(int argc, VALUE *argv, VALUE self) {
+  VALUE sequence;
+  VALUE from;
+  rb_scan_args(argc, argv, "11", &sequence, &from);
+  const ssize_t from_arg = search_from(from, 0);
+
+  const unsigned char *needle;
+  size_t needle_len;
+  if (RB_TYPE_P(sequence, T_STRING)) {
+    // Frozen, so the bytes can't change while the GVL is released
+    sequence = rb_str_new_frozen(sequence);
+    needle = (const unsigned char*)RSTRING_PTR(sequence);
+    needle_len = (size_t)RSTRING_LEN(sequence);
+  } else {
+    needle = llc_view_bytes(sequence, &needle_len, NULL, 0);
+  }
+
+  size_t len;
+  const unsigned char *ptr = llc_view_bytes(self, &len, NULL, 0);
+  const ssize_t start = search_start(from_arg, len);
+  if (start < 0)
+    return Qnil;
+
+  struct search_args args = { ptr + start, len - (size_t)start, needle, needle_len, 0, NULL };
+  llc_run_kernel(args.haystack_len, index_sequence_kernel, &args, self, sequence);
+  RB_GC_GUARD(sequence);
+  return args.found ? SIZET2NUM((size_t)(args.found - ptr)) : Qnil;
+}
+
+/*
+ * Resolves the delimiter of #split into +bytes+ and +len+, returning the
+ * object that owns them.
+ */
+static VALUE
+split_delimiter(VALUE delim, unsigned char *byte, const unsigned char **bytes, size_t *len) {
+  if (RB_INTEGER_TYPE_P(delim)) {
+    const int b = search_byte(delim);
+    if (b < 0)
+      rb_raise(rb_eArgError, "delimiter byte must be between 0 and 255");
+    *byte = (unsigned char)b;
+    *bytes = byte;
+    *len = 1;
+    return Qnil;
+  }
+
+  if (RB_TYPE_P(delim, T_STRING)) {
+    // A private copy, so the block can't change it between records
+    delim = rb_str_new_frozen(delim);
+    *bytes = (const unsigned char*)RSTRING_PTR(delim);
+    *len = (size_t)RSTRING_LEN(delim);
+  } else {
+    *bytes = llc_view_bytes(delim, len, NULL, 0);
+    delim = rb_str_new((const char*)*bytes, (long)*len);
+    *bytes = (const unsigned char*)RSTRING_PTR(delim);
+  }
+  if (!*len)
+    rb_raise(rb_eArgError, "delimiter must not be empty");
+  return delim;
+}
+
+/*
+ * call-seq:
+ *  split(delimiter) -> Array<DataView>
+ *  split(delimiter) { |view| ... } -> self
+ *
+ * Splits the view into sub-views separated by +delimiter+, which is not
+ * part of any of them. No bytes are copied: the sub-views share the
+ * buffer, and have the endianess of this view.
+ *
+ * Consecutive delimiters produce empty sub-views, and so does a delimiter
+ * at the end of the view.
+ *
+ * When a block is given, a single DataView is moved over each piece in
+ * turn and yielded, so splitting allocates no objects per piece. Use
+ * #dup to keep a piece after the block returns.
+ *
+ * Example:
+ *   view.split("\r\n") { |line| handle(line.to_s) }
+ *
+ * @param delimiter [Integer, String, ArrayBuffer, DataView] A single byte
+ *   or a byte sequence
+ * @return [Array<DataView>, DataView]
+ */
+static VALUE
+t_dv_split(VALUE self, VALUE delimiter) {
+  DECLAREDV(self);
+  unsigned char byte;
+  const unsigned char *delim;
+  size_t delim_len;
+  VALUE delim_owner = split_delimiter(delimiter, &byte, &delim, &delim_len);
+
+  const int block = rb_block_given_p();
+  VALUE result = block ? Qnil : rb_ary_new();
+  VALUE piece = Qnil;
+  int little;
+  size_t pos = 0;
+
+  for (;;) {
+    // The block may resize the buffer, so it is looked up on every step
+    size_t len;
+    const unsigned char *ptr = llc_view_bytes(self, &len, &little, 0);
+    if (pos > len)
+      break;
+
+    const unsigned char *found = pos == len ? NULL : delim_len == 1 ?
+      (const unsigned char*)memchr(ptr + pos, delim[0], len - pos) :
+      (const unsigned char*)memmem(ptr + pos, len - pos, delim, delim_len);
+    const size_t end = found ? (size_t)(found - ptr) : len;
+
+    if (!block) {
+      rb_ary_push(result, llc_dv_new(dv->bb_obj, dv->offset + pos, end - pos, little));
+    } else {
+      if (NIL_P(piece))
+        piece = llc_dv_new(dv->bb_obj, dv->offset + pos, end - pos, little);
+      struct LLC_DataView *piece_dv = (struct LLC_DataView*)rb_check_typeddata(piece, &llc_dataview_type);
+      piece_dv->offset = dv->offset + pos;
+      piece_dv->size = end - pos;
+      rb_yield(piece);
+    }
+
+    if (!found)
+      break;
+    pos = end + delim_len;
+  }
+
+  RB_GC_GUARD(delim_owner);
+  return block ? self : result;
+}
+
+static VALUE
+dv_slice_view_count(VALUE self, VALUE args, VALUE eobj) {
+  size_t len;
+  llc_view_bytes(self, &len, NULL, 0);
+  const ssize_t n = NUM2SSIZET(RARRAY_AREF(args, 0));
+  return n > 0 ? SIZET2NUM((len + (size_t)n - 1) / (size_t)n) : Qnil;
+}
+
+/*
+ * call-seq:
+ *  each_slice_view(length) { |view| ... } -> self
+ *
+ * Yields consecutive sub-views of +length+ bytes, the last one possibly
+ * shorter, without copying any bytes.
+ *
+ * A single DataView is moved over each slice in turn, so iterating
+ * allocates no objects per slice. Use #dup to keep a slice after the block
+ * returns.
+ *
+ * Example:
+ *   view.each_slice_view(16) { |record| ids << record.getU32(0) }
+ *
+ * @param length [Integer] Size of each slice, greater than zero
+ * @return [DataView, Enumerator]
+ */
+static VALUE
+t_dv_each_slice_view(VALUE self, VALUE length) {
+  RETURN_SIZED_ENUMERATOR(self, 1, &length, dv_slice_view_count);
+  DECLAREDV(self);
+  const ssize_t n = NUM2SSIZET(length);
+  if (n <= 0)
+    rb_raise(rb_eArgError, "length must be greater than zero: %"PRIdSIZE, n);
+
+  VALUE slice = Qnil;
+  int little;
+  for (size_t pos = 0;; pos += (size_t)n) {
+    // The block may resize the buffer, so it is looked up on every step
+    size_t len;
+    llc_view_bytes(self, &len, &little, 0);
+    if (pos >= len)
+      break;
+
+    const size_t size = len - pos < (size_t)n ? len - pos : (size_t)n;
+    if (NIL_P(slice))
+      slice = llc_dv_new(dv->bb_obj, dv->offset + pos, size, little);
+    struct LLC_DataView *slice_dv = (struct LLC_DataView*)rb_check_typeddata(slice, &llc_dataview_type);
+    slice_dv->offset = dv->offset + pos;
+    slice_dv->size = size;
+    rb_yield(slice);
+  }
+  return self;
+}
+
+static void
+define_search_methods(VALUE klass) {
+  rb_define_method(klass, "indexOf", t_index_of, -1);
+  rb_define_method(klass, "lastIndexOf", t_last_index_of, -1);
+  rb_define_method(klass, "indexOfSequence", t_index_of_sequence, -1);
+}
+
+void
+Init_search() {
+  define_search_methods(cArrayBuffer);
+  define_search_methods(cDataView);
+
+  rb_define_method(cDataView, "split", t_dv_split, 1);
+  rb_define_method(cDataView, "each_slice_view", t_dv_each_slice_view, 1);
+}
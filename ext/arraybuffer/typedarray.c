@@ -0,0 +1,501 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+#include <ruby/memory_view.h>
+#endif
+
+extern VALUE cArrayBuffer;
+extern VALUE cTypedArray;
+
+static ID idEndianess = Qundef;
+
+#ifdef WORDS_BIGENDIAN
+#define HOST_LITTLE 0
+#else
+#define HOST_LITTLE 1
+#endif
+
+struct LLC_TypedArray {
+  VALUE bb_obj;
+  size_t offset;
+  size_t length;
+  unsigned char type;
+  unsigned char little;
+  /* Exported through the MemoryView protocol, so they must outlive it */
+  char format[3];
+  ssize_t shape[1];
+  ssize_t strides[1];
+};
+
+/* Element types of the concrete classes, in definition order */
+static const struct {
+  const char *name;
+  unsigned char type;
+  char format;
+} typed_array_kinds[] = {
+  { "Int8Array", LLC_I8, 'c' },
+  { "Uint8Array", LLC_U8, 'C' },
+  { "Int16Array", LLC_I16, 's' },
+  { "Uint16Array", LLC_U16, 'S' },
+  { "Int32Array", LLC_I32, 'l' },
+  { "Uint32Array", LLC_U32, 'L' },
+  { "Int64Array", LLC_I64, 'q' },
+  { "Uint64Array", LLC_U64, 'Q' },
+  { "Float32Array", LLC_F32, 'f' },
+  { "Float64Array", LLC_F64, 'd' },
+};
+
+#define TYPED_ARRAY_KINDS (sizeof(typed_array_kinds) / sizeof(typed_array_kinds[0]))
+
+static VALUE typed_array_classes[TYPED_ARRAY_KINDS];
+
+static void
+t_ta_gc_mark(void *ptr) {
+  struct LLC_TypedArray *ta = (struct LLC_TypedArray*)ptr;
+  if (ta->bb_obj)
+    rb_gc_mark_movable(ta->bb_obj);
+}
+
+static void
+t_ta_free(void *ptr) {
+  xfree(ptr);
+}
+
+static size_t
+t_ta_memsize(const void *ptr) {
+  return sizeof(struct LLC_TypedArray);
+}
+
+static void
+t_ta_compact(void *ptr) {
+  struct LLC_TypedArray *ta = (struct LLC_TypedArray*)ptr;
+  if (ta->bb_obj)
+    ta->bb_obj = rb_gc_location(ta->bb_obj);
+}
+
+static const rb_data_type_t typed_array_type = {
+  "TypedArray",
+  { t_ta_gc_mark, t_ta_free, t_ta_memsize, t_ta_compact, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+#define DECLARETA(o) \
+  struct LLC_TypedArray *ta = (struct LLC_TypedArray*)rb_check_typeddata((o), &typed_array_type)
+
+static VALUE
+t_ta_allocator(VALUE klass) {
+  struct LLC_TypedArray *ta;
+  VALUE obj = TypedData_Make_Struct(klass, struct LLC_TypedArray, &typed_array_type, ta);
+  ta->bb_obj = 0;
+  ta->offset = 0;
+  ta->length = 0;
+  ta->type = LLC_U8;
+  ta->little = HOST_LITTLE;
+  return obj;
+}
+
+/*
+ * Returns the index in typed_array_kinds of the concrete class +klass+ is
+ * or inherits from.
+ */
+static size_t
+typed_array_kind(VALUE klass) {
+  for (VALUE k = klass; !NIL_P(k); k = rb_class_superclass(k)) {
+    for (size_t i = 0; i < TYPED_ARRAY_KINDS; i++) {
+      if (typed_array_classes[i] == k)
+        return i;
+    }
+  }
+  rb_raise(rb_eTypeError, "TypedArray can't be instantiated, use one of its subclasses");
+  return 0;
+}
+
+/*
+ * Returns a pointer to the elements, and in +count+ how many of them lie
+ * within the buffer, which may have shrunk since the array was created.
+ */
+static unsigned char *
+ta_elements(struct LLC_TypedArray *ta, size_t *count, int writable) {
+  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(ta->bb_obj, &llc_arraybuffer_type);
+  if (writable)
+    CHECK_BB_WRITABLE(bb);
+  const size_t width = llc_type_widths[ta->type];
+  const size_t available = ta->offset >= bb->size ? 0 : (bb->size - ta->offset) / width;
+  *count = available < ta->length ? available : ta->length;
+  return bb->ptr + ta->offset;
+}
+
+static unsigned char *
+ta_element_ptr(struct LLC_TypedArray *ta, VALUE index, int writable) {
+  // Converting may run Ruby code that resizes the buffer, so it comes
+  // before the elements are looked up
+  ssize_t idx = NUM2SSIZET(index);
+  size_t count;
+  unsigned char *ptr = ta_elements(ta, &count, writable);
+  if (idx < 0)
+    idx += (ssize_t)ta->length;
+  if (idx < 0 || (size_t)idx >= count)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, idx);
+  return ptr + (size_t)idx * llc_type_widths[ta->type];
+}
+
+/*
+ * call-seq:
+ *  initialize(length, endianess: nil)
+ *  initialize(values, endianess: nil)
+ *  initialize(buffer, byte_offset = 0, length = nil, endianess: nil)
+ *
+ * Creates a typed array, an element-indexed view of an ArrayBuffer.
+ *
+ * Given a length, a new zero-filled buffer is allocated. Given an Array,
+ * a new buffer is allocated and filled with its values. Given an
+ * ArrayBuffer, the typed array covers +length+ elements starting at
+ * +byte_offset+, or as many as fit until the end of the buffer.
+ *
+ * Example:
+ *   samples = Float32Array.new(1024)
+ *   samples[0] = 0.5
+ *   words = Uint16Array.new(buffer, 8, 4, endianess: :big)
+ *
+ * @param endianess [:big, :little] Optional. Defaults to the byte order of
+ *   the host, as JavaScript typed arrays do
+ */
+static VALUE
+t_ta_initialize(int argc, VALUE *argv, VALUE self) {
+  DECLARETA(self);
+  VALUE source;
+  VALUE byte_offset;
+  VALUE length;
+  VALUE kwargs;
+  static ID keyword_ids[] = { 0 };
+
+  rb_scan_args(argc, argv, "12:", &source, &byte_offset, &length, &kwargs);
+
+  const size_t kind = typed_array_kind(rb_obj_class(self));
+  const int type = typed_array_kinds[kind].type;
+  const size_t width = llc_type_widths[type];
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idEndianess;
+  }
+
+  int little = HOST_LITTLE;
+  if (!NIL_P(kwargs)) {
+    VALUE endianess;
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &endianess);
+    if (endianess != Qundef)
+      little = llc_parse_endianess(endianess);
+  }
+
+  VALUE bb_obj;
+  size_t offset = 0;
+  size_t count;
+  VALUE values = Qnil;
+
+  if (rb_typeddata_is_kind_of(source, &llc_arraybuffer_type)) {
+    struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(source, &llc_arraybuffer_type);
+    bb_obj = source;
+    if (!NIL_P(byte_offset)) {
+      const ssize_t val = NUM2SSIZET(byte_offset);
+      if (val < 0 || (size_t)val > bb->size)
+        rb_raise(rb_eArgError, "byte offset out of bounds: %"PRIdSIZE, val);
+      offset = (size_t)val;
+    }
+    if (NIL_P(length)) {
+      count = (bb->size - offset) / width;
+    } else {
+      const ssize_t val = NUM2SSIZET(length);
+      if (val < 0)
+        rb_raise(rb_eArgError, "length must not be negative: %"PRIdSIZE, val);
+      count = (size_t)val;
+      if (count > (bb->size - offset) / width)
+        rb_raise(rb_eArgError, "length out of bounds: %"PRIuSIZE, count);
+    }
+  } else {
+    if (!NIL_P(byte_offset) || !NIL_P(length))
+      rb_raise(rb_eArgError, "byte offset and length are only allowed with an ArrayBuffer");
+    if (RB_TYPE_P(source, T_ARRAY)) {
+      values = source;
+      count = (size_t)rb_array_len(values);
+    } else {
+      const ssize_t val = NUM2SSIZET(source);
+      if (val < 0)
+        rb_raise(rb_eArgError, "length must not be negative: %"PRIdSIZE, val);
+      count = (size_t)val;
+    }
+    if (count > LONG_MAX / width)
+      rb_raise(rb_eArgError, "length too big: %"PRIuSIZE, count);
+    bb_obj = llc_bb_new(count * width, count * width);
+  }
+
+  RB_OBJ_WRITE(self, &ta->bb_obj, bb_obj);
+  ta->offset = offset;
+  ta->length = count;
+  ta->type = (unsigned char)type;
+  ta->little = (unsigned char)little;
+
+  // Pack-style item format. Byte orders other than the host's are given by
+  // a '<' or '>' suffix, or for floats by their own specifiers
+  char *format = ta->format;
+  if (width == 1 || little == HOST_LITTLE) {
+    *format++ = typed_array_kinds[kind].format;
+  } else if (type == LLC_F32) {
+    *format++ = little ? 'e' : 'g';
+  } else if (type == LLC_F64) {
+    *format++ = little ? 'E' : 'G';
+  } else {
+    *format++ = typed_array_kinds[kind].format;
+    *format++ = little ? '<' : '>';
+  }
+  *format = '\0';
+  ta->shape[0] = (ssize_t)count;
+  ta->strides[0] = (ssize_t)width;
+
+  if (!NIL_P(values)) {
+    for (size_t i = 0; i < count; i++) {
+      // Converting may run Ruby code, so the element is looked up after it
+      const uint64_t bits = llc_encode_value(rb_ary_entry(values, (long)i), type);
+      size_t available;
+      unsigned char *ptr = ta_elements(ta, &available, 1);
+      if (i >= available)
+        break;
+      llc_store_uint(ptr + i * width, (unsigned int)width, little, bits);
+    }
+  }
+
+  return self;
+}
+
+/*
+ * Makes the copy an array of the same elements of the same buffer as
+ * +orig+. The elements themselves are not copied.
+ */
+static VALUE
+t_ta_initialize_copy(VALUE self, VALUE orig) {
+  DECLARETA(self);
+  if (self == orig)
+    return self;
+  const struct LLC_TypedArray *src = (const struct LLC_TypedArray*)rb_check_typeddata(orig, &typed_array_type);
+  RB_OBJ_WRITE(self, &ta->bb_obj, src->bb_obj);
+  ta->offset = src->offset;
+  ta->length = src->length;
+  ta->type = src->type;
+  ta->little = src->little;
+  memcpy(ta->format, src->format, sizeof(ta->format));
+  ta->shape[0] = src->shape[0];
+  ta->strides[0] = src->strides[0];
+  return self;
+}
+
+/*
+ * Returns the element at +index+.
+ *
+ * If passed a negative value, it will be summed with the length.
+ *
+ * @return [Integer, Float]
+ */
+static VALUE
+t_ta_aref(VALUE self, VALUE index) {
+  DECLARETA(self);
+  const unsigned char *p = ta_element_ptr(ta, index, 0);
+  return llc_decode_value(p, ta->type, ta->little);
+}
+
+/*
+ * Sets the element at +index+.
+ *
+ * Integer values are capped to the range of the element type, like the
+ * DataView setters do.
+ */
+static VALUE
+t_ta_aset(VALUE self, VALUE index, VALUE value) {
+  DECLARETA(self);
+  const uint64_t bits = llc_encode_value(value, ta->type);
+  unsigned char *p = ta_element_ptr(ta, index, 1);
+  llc_store_uint(p, llc_type_widths[ta->type], ta->little, bits);
+  return value;
+}
+
+/*
+ * Returns the number of elements.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_ta_length(VALUE self) {
+  DECLARETA(self);
+  return SIZET2NUM(ta->length);
+}
+
+/*
+ * Returns the ArrayBuffer holding the elements.
+ *
+ * @return [ArrayBuffer]
+ */
+static VALUE
+t_ta_buffer(VALUE self) {
+  DECLARETA(self);
+  return ta->bb_obj;
+}
+
+/*
+ * Returns the offset, in bytes, of the first element within the buffer.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_ta_byte_offset(VALUE self) {
+  DECLARETA(self);
+  return SIZET2NUM(ta->offset);
+}
+
+/*
+ * Returns the size of the elements in bytes.
+ *
+ * @return [Integer]
+ */
+static VALUE
+t_ta_byte_length(VALUE self) {
+  DECLARETA(self);
+  return SIZET2NUM(ta->length * llc_type_widths[ta->type]);
+}
+
+static VALUE
+t_ta_endianess(VALUE self) {
+  DECLARETA(self);
+  return ID2SYM(rb_intern(ta->little ? "little" : "big"));
+}
+
+static VALUE
+ta_enum_length(VALUE self, VALUE args, VALUE eobj) {
+  return t_ta_length(self);
+}
+
+/*
+ * Yields each element in turn.
+ */
+static VALUE
+t_ta_each(VALUE self) {
+  RETURN_SIZED_ENUMERATOR(self, 0, 0, ta_enum_length);
+  DECLARETA(self);
+  const size_t width = llc_type_widths[ta->type];
+
+  // The block may resize the buffer, so bounds are checked on every step
+  for (size_t i = 0;; i++) {
+    size_t count;
+    const unsigned char *ptr = ta_elements(ta, &count, 0);
+    if (i >= count)
+      break;
+    rb_yield(llc_decode_value(ptr + i * width, ta->type, ta->little));
+  }
+  return self;
+}
+
+/*
+ * Returns the elements as an Array.
+ *
+ * @return [Array<Integer>, Array<Float>]
+ */
+static VALUE
+t_ta_to_a(VALUE self) {
+  DECLARETA(self);
+  const size_t width = llc_type_widths[ta->type];
+  size_t count;
+  const unsigned char *ptr = ta_elements(ta, &count, 0);
+
+  // Allocating Arrays, Floats and Bignums never runs Ruby code that could
+  // resize the buffer, so the pointer stays valid
+  VALUE result = rb_ary_new_capa((long)count);
+  for (size_t i = 0; i < count; i++)
+    rb_ary_push(result, llc_decode_value(ptr + i * width, ta->type, ta->little));
+  return result;
+}
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+static bool
+r_ta_mv_get(VALUE self, rb_memory_view_t *view, int flags) {
+  DECLARETA(self);
+  struct LLC_ArrayBuffer *bb = (struct LLC_ArrayBuffer*)rb_check_typeddata(ta->bb_obj, &llc_arraybuffer_type);
+  size_t count;
+  unsigned char *ptr = ta_elements(ta, &count, 0);
+  // Views must not outlive the elements they describe
+  if (!count || count < ta->length)
+    return 0;
+
+  const bool readonly = (bb->flags & BB_FLAG_READONLY) != 0;
+  if (readonly && (flags & RUBY_MEMORY_VIEW_WRITABLE))
+    return 0;
+
+  view->obj = self;
+  view->data = ptr;
+  view->byte_size = (ssize_t)(ta->length * llc_type_widths[ta->type]);
+  view->readonly = readonly;
+  view->format = ta->format;
+  view->item_size = (ssize_t)llc_type_widths[ta->type];
+  view->item_desc.components = NULL;
+  view->item_desc.length = 0;
+  view->ndim = 1;
+  view->shape = ta->shape;
+  view->strides = ta->strides;
+  view->sub_offsets = NULL;
+  view->private_data = NULL;
+  llc_bb_pin(ta->bb_obj);
+  return 1;
+}
+
+static bool
+r_ta_mv_release(VALUE self, rb_memory_view_t *view) {
+  DECLARETA(self);
+  llc_bb_unpin(ta->bb_obj);
+  return 1;
+}
+
+static bool
+r_ta_mv_available_p(VALUE self) {
+  DECLARETA(self);
+  return ta->length > 0 ? 1 : 0;
+}
+
+static rb_memory_view_entry_t cTypedArrayMemoryView = {
+  r_ta_mv_get,
+  r_ta_mv_release,
+  r_ta_mv_available_p
+};
+#endif
+
+void
+Init_typedarray() {
+  idEndianess = rb_intern("endianess");
+
+  cTypedArray = rb_define_class("TypedArray", rb_cObject);
+  rb_define_alloc_func(cTypedArray, t_ta_allocator);
+  rb_include_module(cTypedArray, rb_mEnumerable);
+
+  rb_define_method(cTypedArray, "initialize", t_ta_initialize, -1);
+  rb_define_method(cTypedArray, "initialize_copy", t_ta_initialize_copy, 1);
+  rb_define_method(cTypedArray, "[]", t_ta_aref, 1);
+  rb_define_method(cTypedArray, "[]=", t_ta_aset, 2);
+  rb_define_method(cTypedArray, "length", t_ta_length, 0);
+  rb_define_alias(cTypedArray, "size", "length");
+  rb_define_method(cTypedArray, "buffer", t_ta_buffer, 0);
+  rb_define_method(cTypedArray, "byte_offset", t_ta_byte_offset, 0);
+  rb_define_method(cTypedArray, "byte_length", t_ta_byte_length, 0);
+  rb_define_method(cTypedArray, "endianess", t_ta_endianess, 0);
+  rb_define_method(cTypedArray, "each", t_ta_each, 0);
+  rb_define_method(cTypedArray, "to_a", t_ta_to_a, 0);
+
+  for (size_t i = 0; i < TYPED_ARRAY_KINDS; i++) {
+    VALUE klass = rb_define_class(typed_array_kinds[i].name, cTypedArray);
+    rb_define_const(klass, "BYTES_PER_ELEMENT", INT2FIX(llc_type_widths[typed_array_kinds[i].type]));
+    typed_array_classes[i] = klass;
+  }
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+  rb_memory_view_register(cTypedArray, &cTypedArrayMemoryView);
+#endif
+}
@@ -0,0 +1,275 @@
+#include "arraybuffer.h"
+#include "dataview.h"
+#include "byteorder.h"
+#include "extconf.h"
+#include <string.h>
+
+extern VALUE cDataView;
+
+static ID idZigzag = Qundef;
+
+/* The most bytes a 64 bits varint takes */
+#define VARINT_MAX_BYTES 10
+
+/*
+ * Decodes the varint at +p+, with +len+ bytes available, into +value+.
+ * Returns the count of bytes it takes, or zero if it is truncated or does
+ * not fit in 64 bits.
+ */
+static inline size_t
+varint_decode_scalar(const unsigned char *p, size_t len, uint64_t *value) {
+  uint64_t val = 0;
+  const size_t max = len < VARINT_MAX_BYTES ? len : VARINT_MAX_BYTES;
+  for (size_t i = 0; i < max; i++) {
+    const uint64_t byte = p[i];
+    if (i == VARINT_MAX_BYTES - 1 && byte > 1)
+      return 0;
+    val |= (byte & 0x7F) << (7 * i);
+    if (!(byte & 0x80)) {
+      *value = val;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Same as varint_decode_scalar, with at least 8 bytes available at +p+.
+ *
+ * Varints of up to 8 bytes are decoded from a single 8-byte load: the
+ * first clear continuation bit gives the length, and the 7-bit groups are
+ * packed together with three masked shifts instead of a loop.
+ */
+static inline size_t
+varint_decode_word(const unsigned char *p, size_t len, uint64_t *value) {
+  if (!(p[0] & 0x80)) {
+    *value = p[0];
+    return 1;
+  }
+
+  const uint64_t word = llc_load_uint(p, 8, 1);
+  const uint64_t stops = ~word & UINT64_C(0x8080808080808080);
+  if (!stops)
+    return varint_decode_scalar(p, len, value);
+
+  const unsigned int bits = (unsigned int)__builtin_ctzll(stops) + 1;
+  uint64_t val = word & (bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1);
+  val &= UINT64_C(0x7F7F7F7F7F7F7F7F);
+  val = (val & UINT64_C(0x007F007F007F007F)) | ((val & UINT64_C(0x7F007F007F007F00)) >> 1);
+  val = (val & UINT64_C(0x00003FFF00003FFF)) | ((val & UINT64_C(0x3FFF00003FFF0000)) >> 2);
+  val = (val & UINT64_C(0x000000000FFFFFFF)) | ((val & UINT64_C(0x0FFFFFFF00000000)) >> 4);
+  *value = val;
+  return bits / 8;
+}
+
+static inline size_t
+varint_decode(const unsigned char *p, size_t len, uint64_t *value) {
+  if (len >= 8)
+    return varint_decode_word(p, len, value);
+  return varint_decode_scalar(p, len, value);
+}
+
+/*
+ * Encodes +val+ at +p+ and returns the count of bytes written.
+ */
+static inline size_t
+varint_encode(unsigned char *p, uint64_t val) {
+  size_t n = 0;
+  while (val >= 0x80) {
+    p[n++] = (unsigned char)(val | 0x80);
+    val >>= 7;
+  }
+  p[n++] = (unsigned char)val;
+  return n;
+}
+
+static inline size_t
+varint_size(uint64_t val) {
+  size_t n = 1;
+  while (val >= 0x80) {
+    val >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static inline int64_t
+zigzag_decode(uint64_t val) {
+  return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static inline uint64_t
+zigzag_encode(int64_t val) {
+  return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+/*
+ * Resolves +val+, which may be negative, within the bytes of +self+ and
+ * returns a pointer to it, storing it in +idx+ and how many bytes follow in
+ * +len+.
+ *
+ * Converting the offset may run Ruby code that resizes the buffer, so
+ * callers do it, and convert any value, before the bytes are taken here.
+ */
+static unsigned char *
+varint_at(VALUE self, ssize_t val, int writable, size_t *idx, size_t *len) {
+  size_t size;
+  unsigned char *ptr = llc_view_bytes(self, &size, NULL, writable);
+  if (val < 0)
+    val += (ssize_t)size;
+  if (val < 0 || (size_t)val >= size)
+    rb_raise(rb_eArgError, "index out of bounds: %"PRIdSIZE, val);
+  *idx = (size_t)val;
+  *len = size - (size_t)val;
+  return ptr + val;
+}
+
+static VALUE
+varint_get(VALUE self, ssize_t offset, int zigzag) {
+  size_t idx;
+  size_t len;
+  const unsigned char *p = varint_at(self, offset, 0, &idx, &len);
+  uint64_t val;
+  const size_t n = varint_decode(p, len, &val);
+  if (!n)
+    rb_raise(rb_eArgError, "malformed or truncated varint at %"PRIuSIZE, idx);
+  VALUE value = zigzag ? LL2NUM(zigzag_decode(val)) : ULL2NUM(val);
+  return rb_assoc_new(value, SIZET2NUM(n));
+}
+
+static VALUE
+varint_set(VALUE self, ssize_t offset, uint64_t val) {
+  size_t idx;
+  size_t len;
+  unsigned char *p = varint_at(self, offset, 1, &idx, &len);
+  const size_t n = varint_size(val);
+  if (n > len)
+    rb_raise(rb_eArgError, "%"PRIuSIZE" bytes needed, but only %"PRIuSIZE" available", n, len);
+  varint_encode(p, val);
+  return SIZET2NUM(n);
+}
+
+/*
+ * Reads the unsigned LEB128 varint at +offset+, as used by Protocol
+ * Buffers: 7 bits per byte, least significant group first, with the high
+ * bit of every byte but the last set.
+ *
+ * Example:
+ *   value, size = view.getVarint(pos)
+ *   pos += size
+ *
+ * @return [Array(Integer, Integer)] The value and how many bytes it takes
+ */
+static VALUE
+t_dv_getvarint(VALUE self, VALUE offset) {
+  return varint_get(self, NUM2SSIZET(offset), 0);
+}
+
+/*
+ * Writes +value+ as an unsigned LEB128 varint at +offset+.
+ *
+ * Values lower than zero will be set to 0 and values greater than
+ * 18446744073709551615 will be capped.
+ *
+ * @return [Integer] How many bytes were written, from 1 to 10
+ */
+static VALUE
+t_dv_setvarint(VALUE self, VALUE offset, VALUE value) {
+  const ssize_t idx = NUM2SSIZET(offset);
+  return varint_set(self, idx, llc_capped_uint64(value));
+}
+
+/*
+ * Reads the ZigZag-encoded signed varint at +offset+, as Protocol Buffers'
+ * +sint64+, where 0, -1, 1, -2 are stored as 0, 1, 2, 3.
+ *
+ * @return [Array(Integer, Integer)] The value and how many bytes it takes
+ */
+static VALUE
+t_dv_getzigzag(VALUE self, VALUE offset) {
+  return varint_get(self, NUM2SSIZET(offset), 1);
+}
+
+/*
+ * Writes +value+ as a ZigZag-encoded signed varint at +offset+.
+ *
+ * Values out of the range of a 64 bits signed integer will be capped.
+ *
+ * @return [Integer] How many bytes were written, from 1 to 10
+ */
+static VALUE
+t_dv_setzigzag(VALUE self, VALUE offset, VALUE value) {
+  const ssize_t idx = NUM2SSIZET(offset);
+  return varint_set(self, idx, zigzag_encode(llc_capped_int(value, INT64_MIN, INT64_MAX)));
+}
+
+/*
+ * call-seq:
+ *  decode_varints(offset, count, zigzag: false)
+ *
+ * Decodes +count+ consecutive varints starting at +offset+.
+ *
+ * Runs of varints are decoded natively, 8 bytes at a time wherever they
+ * are available, without a method call per value.
+ *
+ * Example:
+ *   values, size = view.decode_varints(pos, 100)
+ *   pos += size
+ *
+ * @param zigzag [Boolean] Optional. Whether the varints are ZigZag-encoded
+ * @return [Array(Array<Integer>, Integer)] The values and how many bytes
+ *   they take
+ */
+static VALUE
+t_dv_decode_varints(int argc, VALUE *argv, VALUE self) {
+  VALUE offset;
+  VALUE count;
+  VALUE kwargs;
+  VALUE zigzag_value = Qundef;
+  static ID keyword_ids[] = { 0 };
+  rb_scan_args(argc, argv, "2:", &offset, &count, &kwargs);
+
+  if (!keyword_ids[0]) {
+    keyword_ids[0] = idZigzag;
+  }
+  if (!NIL_P(kwargs))
+    rb_get_kwargs(kwargs, keyword_ids, 0, 1, &zigzag_value);
+  const int zigzag = zigzag_value != Qundef && RTEST(zigzag_value);
+
+  const ssize_t from = NUM2SSIZET(offset);
+  const long n = NUM2LONG(count);
+  if (n < 0)
+    rb_raise(rb_eArgError, "count must not be negative: %ld", n);
+  if (!n)
+    return rb_assoc_new(rb_ary_new(), INT2FIX(0));
+
+  size_t idx;
+  size_t len;
+  // Neither decoding nor pushing runs Ruby code, so the bytes stay put
+  const unsigned char *start = varint_at(self, from, 0, &idx, &len);
+  // Every varint takes at least a byte
+  VALUE values = rb_ary_new_capa((size_t)n < len ? n : (long)len);
+  const unsigned char *p = start;
+  const unsigned char *end = start + len;
+  for (long i = 0; i < n; i++) {
+    uint64_t val;
+    const size_t size = varint_decode(p, (size_t)(end - p), &val);
+    if (!size)
+      rb_raise(rb_eArgError, "malformed or truncated varint at %"PRIuSIZE" after %ld values",
+        idx + (size_t)(p - start), i);
+    rb_ary_push(values, zigzag ? LL2NUM(zigzag_decode(val)) : ULL2NUM(val));
+    p += size;
+  }
+  return rb_assoc_new(values, SIZET2NUM((size_t)(p - start)));
+}
+
+void
+Init_varint() {
+  idZigzag = rb_intern("zigzag");
+
+  rb_define_method(cDataView, "getVarint", t_dv_getvarint, 1);
+  rb_define_method(cDataView, "setVarint", t_dv_setvarint, 2);
+  rb_define_method(cDataView, "getZigZag", t_dv_getzigzag, 1);
+  rb_define_method(cDataView, "setZigZag", t_dv_setzigzag, 2);
+  rb_define_method(cDataView, "decode_varints", t_dv_decode_varints, -1);
+}
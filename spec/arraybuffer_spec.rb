@@ -53,6 +53,274 @@ describe ArrayBuffer do
     end
   end
 
+  describe "growing" do
+    let(:buffer) { described_class.new(0) }
+
+    it "appends typed values at the end" do
+      buffer.append_u8(1).append_u16(0x0203).append_u32(0x04050607, endianess: :little)
+      expect(buffer.bytes.bytes).to eq([1, 2, 3, 7, 6, 5, 4])
+      expect(buffer.size).to eq(7)
+    end
+
+    it "caps appended values" do
+      buffer.append_u8(300).append_u16(-1)
+      expect(buffer.bytes.bytes).to eq([255, 0, 0])
+    end
+
+    it "appends bytes from strings, buffers and views" do
+      other = described_class.new(3)
+      other[1] = 9
+      buffer << "ab" << other << DataView.new(other, 1, 1)
+      expect(buffer.bytes.bytes).to eq([97, 98, 0, 9, 0, 9])
+    end
+
+    it "can append itself" do
+      buffer << "xyz"
+      buffer << buffer
+      expect(buffer.bytes).to eq("xyzxyz")
+    end
+
+    it "grows the capacity geometrically" do
+      capacities = 1000.times.map { buffer.append_u8(1).capacity }.uniq
+      expect(capacities.length < 20).to be(true)
+      expect(buffer.size).to eq(1000)
+    end
+
+    it "reserves capacity without changing the size" do
+      buffer.reserve(4096)
+      expect(buffer.capacity >= 4096).to be(true)
+      expect(buffer.size).to eq(0)
+    end
+
+    it "shrinks the capacity to the size" do
+      buffer.reserve(4096)
+      buffer << "abc"
+      buffer.shrink_to_fit
+      expect(buffer.capacity < 4096).to be(true)
+      expect(buffer.bytes).to eq("abc")
+    end
+  end
+
+  describe "mmap" do
+    let(:file) do
+      Tempfile.new("arraybuffer").tap do |f|
+        f.binmode
+        f.write(buffer_bytes)
+        f.flush
+      end
+    end
+    let(:path) { file.path }
+
+    after { file.close! }
+
+    context "when read-only" do
+      let(:buffer) { described_class.mmap(path) }
+
+      it "exposes the file contents without copying them in" do
+        expect(buffer).to be_mapped
+        expect(buffer.size).to eq(buffer_bytes.bytesize)
+        expect(buffer.bytes).to eq(buffer_bytes)
+      end
+
+      it "can be read through a DataView" do
+        dv = DataView.new(buffer, 2, 4)
+        expect(dv.to_a).to eq(buffer_data[2...6])
+      end
+
+      it "raises on writes" do
+        expect { buffer[0] = 1 }.to raise_error(FrozenError)
+        expect { DataView.new(buffer).setU16(0, 1) }.to raise_error(FrozenError)
+      end
+
+      it "can not be reallocated" do
+        expect { buffer.realloc(2) }.to raise_error(RuntimeError, /memory-mapped/)
+      end
+    end
+
+    context "when read-write" do
+      let(:buffer) { described_class.mmap(path, :rw) }
+
+      it "writes through to the file" do
+        buffer[0] = buffer_data[0] ^ 0xFF
+        buffer.msync
+        expect(File.binread(path).getbyte(0)).to eq(buffer_data[0] ^ 0xFF)
+      end
+    end
+
+    it "has size zero after close" do
+      buffer = described_class.mmap(path)
+      buffer.close
+      expect(buffer.size).to eq(0)
+      expect { buffer[0] }.to raise_error(ArgumentError, /Index out of bounds/)
+    end
+
+    it "rejects unknown modes" do
+      expect { described_class.mmap(path, :w) }.to raise_error(ArgumentError, /mode must be/)
+    end
+
+    it "raises when the file does not exist" do
+      expect { described_class.mmap("#{path}.missing") }.to raise_error(Errno::ENOENT)
+    end
+  end
+
+  describe "from_memory_view" do
+    it "shares the memory of another buffer" do
+      set_data!
+      shared = described_class.from_memory_view(buffer)
+      expect(shared.bytes).to eq(buffer.bytes)
+      shared[0] = 42
+      expect(buffer[0]).to eq(42)
+    end
+
+    it "keeps the source from being resized" do
+      described_class.from_memory_view(DataView.new(buffer, 2))
+      expect { buffer.realloc(20) }.to raise_error(RuntimeError, /in use/)
+    end
+
+    it "lets the source be resized once closed" do
+      [buffer, DataView.new(buffer, 2), Uint8Array.new(buffer)].each do |source|
+        shared = described_class.from_memory_view(source)
+        expect { buffer.realloc(20) }.to raise_error(RuntimeError, /in use/)
+        shared.close
+      end
+      buffer.realloc(20)
+      expect(buffer.size).to eq(20)
+    end
+
+    it "keeps the source alive" do
+      shared = described_class.from_memory_view(Uint8Array.new([1, 2, 3]))
+      GC.start
+      expect(shared.to_a).to eq([1, 2, 3])
+    end
+
+    it "can not be resized" do
+      shared = described_class.from_memory_view(buffer)
+      expect { shared.realloc(2) }.to raise_error(RuntimeError, /external/)
+      expect { shared.append_u8(1) }.to raise_error(RuntimeError, /external/)
+    end
+
+    it "has size zero after close" do
+      shared = described_class.from_memory_view(buffer)
+      shared.close
+      expect(shared.size).to eq(0)
+    end
+
+    it "raises for objects without a memory view" do
+      expect { described_class.from_memory_view(Object.new) }.to raise_error(ArgumentError, /memory view/)
+    end
+  end
+
+  describe "IO::Buffer" do
+    before do
+      skip "IO::Buffer is not available" unless defined?(IO::Buffer)
+    end
+
+    it "exports its memory without copying" do
+      set_data!
+      io_buffer = buffer.to_io_buffer
+      expect(io_buffer.get_string).to eq(buffer.bytes)
+      io_buffer.set_value(:U8, 0, 42)
+      expect(buffer[0]).to eq(42)
+      expect { buffer.realloc(20) }.to raise_error(RuntimeError, /in use/)
+    end
+
+    it "imports an IO::Buffer without copying" do
+      io_buffer = IO::Buffer.new(4)
+      imported = described_class.from_io_buffer(io_buffer)
+      imported[1] = 7
+      expect(io_buffer.get_value(:U8, 1)).to eq(7)
+      expect(io_buffer).to be_locked
+      imported.close
+      expect(io_buffer).not_to be_locked
+    end
+
+    it "unlocks the IO::Buffer once the importing buffer is collected" do
+      io_buffer = IO::Buffer.new(4)
+      10.times { described_class.from_io_buffer(io_buffer).close }
+      3.times { described_class.new(0).tap { described_class.from_io_buffer(IO::Buffer.new(4)) } }
+      imported = [described_class.from_io_buffer(io_buffer)]
+      expect(io_buffer).to be_locked
+      imported.clear
+      4.times { GC.start }
+      expect(io_buffer).not_to be_locked
+      io_buffer.resize(8)
+      expect(io_buffer.size).to eq(8)
+    end
+
+    it "imports read-only IO::Buffers as read-only" do
+      imported = described_class.from_io_buffer(IO::Buffer.for("abc".freeze))
+      expect(imported.to_a).to eq([97, 98, 99])
+      expect { imported[0] = 1 }.to raise_error(FrozenError)
+    end
+
+    it "raises for other objects" do
+      expect { described_class.from_io_buffer("abc") }.to raise_error(TypeError)
+    end
+  end
+
+  describe "gvl_threshold" do
+    around do |example|
+      threshold = described_class.gvl_threshold
+      example.run
+    ensure
+      described_class.gvl_threshold = threshold
+    end
+
+    it "defaults to 1 MiB" do
+      expect(described_class.gvl_threshold).to eq(1024 * 1024)
+    end
+
+    it "rejects negative thresholds" do
+      expect { described_class.gvl_threshold = -1 }.to raise_error(ArgumentError, /must not be negative/)
+    end
+
+    it "copies without the GVL above the threshold" do
+      described_class.gvl_threshold = 0
+      source = described_class.new(4)
+      [1, 2, 3, 4].each_with_index { |v, idx| source[idx] = v }
+      target = described_class.new(8)
+      view = DataView.new(target)
+      view.setBytes(1, source)
+      view.setBytes(5, "\x05\x06".b)
+      expect(target.bytes.bytes).to eq([0, 1, 2, 3, 4, 5, 6, 0])
+    end
+
+    it "unpins the buffers afterwards" do
+      described_class.gvl_threshold = 0
+      DataView.new(buffer).setBytes(0, described_class.new(2))
+      buffer.realloc(20)
+      expect(buffer.size).to eq(20)
+    end
+  end
+
+  describe "memory" do
+    before { require "objspace" }
+
+    it "reports the mapped bytes it holds" do
+      Tempfile.create("memsize") do |file|
+        file.write("\0" * 1_000_000)
+        file.flush
+        mapped = described_class.mmap(file.path)
+        expect(ObjectSpace.memsize_of(mapped)).to be >= 1_000_000
+        mapped.close
+      end
+    end
+
+    it "leaves the bytes of its backing string to the string" do
+      buffer = described_class.new(1_000_000)
+      expect(ObjectSpace.memsize_of(buffer)).to be < 1_000_000
+    end
+
+    it "keeps its contents across GC compaction" do
+      skip "GC compaction is not supported" unless GC.respond_to?(:verify_compaction_references)
+      set_data!
+      view = DataView.new(buffer, 1)
+      GC.verify_compaction_references(expand_heap: true, toward: :empty)
+      expect(buffer.bytes.bytes).to eq(buffer_data)
+      expect(view.getU8(0)).to eq(buffer_data[1])
+    end
+  end
+
   private
 
   def set_data!
@@ -0,0 +1,110 @@
+require "spec_helper"
+
+describe "bitmaps" do
+  def bitmap(*bytes)
+    buffer = ArrayBuffer.new(bytes.size)
+    bytes.each_with_index { |byte, idx| buffer[idx] = byte }
+    buffer
+  end
+
+  def bytes_of(buffer)
+    buffer.bytes.bytes
+  end
+
+  let(:left) { bitmap(0b1100, 0xFF, 0x00, 0x0F, 0xAA, 0x55, 0x01, 0x80, 0x33) }
+  let(:right) { bitmap(0b1010, 0x0F, 0xFF, 0x0F, 0xFF, 0x00, 0x03, 0x80, 0x0F) }
+
+  describe "and, or, xor, andnot and not" do
+    it "returns new buffers" do
+      expect(bytes_of(left.and(right))).to eq(bytes_of(left).zip(bytes_of(right)).map { |a, b| a & b })
+      expect(bytes_of(left | right)).to eq(bytes_of(left).zip(bytes_of(right)).map { |a, b| a | b })
+      expect(bytes_of(left ^ right)).to eq(bytes_of(left).zip(bytes_of(right)).map { |a, b| a ^ b })
+      expect(bytes_of(left.andnot(right))).to eq(bytes_of(left).zip(bytes_of(right)).map { |a, b| a & ~b & 0xFF })
+      expect(bytes_of(~left)).to eq(bytes_of(left).map { |a| ~a & 0xFF })
+      expect(bytes_of(left)[0]).to eq(0b1100)
+    end
+
+    it "works in place" do
+      expected = bytes_of(left).zip(bytes_of(right)).map { |a, b| a & b }
+      expect(left.and!(right)).to be(left)
+      expect(bytes_of(left)).to eq(expected)
+      left.not!
+      expect(bytes_of(left)).to eq(expected.map { |a| ~a & 0xFF })
+    end
+
+    it "works between views" do
+      buffer = bitmap(*(0...20).to_a)
+      head = DataView.new(buffer, 0, 10)
+      tail = DataView.new(buffer, 10, 10)
+      expect(bytes_of(head ^ tail)).to eq((0...10).map { |idx| idx ^ (idx + 10) })
+    end
+
+    it "handles overlapping views in place" do
+      buffer = bitmap(*(1..24).to_a)
+      source = DataView.new(buffer, 0, 20)
+      target = DataView.new(buffer, 3, 20)
+      target.or!(source)
+      expect(bytes_of(buffer)[3, 20]).to eq((0...20).map { |idx| (idx + 4) | (idx + 1) })
+    end
+
+    it "raises on size mismatches" do
+      expect { left & ArrayBuffer.new(2) }.to raise_error(ArgumentError, /differ in size/)
+      expect { DataView.new(left).and!(ArrayBuffer.new(2)) }.to raise_error(ArgumentError)
+    end
+  end
+
+  describe "popcount and rank" do
+    it "counts set bits" do
+      expect(left.popcount).to eq(bytes_of(left).sum { |byte| byte.to_s(2).count("1") })
+      expect(DataView.new(left, 1, 2).popcount).to eq(8)
+      expect(ArrayBuffer.new(0).popcount).to eq(0)
+    end
+
+    it "counts set bits before an index" do
+      expect(left.rank(0)).to eq(0)
+      expect(left.rank(3)).to eq(1)
+      expect(left.rank(12)).to eq(6)
+      expect(left.rank(72)).to eq(left.popcount)
+      expect(left.rank(-8)).to eq(left.popcount - 4)
+      expect { left.rank(73) }.to raise_error(ArgumentError, /out of bounds/)
+    end
+
+    it "converts the index before taking the bytes" do
+      large = ArrayBuffer.new(1024 * 1024).fill(0xFF)
+      expect { large.rank(shrinking_index(large, 1, 800)) }.to raise_error(ArgumentError, /out of bounds/)
+      expect(large.rank(shrinking_index(large, 1, 8))).to eq(8)
+    end
+  end
+
+  describe "next_set_bit and each_set_bit" do
+    it "finds set bits LSB-first like getBit" do
+      view = DataView.new(left)
+      expect(left.next_set_bit).to eq(2)
+      expect(view.getBit(2)).to eq(1)
+      expect(left.next_set_bit(4)).to eq(8)
+      expect(left.next_set_bit(16)).to eq(24)
+      expect(left.next_set_bit(72)).to be_nil
+    end
+
+    it "skips long runs of zeros" do
+      buffer = ArrayBuffer.new(100)
+      buffer[97] = 0x10
+      expect(buffer.next_set_bit).to eq(97 * 8 + 4)
+      expect(buffer.next_set_bit(97 * 8 + 5)).to be_nil
+    end
+
+    it "converts the start before taking the bytes" do
+      large = ArrayBuffer.new(1024 * 1024).fill(0xFF)
+      expect { large.next_set_bit(shrinking_index(large, 1, 800)) }.to raise_error(ArgumentError, /out of bounds/)
+    end
+
+    it "yields every set bit" do
+      bits = []
+      left.each_set_bit { |idx| bits << idx }
+      view = DataView.new(left)
+      expect(bits).to eq((0...72).select { |idx| view.getBit(idx) == 1 })
+      expect(left.each_set_bit.size).to eq(left.popcount)
+      expect(left.each_set_bit.to_a).to eq(bits)
+    end
+  end
+end
@@ -0,0 +1,108 @@
+require "spec_helper"
+
+describe "bit fields" do
+  let(:buffer) do
+    ArrayBuffer.new(10).tap do |b|
+      [0b1010_0110, 0b1100_0011, 0xFF, 0x00, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC].each_with_index { |v, idx| b[idx] = v }
+    end
+  end
+  let(:view) { DataView.new(buffer) }
+
+  describe "getBits" do
+    it "reads LSB-first by default, like getBit" do
+      expect(view.getBits(1, 3)).to eq(0b011)
+      expect(view.getBits(6, 4)).to eq(0b1110)
+      8.times { |idx| expect(view.getBits(idx, 1)).to eq(view.getBit(idx)) }
+    end
+
+    it "reads MSB-first" do
+      expect(view.getBits(0, 4, order: :msb)).to eq(0b1010)
+      expect(view.getBits(6, 4, order: :msb)).to eq(0b1011)
+    end
+
+    it "reads 64 bits fields at any offset" do
+      expect(view.getBits(32, 48, order: :msb)).to eq(0x123456789ABC)
+      expect(view.getBits(4, 64, order: :msb)).to eq(0x6C3FF0012345678 << 4 | 0x9)
+      expect(view.getBits(8, 64)).to eq(0x9A78563412_00FFC3)
+    end
+
+    it "supports negative offsets" do
+      expect(view.getBits(-8, 8)).to eq(0xBC)
+    end
+
+    it "validates offset, width and order" do
+      expect { view.getBits(78, 3) }.to raise_error(ArgumentError, /out of bounds/)
+      expect { view.getBits(0, 0) }.to raise_error(ArgumentError, /width/)
+      expect { view.getBits(0, 65) }.to raise_error(ArgumentError, /width/)
+      expect { view.getBits(0, 1, order: :big) }.to raise_error(ArgumentError, /order/)
+    end
+
+    it "converts the offset before taking the bytes" do
+      expect { view.getBits(shrinking_index(buffer, 1, 64), 8) }.to raise_error(ArgumentError, /out of bounds/)
+      expect { view.setBits(shrinking_index(buffer, 1, 64), 8, 1) }.to raise_error(ArgumentError, /out of bounds/)
+      expect(view.getBits(shrinking_index(buffer, 1, 0), 8)).to eq(0b1010_0110)
+    end
+  end
+
+  describe "setBits" do
+    it "writes fields keeping the bits around them" do
+      view.setBits(4, 8, 0xAB, order: :msb)
+      expect(buffer[0]).to eq(0b1010_1010)
+      expect(buffer[1]).to eq(0b1011_0011)
+      view.setBits(2, 3, 0b001)
+      expect(buffer[0]).to eq(0b1010_0110)
+      expect(view.getBits(2, 3)).to eq(0b001)
+    end
+
+    it "writes 64 bits fields" do
+      view.setBits(3, 64, 2**64 - 2, order: :msb)
+      expect(view.getBits(3, 64, order: :msb)).to eq(2**64 - 2)
+    end
+
+    it "caps values" do
+      view.setBits(0, 4, 100)
+      expect(view.getBits(0, 4)).to eq(15)
+      view.setBits(0, 4, -1)
+      expect(view.getBits(0, 4)).to eq(0)
+    end
+  end
+
+  describe ArrayBuffer::BitReader do
+    it "reads successive fields" do
+      reader = described_class.new(view, order: :msb)
+      expect(reader.read(4)).to eq(0b1010)
+      expect(reader.read(6)).to eq(0b011011)
+      expect(reader.peek(6)).to eq(0b000011)
+      expect(reader.read(6)).to eq(0b000011)
+      expect(reader.pos).to eq(16)
+      expect(reader.read(64)).to eq(0xFF00123456789ABC)
+      expect(reader).to be_eof
+    end
+
+    it "reads LSB-first fields" do
+      reader = described_class.new(buffer)
+      expect(reader.read(1)).to eq(0)
+      expect(reader.read(3)).to eq(0b011)
+      expect(reader.read(8)).to eq(0b0011_1010)
+      expect(reader.remaining).to eq(68)
+    end
+
+    it "skips, aligns and moves" do
+      reader = described_class.new(view, order: :msb)
+      reader.skip(3)
+      reader.align
+      expect(reader.pos).to eq(8)
+      expect(reader.read(8)).to eq(0b1100_0011)
+      reader.pos = -8
+      expect(reader.read(8)).to eq(0xBC)
+    end
+
+    it "raises EOFError without moving" do
+      reader = described_class.new(DataView.new(buffer, 8))
+      reader.read(10)
+      expect { reader.read(7) }.to raise_error(EOFError)
+      expect(reader.pos).to eq(10)
+      expect(reader.read(6)).to eq(0xBC >> 2)
+    end
+  end
+end
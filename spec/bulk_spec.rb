@@ -0,0 +1,149 @@
+require "spec_helper"
+
+describe "bulk operations" do
+  let(:buffer) do
+    ArrayBuffer.new(10).tap do |b|
+      10.times { |idx| b[idx] = idx }
+    end
+  end
+
+  describe "fill" do
+    it "fills the whole buffer" do
+      buffer.fill(7)
+      expect(buffer.to_a).to eq([7] * 10)
+    end
+
+    it "fills a range with JavaScript semantics" do
+      buffer.fill(0xFF, 2, -2)
+      expect(buffer.to_a).to eq([0, 1, 255, 255, 255, 255, 255, 255, 8, 9])
+      buffer.fill(1, -100, 1)
+      expect(buffer[0]).to eq(1)
+      buffer.fill(1, 5, 2)
+      expect(buffer[4]).to eq(255)
+    end
+
+    it "caps the value" do
+      buffer.fill(300, 0, 1)
+      buffer.fill(-3, 1, 2)
+      expect(buffer.to_a.first(2)).to eq([255, 0])
+    end
+
+    it "fills relative to a view" do
+      DataView.new(buffer, 3, 4).fill(0)
+      expect(buffer.to_a).to eq([0, 1, 2, 0, 0, 0, 0, 7, 8, 9])
+    end
+
+    it "converts the range before taking the bytes" do
+      buffer.fill(7, 0, shrinking_index(buffer, 2, 10))
+      expect(buffer.to_a).to eq([7, 7])
+    end
+
+    it "refuses read-only buffers" do
+      Tempfile.create("fill") do |file|
+        file.write("abc")
+        file.flush
+        mapped = ArrayBuffer.mmap(file.path)
+        expect { mapped.fill(0) }.to raise_error(FrozenError)
+        mapped.close
+      end
+    end
+  end
+
+  describe "fill_u16 and fill_u32" do
+    it "repeats big endian values by default" do
+      buffer.fill_u16(0x0102)
+      expect(buffer.to_a).to eq([1, 2] * 5)
+    end
+
+    it "leaves a trailing partial element untouched" do
+      buffer.fill_u32(0x01020304, 1)
+      expect(buffer.to_a).to eq([0, 1, 2, 3, 4, 1, 2, 3, 4, 9])
+    end
+
+    it "uses the endianess of the view or the given one" do
+      view = DataView.new(buffer, 0, 8, endianess: :little)
+      view.fill_u32(0x01020304)
+      expect(buffer.to_a.first(8)).to eq([4, 3, 2, 1, 4, 3, 2, 1])
+      view.fill_u16(0x0A0B, 0, 4, endianess: :big)
+      expect(buffer.to_a.first(4)).to eq([10, 11, 10, 11])
+    end
+
+    it "fills large ranges" do
+      large = ArrayBuffer.new(3 * 1024 * 1024 + 6)
+      large.fill_u32(0xDEADBEEF)
+      view = DataView.new(large)
+      expect(view.getU32(0)).to eq(0xDEADBEEF)
+      expect(view.getU32(3 * 1024 * 1024)).to eq(0xDEADBEEF)
+      expect(view.getU16(3 * 1024 * 1024 + 4)).to eq(0)
+    end
+  end
+
+  describe "copy_within" do
+    it "moves bytes forward over themselves" do
+      buffer.copy_within(2, 0, 6)
+      expect(buffer.to_a).to eq([0, 1, 0, 1, 2, 3, 4, 5, 8, 9])
+    end
+
+    it "moves bytes backwards over themselves" do
+      buffer.copy_within(0, 4)
+      expect(buffer.to_a).to eq([4, 5, 6, 7, 8, 9, 6, 7, 8, 9])
+    end
+
+    it "stops at the end" do
+      buffer.copy_within(8, 0)
+      expect(buffer.to_a).to eq([0, 1, 2, 3, 4, 5, 6, 7, 0, 1])
+    end
+
+    it "copies relative to a view" do
+      DataView.new(buffer, 5).copy_within(0, -2)
+      expect(buffer.to_a).to eq([0, 1, 2, 3, 4, 8, 9, 7, 8, 9])
+    end
+
+    it "converts the range before taking the bytes" do
+      buffer.copy_within(1, shrinking_index(buffer, 3, 0))
+      expect(buffer.to_a).to eq([0, 0, 1])
+    end
+  end
+
+  describe "swaps" do
+    let(:buffer) do
+      ArrayBuffer.new(72).tap do |b|
+        72.times { |idx| b[idx] = idx }
+      end
+    end
+
+    {2 => :swap16!, 4 => :swap32!, 8 => :swap64!}.each do |width, method|
+      it "#{method} reverses every #{width} bytes" do
+        buffer.public_send(method)
+        expect(buffer.to_a).to eq((0...72).each_slice(width).flat_map(&:reverse))
+      end
+    end
+
+    it "swaps a range of a view" do
+      DataView.new(buffer, 1, 9).swap32!(1, 9)
+      expect(buffer.to_a.first(11)).to eq([0, 1, 5, 4, 3, 2, 9, 8, 7, 6, 10])
+    end
+
+    it "turns big endian values into little endian ones" do
+      big = DataView.new(buffer)
+      big.setU32(0, 0xCAFEBABE)
+      buffer.swap32!(0, 4)
+      expect(DataView.new(buffer, endianess: :little).getU32(0)).to eq(0xCAFEBABE)
+    end
+
+    it "is its own inverse" do
+      buffer.swap64!
+      buffer.swap64!
+      expect(buffer.to_a).to eq((0...72).to_a)
+    end
+
+    it "rejects ranges that are not a multiple of the width" do
+      expect { buffer.swap32!(0, 6) }.to raise_error(ArgumentError, /not a multiple of 4/)
+    end
+
+    it "converts the range before taking the bytes" do
+      buffer.swap16!(0, shrinking_index(buffer, 4, 72))
+      expect(buffer.to_a).to eq([1, 0, 3, 2])
+    end
+  end
+end
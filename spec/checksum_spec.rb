@@ -0,0 +1,68 @@
+require "spec_helper"
+require "zlib"
+
+describe "checksums" do
+  let(:data) { "123456789" }
+  let(:buffer) do
+    ArrayBuffer.new(data.bytesize + 2).tap do |b|
+      data.bytes.each_with_index { |v, idx| b[idx + 1] = v }
+    end
+  end
+  let(:view) { DataView.new(buffer, 1, data.bytesize) }
+
+  it "computes CRC-32 like Zlib" do
+    expect(view.crc32).to eq(0xCBF43926)
+    expect(buffer.crc32).to eq(Zlib.crc32(buffer.bytes))
+  end
+
+  it "computes CRC-32C" do
+    expect(view.crc32c).to eq(0xE3069283)
+  end
+
+  it "computes Adler-32 like Zlib" do
+    expect(view.adler32).to eq(Zlib.adler32(data))
+    expect(buffer.adler32).to eq(Zlib.adler32(buffer.bytes))
+  end
+
+  it "computes XXH64" do
+    expect(DataView.new(buffer, 0, 0).xxhash64).to eq(0xEF46DB3751D8E999)
+    expect(buffer_of("abc").xxhash64).to eq(0x44BC2CF5AD770999)
+    expect(buffer_of("Nobody inspects the spammish repetition").xxhash64).to eq(0xFBCEA83C8A378BF1)
+  end
+
+  it "continues a checksum over several parts" do
+    head = DataView.new(buffer, 1, 4)
+    tail = DataView.new(buffer, 5, 5)
+    expect(tail.crc32(head.crc32)).to eq(view.crc32)
+    expect(tail.crc32c(head.crc32c)).to eq(view.crc32c)
+    expect(tail.adler32(head.adler32)).to eq(view.adler32)
+  end
+
+  context "with large buffers" do
+    let(:large) do
+      ArrayBuffer.new(3 * 1024 * 1024 + 13).tap do |b|
+        v = DataView.new(b)
+        (0...b.size).step(4099) { |idx| v.setU8(idx, idx & 0xFF) }
+      end
+    end
+
+    it "matches Zlib" do
+      expect(large.crc32).to eq(Zlib.crc32(large.bytes))
+      expect(large.adler32).to eq(Zlib.adler32(large.bytes))
+    end
+
+    it "computes the same CRC-32C in parts" do
+      head = DataView.new(large, 0, 1_000_003)
+      tail = DataView.new(large, 1_000_003)
+      expect(tail.crc32c(head.crc32c)).to eq(large.crc32c)
+    end
+  end
+
+  private
+
+  def buffer_of(string)
+    ArrayBuffer.new(string.bytesize).tap do |b|
+      string.bytes.each_with_index { |v, idx| b[idx] = v }
+    end
+  end
+end
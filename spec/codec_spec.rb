@@ -0,0 +1,89 @@
+require "spec_helper"
+require "base64"
+
+describe "hex and base64" do
+  let(:bytes) { (0..255).to_a.pack("C*") * 2 + "xyz" }
+  let(:buffer) do
+    ArrayBuffer.new(bytes.bytesize).tap do |buffer|
+      DataView.new(buffer).setBytes(0, bytes)
+    end
+  end
+
+  describe "to_hex and from_hex" do
+    it "encodes lowercase digits" do
+      expect(buffer.to_hex).to eq(bytes.unpack1("H*"))
+      expect(DataView.new(buffer, 254, 3).to_hex).to eq("feff00")
+      expect(buffer.to_hex.encoding).to eq(Encoding::US_ASCII)
+      expect(ArrayBuffer.new(0).to_hex).to eq("")
+    end
+
+    it "decodes either case" do
+      expect(ArrayBuffer.from_hex(buffer.to_hex).bytes).to eq(bytes)
+      expect(ArrayBuffer.from_hex("00aBFf").bytes.bytes).to eq([0, 0xAB, 0xFF])
+    end
+
+    it "raises on invalid digits" do
+      expect { ArrayBuffer.from_hex("abc") }.to raise_error(ArgumentError, /odd number/)
+      expect { ArrayBuffer.from_hex("00g0") }.to raise_error(ArgumentError, /at 2/)
+      expect { ArrayBuffer.from_hex("000 ") }.to raise_error(ArgumentError, /at 3/)
+      long = "0f" * 40
+      long[45] = ":"
+      expect { ArrayBuffer.from_hex(long) }.to raise_error(ArgumentError, /at 45/)
+    end
+
+    it "decodes long runs of digits" do
+      expect(ArrayBuffer.from_hex(buffer.to_hex.upcase).bytes).to eq(bytes)
+      expect { ArrayBuffer.from_hex("Gg" * 20 + "00") }.to raise_error(ArgumentError, /at 0/)
+    end
+  end
+
+  describe "to_base64 and from_base64" do
+    it "matches the Base64 module" do
+      [0, 1, 2, 3, 4, 5, bytes.bytesize].each do |size|
+        view = DataView.new(buffer, 0, size)
+        expected = Base64.strict_encode64(bytes[0, size])
+        expect(view.to_base64).to eq(expected)
+        expect(view.to_base64(urlsafe: true)).to eq(Base64.urlsafe_encode64(bytes[0, size]))
+        expect(view.to_base64(padding: false)).to eq(expected.delete("="))
+        expect(ArrayBuffer.from_base64(expected).bytes).to eq(bytes[0, size])
+      end
+    end
+
+    it "decodes without padding and with the URL-safe alphabet" do
+      expect(ArrayBuffer.from_base64("/+8").bytes.bytes).to eq([0xFF, 0xEF])
+      expect(ArrayBuffer.from_base64("_-8", urlsafe: true).bytes.bytes).to eq([0xFF, 0xEF])
+    end
+
+    it "is strict" do
+      expect { ArrayBuffer.from_base64("QUJD\nA==") }.to raise_error(ArgumentError, /at 4/)
+      expect { ArrayBuffer.from_base64("QU=D") }.to raise_error(ArgumentError, /at 2/)
+      expect { ArrayBuffer.from_base64("QUJDR") }.to raise_error(ArgumentError, /length/)
+      expect { ArrayBuffer.from_base64("QR==") }.to raise_error(ArgumentError, /at 1/)
+      expect { ArrayBuffer.from_base64("_-8") }.to raise_error(ArgumentError, /at 0/)
+      expect { ArrayBuffer.from_base64("QQ=") }.to raise_error(ArgumentError, /at 2/)
+    end
+  end
+
+  describe "setHex and setBase64" do
+    let(:view) { DataView.new(ArrayBuffer.new(8)) }
+
+    it "decodes into a view" do
+      expect(view.setHex(1, "cafe")).to eq(2)
+      expect(view.setBase64(-3, "AQID")).to eq(3)
+      expect(view.to_s.bytes).to eq([0, 0xCA, 0xFE, 0, 0, 1, 2, 3])
+    end
+
+    it "raises when the bytes do not fit" do
+      expect { view.setHex(7, "0000") }.to raise_error(ArgumentError, /2 bytes needed at 7/)
+      expect { view.setBase64(9, "") }.to raise_error(ArgumentError, /out of bounds/)
+    end
+
+    it "converts the index before reading the string" do
+      digits = +"cafe"
+      index = Object.new
+      index.define_singleton_method(:to_int) { digits.replace("ab"); 0 }
+      expect(view.setHex(index, digits)).to eq(1)
+      expect(view.getU8(0)).to eq(0xAB)
+    end
+  end
+end
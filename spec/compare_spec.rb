@@ -0,0 +1,47 @@
+require "spec_helper"
+
+describe "buffer comparison" do
+  def buffer_of(bytes)
+    ArrayBuffer.new(bytes.size).tap do |b|
+      bytes.each_with_index { |v, idx| b[idx] = v }
+    end
+  end
+
+  let(:buffer) { buffer_of([1, 2, 3, 1, 2, 3]) }
+
+  it "compares buffers by content" do
+    expect(buffer == buffer_of([1, 2, 3, 1, 2, 3])).to be(true)
+    expect(buffer == buffer_of([1, 2, 3, 1, 2, 4])).to be(false)
+    expect(buffer == buffer_of([1, 2, 3])).to be(false)
+    expect(buffer == "\x01\x02\x03\x01\x02\x03").to be(false)
+  end
+
+  it "compares views by their window only" do
+    first = DataView.new(buffer, 0, 3)
+    second = DataView.new(buffer, 3, 3, endianess: :little)
+    expect(first == second).to be(true)
+    expect(first == buffer_of([1, 2, 3])).to be(true)
+    expect(first == DataView.new(buffer, 1, 3)).to be(false)
+  end
+
+  it "requires the same class for eql?" do
+    expect(buffer.eql?(buffer_of([1, 2, 3, 1, 2, 3]))).to be(true)
+    expect(DataView.new(buffer, 0, 3).eql?(buffer_of([1, 2, 3]))).to be(false)
+  end
+
+  it "orders lexicographically, then by size" do
+    expect(buffer_of([1, 2]) <=> buffer_of([1, 3])).to eq(-1)
+    expect(buffer_of([2]) <=> buffer_of([1, 3])).to eq(1)
+    expect(buffer_of([1, 2]) <=> buffer_of([1, 2, 0])).to eq(-1)
+    expect(buffer_of([1, 2]) <=> DataView.new(buffer, 0, 2)).to eq(0)
+    expect(buffer <=> 1).to be_nil
+    expect(buffer_of([0xFF]) > buffer_of([1])).to be(true)
+  end
+
+  it "can be used as Hash keys" do
+    cache = { DataView.new(buffer, 0, 3) => :hit }
+    expect(cache[DataView.new(buffer, 3, 3)]).to eq(:hit)
+    expect(cache[DataView.new(buffer, 1, 3)]).to be_nil
+    expect([buffer, buffer_of([1, 2, 3, 1, 2, 3])].uniq.size).to eq(1)
+  end
+end
@@ -0,0 +1,75 @@
+require "spec_helper"
+
+describe ArrayBuffer::Reader do
+  let(:buffer) { ArrayBuffer.new(32) }
+  let(:endianess) { :big }
+  let(:writer) { ArrayBuffer::Writer.new(buffer, endianess: endianess) }
+  let(:reader) { described_class.new(buffer, endianess: endianess) }
+
+  [:big, :little].each do |endian|
+    context "#{endian} endian" do
+      let(:endianess) { endian }
+
+      it "reads back what the writer wrote, advancing the position" do
+        writer.write_u8(200).write_u16(65000).write_u24(70000).write_u32(4_000_000_000)
+        writer.write_i16(-2).write_f64(2.5).write_u64(2**64 - 1)
+        expect(writer.pos).to eq(1 + 2 + 3 + 4 + 2 + 8 + 8)
+
+        expect(reader.read_u8).to eq(200)
+        expect(reader.read_u16).to eq(65000)
+        expect(reader.read_u24).to eq(70000)
+        expect(reader.read_u32).to eq(4_000_000_000)
+        expect(reader.read_i16).to eq(-2)
+        expect(reader.read_f64).to eq(2.5)
+        expect(reader.read_u64).to eq(2**64 - 1)
+        expect(reader.pos).to eq(writer.pos)
+      end
+
+      it "matches the DataView layout" do
+        writer.write_u32(0x01020304)
+        expect(DataView.new(buffer, endianess: endian).getU32(0)).to eq(0x01020304)
+      end
+    end
+  end
+
+  it "uses the endianess of the DataView it wraps" do
+    DataView.new(buffer, endianess: :little).setU16(4, 0x1234)
+    reader = described_class.new(DataView.new(buffer, 4, 2, endianess: :little))
+    expect(reader.read_u16).to eq(0x1234)
+    expect(reader).to be_eof
+  end
+
+  it "reads and writes raw bytes" do
+    writer.skip(2)
+    writer.write_bytes("abc")
+    reader.skip(2)
+    expect(reader.read_bytes(3)).to eq("abc")
+    expect(reader.remaining).to eq(27)
+  end
+
+  it "raises EOFError without moving when reading past the end" do
+    reader.pos = 30
+    expect { reader.read_u32 }.to raise_error(EOFError)
+    expect(reader.pos).to eq(30)
+  end
+
+  it "can seek backwards" do
+    reader.pos = -4
+    expect(reader.pos).to eq(28)
+    reader.skip(-8)
+    expect(reader.pos).to eq(20)
+    expect { reader.skip(-21) }.to raise_error(EOFError)
+  end
+
+  it "refuses to write into a read-only buffer" do
+    file = Tempfile.new("arraybuffer")
+    file.write("abcd")
+    file.flush
+    mapped = ArrayBuffer.mmap(file.path)
+    expect { ArrayBuffer::Writer.new(mapped).write_u8(1) }.to raise_error(FrozenError)
+    expect(described_class.new(mapped).read_u32).to eq(0x61626364)
+  ensure
+    mapped&.close
+    file&.close!
+  end
+end
@@ -210,6 +210,132 @@ describe DataView do
     end
   end
 
+  describe "signed, 64-bit and float operators" do
+    let(:buffer) { ArrayBuffer.new(16) }
+    let(:endianess) { :big }
+    let(:dv) { described_class.new(buffer, 1, 15, endianess: endianess) }
+
+    {
+      I8: [1, -128, 127],
+      I16: [2, -32768, 32767],
+      I24: [3, -8388608, 8388607],
+      I32: [4, -2147483648, 2147483647],
+      I64: [8, -(2**63), 2**63 - 1],
+      U64: [8, 0, 2**64 - 1],
+    }.each do |type, (width, min, max)|
+      [:big, :little].each do |endian|
+        context "#{type} #{endian} endian" do
+          let(:endianess) { endian }
+
+          it "round-trips the extremes" do
+            [min, max, min / 3, max / 5].each do |v|
+              dv.public_send(:"set#{type}", 2, v)
+              expect(dv.public_send(:"get#{type}", 2)).to eq(v)
+            end
+          end
+
+          it "caps values out of range" do
+            dv.public_send(:"set#{type}", 2, max + 1)
+            expect(dv.public_send(:"get#{type}", 2)).to eq(max)
+            dv.public_send(:"set#{type}", 2, min - (2**70))
+            expect(dv.public_send(:"get#{type}", 2)).to eq(min)
+          end
+
+          it "does not touch bytes after the affected area" do
+            dv.public_send(:"set#{type}", 0, -1)
+            expect(buffer[1 + width]).to eq(buffer_data[1 + width])
+          end
+        end
+      end
+    end
+
+    it "lays out signed values in two's complement" do
+      dv.setI16(0, -2)
+      expect([buffer[1], buffer[2]]).to eq([0xFF, 0xFE])
+    end
+
+    it "returns a Fixnum-sized Integer for small U64 values" do
+      dv.setU64(0, 42)
+      expect(dv.getU64(0)).to eq(42)
+    end
+
+    [:big, :little].each do |endian|
+      context "floats #{endian} endian" do
+        let(:endianess) { endian }
+        let(:directive) { endian == :big ? "G" : "E" }
+
+        it "matches String#unpack for F64" do
+          dv.setF64(3, Math::PI)
+          expect(dv.getF64(3)).to eq(Math::PI)
+          expect(buffer.bytes[4, 8].unpack1(directive)).to eq(Math::PI)
+        end
+
+        it "matches String#unpack for F32" do
+          dv.setF32(3, 1.5)
+          expect(dv.getF32(3)).to eq(1.5)
+          expect(buffer.bytes[4, 4].unpack1(directive.downcase)).to eq(1.5)
+        end
+      end
+    end
+
+    it "raises when the value does not fit in the buffer" do
+      expect { dv.getF64(10) }.to raise_error(ArgumentError, /out of underlying buffer bounds/)
+    end
+  end
+
+  describe "bulk operators" do
+    let(:offset) { 1 }
+    let(:length) { 12 }
+    let(:endianess) { :big }
+    let(:dv) { described_class.new(buffer, offset, length, endianess: endianess) }
+
+    shared_examples "a bulk getter" do
+      it "matches the single value getter" do
+        values = dv.public_send(:"#{getter_name}Array", 1, count)
+        expect(values).to eq((0...count).map { |i| dv.public_send(getter_name, 1 + i * width) })
+      end
+
+      it "raises when the range does not fit in the view" do
+        expect { dv.public_send(:"#{getter_name}Array", 1, length / width + 1) }.to raise_error(ArgumentError,
+          /index out of bounds/)
+      end
+    end
+
+    shared_examples "a bulk setter" do
+      it "writes values readable by the single value getter" do
+        dv.public_send(:"#{setter_name}Array", 1, values)
+        expect((0...values.length).map { |i| dv.public_send(getter_name, 1 + i * width) }).to eq(values)
+      end
+
+      it "caps values like the single value setter" do
+        dv.public_send(:"#{setter_name}Array", 0, [-1, 1 << 40])
+        expect(dv.public_send(getter_name, 0)).to eq(0)
+        expect(dv.public_send(getter_name, width)).to eq((1 << (width * 8)) - 1)
+      end
+    end
+
+    [[:getU8, :setU8, 1], [:getU16, :setU16, 2], [:getU24, :setU24, 3], [:getU32, :setU32, 4]].each do |getter, setter, w|
+      [:big, :little].each do |endian|
+        context "#{getter}/#{setter} #{endian} endian" do
+          let(:endianess) { endian }
+          let(:getter_name) { getter }
+          let(:setter_name) { setter }
+          let(:width) { w }
+          let(:count) { (length - 1) / w }
+          let(:values) { (0...count).map { |i| (i * 7919 + 13) % (1 << (w * 8)) } }
+
+          it_behaves_like "a bulk getter"
+          it_behaves_like "a bulk setter"
+        end
+      end
+    end
+
+    it "rejects non fixnum values" do
+      expect { dv.setU16Array(0, [1, "x"]) }.to raise_error(RuntimeError,
+        /array contains non fixnum value at index 1/)
+    end
+  end
+
   describe "setBytes" do
     let(:dv) { described_class.new(buffer, 1) }
     let(:new_bytes) { [40, 0, 13, 25, 250, 127, 128] }
@@ -276,6 +402,27 @@ describe DataView do
       end
     end
 
+    context "when the bytes end exactly at the end of the buffer" do
+      it "sets the bytes" do
+        dv.setBytes(buffer.size - 4, [7, 8, 9])
+        expect(buffer.bytes.bytes.last(3)).to eq([7, 8, 9])
+        dv.setBytes(buffer.size - 3, "\x01\x02")
+        expect(buffer.bytes.bytes.last(2)).to eq([1, 2])
+      end
+
+      it "raises when they go one byte past it" do
+        expect { dv.setBytes(buffer.size - 3, [7, 8, 9]) }.to raise_error(ArgumentError, /out of underlying buffer bounds/)
+      end
+    end
+
+    context "when source and target overlap" do
+      it "copies as if through a temporary buffer" do
+        source = DataView.new(buffer, 0, 8)
+        DataView.new(buffer, 2).setBytes(0, source)
+        expect(buffer.bytes.bytes).to eq(buffer_data.first(2) + buffer_data.first(8) + buffer_data.last(4))
+      end
+    end
+
     context "when argument is an utf-8 string" do
       let(:expected_bytes) { [1, 233, 139, 184, 105, 27, 175, 88, 99, 192, 32, 12, 0, 49] }
 
@@ -286,6 +433,33 @@ describe DataView do
     end
   end
 
+  describe "large buffers" do
+    let(:big_size) { (1 << 32) + 4096 }
+    let(:file) { Tempfile.new("arraybuffer").tap { |f| f.truncate(big_size) } }
+    let(:big_buffer) { ArrayBuffer.mmap(file.path, :rw) }
+
+    after do
+      big_buffer.close
+      file.close!
+    end
+
+    it "addresses offsets beyond 4 GiB" do
+      dv = DataView.new(big_buffer, (1 << 32) + 8)
+      dv.setU32(0, 0xDEADBEEF)
+      expect(big_buffer.size).to eq(big_size)
+      expect(dv.offset).to eq((1 << 32) + 8)
+      expect(DataView.new(big_buffer).getU32((1 << 32) + 8)).to eq(0xDEADBEEF)
+      expect(dv.getU16Array(0, 2)).to eq([0xDEAD, 0xBEEF])
+    end
+  end
+
+  describe "to_s" do
+    it "only includes bytes within the underlying buffer" do
+      dv = described_class.new(buffer, 10, 100)
+      expect(dv.to_s.bytes).to eq(buffer_data[10..])
+    end
+  end
+
   shared_examples "offset out of bounds" do
     context "when offset is greater than the underlying buffer" do
       let(:offset) { 1000 }
@@ -0,0 +1,209 @@
+require "spec_helper"
+require "socket"
+require "tempfile"
+
+# Runs non-blocking fibers, resuming them once IO.select finds their IO ready
+class TestScheduler
+  attr_reader :waits
+
+  def initialize
+    @readable = {}
+    @writable = {}
+    @ready = []
+    @waits = 0
+  end
+
+  def fiber(&block)
+    Fiber.new(blocking: false, &block).tap(&:resume)
+  end
+
+  def io_wait(io, events, _timeout)
+    @waits += 1
+    @readable[io] = Fiber.current if events & IO::READABLE != 0
+    @writable[io] = Fiber.current if events & IO::WRITABLE != 0
+    Fiber.yield
+  end
+
+  def kernel_sleep(_duration = nil)
+    @ready << Fiber.current
+    Fiber.yield
+  end
+
+  def block(_blocker, _timeout = nil)
+    kernel_sleep
+  end
+
+  def unblock(_blocker, fiber)
+    @ready << fiber
+  end
+
+  def close
+    until @readable.empty? && @writable.empty? && @ready.empty?
+      @ready.shift.resume until @ready.empty?
+      next if @readable.empty? && @writable.empty?
+
+      readable, writable = IO.select(@readable.keys, @writable.keys)
+      readable.each { |io| @readable.delete(io).resume(IO::READABLE) }
+      writable.each { |io| @writable.delete(io).resume(IO::WRITABLE) }
+    end
+  end
+end
+
+describe "IO" do
+  let(:pipe) { IO.pipe }
+  let(:reader) { pipe[0] }
+  let(:writer) { pipe[1] }
+  let(:buffer) { ArrayBuffer.new(8) }
+
+  after { pipe.each(&:close) }
+
+  describe "read_from" do
+    it "reads into the buffer at an offset" do
+      writer.write("hello")
+      expect(buffer.read_from(reader, 2)).to eq(5)
+      expect(buffer.bytes).to eq("\x00\x00hello\x00".b)
+    end
+
+    it "reads at most length bytes" do
+      writer.write("hello")
+      expect(buffer.read_from(reader, 0, 2)).to eq(2)
+      expect(reader.readpartial(10)).to eq("llo")
+    end
+
+    it "reads into a DataView" do
+      writer.write("hello")
+      view = DataView.new(buffer, 6)
+      expect(view.read_from(reader)).to eq(2)
+      expect(buffer.bytes[6, 2]).to eq("he")
+    end
+
+    it "returns nil at end of file" do
+      writer.close
+      expect(buffer.read_from(reader)).to be_nil
+    end
+
+    it "consumes data buffered by Ruby first" do
+      writer.write("abc")
+      expect(reader.getc).to eq("a")
+      expect(buffer.read_from(reader)).to eq(2)
+      expect(buffer.bytes[0, 2]).to eq("bc")
+    end
+
+    it "waits for data without blocking other threads" do
+      thread = Thread.new { buffer.read_from(reader) }
+      sleep 0.05
+      expect { buffer.realloc(16) }.to raise_error(RuntimeError, /in use/)
+      writer.write("x")
+      expect(thread.value).to eq(1)
+    end
+
+    it "reads from a position of a file" do
+      Tempfile.create("arraybuffer") do |file|
+        file.write("0123456789")
+        file.flush
+        expect(buffer.read_from(file, 0, 4, pos: 3)).to eq(4)
+        expect(buffer.bytes[0, 4]).to eq("3456")
+      end
+    end
+
+    it "validates the range" do
+      expect { buffer.read_from(reader, 9) }.to raise_error(ArgumentError)
+      expect { buffer.read_from(reader, 4, 5) }.to raise_error(ArgumentError)
+    end
+
+    it "converts the range before taking the bytes" do
+      writer.write("hello")
+      expect { buffer.read_from(reader, shrinking_index(buffer, 1, 4)) }.to raise_error(ArgumentError, /offset/)
+      expect { buffer.read_from(reader, 0, shrinking_index(buffer, 1, 4)) }.to raise_error(ArgumentError, /length/)
+      expect { buffer.write_to(writer, 0, shrinking_index(buffer, 1, 4)) }.to raise_error(ArgumentError, /length/)
+    end
+  end
+
+  describe "write_to" do
+    it "writes the bytes of a range" do
+      buffer.fill(0x41)
+      expect(buffer.write_to(writer, 6)).to eq(2)
+      expect(DataView.new(buffer, 0, 3).write_to(writer)).to eq(3)
+      expect(reader.readpartial(10)).to eq("AAAAA")
+    end
+
+    it "writes everything to a non-blocking socket" do
+      a, b = UNIXSocket.pair
+      big = ArrayBuffer.new(1_000_000).fill(7)
+      thread = Thread.new { big.write_to(a) }
+      received = ArrayBuffer.new(1_000_000)
+      done = 0
+      done += received.read_from(b, done) while done < received.size
+      expect(thread.value).to eq(1_000_000)
+      expect(received).to eq(big)
+    ensure
+      a&.close
+      b&.close
+    end
+
+    it "flushes data buffered by Ruby first" do
+      writer.sync = false
+      writer.write("a")
+      DataView.new(buffer, 0, 1).write_to(writer)
+      expect(reader.readpartial(10)).to eq("a\x00".b)
+    end
+  end
+
+  describe "under a fiber scheduler" do
+    # Runs the block in a thread of its own, so the scheduler can't leak
+    def with_scheduler
+      Thread.new do
+        scheduler = TestScheduler.new
+        Fiber.set_scheduler(scheduler)
+        yield
+        Fiber.set_scheduler(nil)
+        scheduler
+      end.value
+    end
+
+    it "waits for data in read_from while a writer fiber runs" do
+      read = nil
+      scheduler = with_scheduler do
+        Fiber.schedule { read = buffer.read_from(reader) }
+        Fiber.schedule { writer.write("hi") }
+      end
+      expect(read).to eq(2)
+      expect(buffer.bytes[0, 2]).to eq("hi")
+      expect(scheduler.waits).to be_positive
+    end
+
+    it "interleaves write_to with a reading fiber" do
+      big = ArrayBuffer.new(1_000_000).fill(7)
+      received = ArrayBuffer.new(1_000_000)
+      written = nil
+      scheduler = with_scheduler do
+        Fiber.schedule { written = big.write_to(writer) }
+        Fiber.schedule do
+          done = 0
+          done += received.read_from(reader, done) while done < received.size
+        end
+      end
+      expect(written).to eq(1_000_000)
+      expect(received).to eq(big)
+      expect(scheduler.waits).to be > 1
+    end
+  end
+
+  describe "DataView.writev and readv" do
+    it "gathers and scatters views" do
+      header = ArrayBuffer.new(2).fill(1)
+      body = DataView.new(ArrayBuffer.new(3).fill(2))
+      expect(DataView.writev(writer, [header, body])).to eq(5)
+
+      first = ArrayBuffer.new(1)
+      rest = DataView.new(buffer, 4)
+      expect(DataView.readv(reader, [first, rest])).to eq(5)
+      expect(first.to_a).to eq([1])
+      expect(buffer.to_a).to eq([0, 0, 0, 0, 1, 2, 2, 2])
+    end
+
+    it "rejects other objects" do
+      expect { DataView.writev(writer, ["abc"]) }.to raise_error(TypeError)
+    end
+  end
+end
@@ -0,0 +1,105 @@
+require "spec_helper"
+
+describe "packed integers" do
+  def u32_view(values, endianess: :big)
+    view = DataView.new(ArrayBuffer.new(values.size * 4), endianess: endianess)
+    values.each_with_index { |value, idx| view.setU32(idx * 4, value) }
+    view
+  end
+
+  def u32_values(view)
+    (view.size / 4).times.map { |idx| view.getU32(idx * 4) }
+  end
+
+  def u64_values(view)
+    (view.size / 8).times.map { |idx| view.getU64(idx * 8) }
+  end
+
+  describe "encode_u32 and decode_u32" do
+    it "round-trips blocks of any size" do
+      [0, 1, 127, 128, 129, 300].each do |count|
+        values = count.times.map { |idx| (idx * 2654435761) % 2**32 }
+        packed = u32_view(values).encode_u32
+        expect(u32_values(DataView.new(packed.decode_u32))).to eq(values)
+      end
+    end
+
+    it "shrinks sorted ids with delta encoding" do
+      values = 1000.times.map { |idx| 1_000_000 + idx * 3 + idx % 2 }
+      view = u32_view(values)
+      packed = view.encode_u32(delta: true)
+      expect(packed.size).to be < view.size / 8
+      expect(packed.size).to be < view.encode_u32.size
+      expect(u32_values(DataView.new(packed.decode_u32))).to eq(values)
+    end
+
+    it "packs constant blocks without payload" do
+      packed = u32_view([7] * 256).encode_u32
+      expect(packed.size).to eq(17 + 2 * 5)
+    end
+
+    it "round-trips unsorted values with delta encoding" do
+      values = [5, 2**32 - 1, 0, 3, 2**31, 1]
+      packed = u32_view(values).encode_u32(delta: true)
+      expect(u32_values(DataView.new(packed.decode_u32))).to eq(values)
+    end
+
+    it "encodes a range with the given endianess" do
+      view = u32_view([9, 1, 2, 3, 9], endianess: :little)
+      packed = view.encode_u32(4, 3)
+      expect(u32_values(DataView.new(packed.decode_u32))).to eq([1, 2, 3])
+      packed = view.encode_u32(4, 1, endianess: :big)
+      expect(DataView.new(packed.decode_u32).getU32(0)).to eq(2**24)
+    end
+
+    it "decodes into a target at an index" do
+      packed = u32_view([1, 2, 3]).encode_u32
+      target = DataView.new(ArrayBuffer.new(16), endianess: :little)
+      expect(packed.decode_u32(target, 4)).to be(target)
+      expect(u32_values(target)).to eq([0, 1, 2, 3])
+      expect { packed.decode_u32(target, 8) }.to raise_error(ArgumentError, /12 bytes needed/)
+    end
+
+    it "raises on out of bounds ranges" do
+      view = u32_view([1, 2])
+      expect { view.encode_u32(12) }.to raise_error(ArgumentError, /index/)
+      expect { view.encode_u32(4, 2) }.to raise_error(ArgumentError, /count/)
+    end
+
+    it "raises on malformed input" do
+      expect { ArrayBuffer.new(4).decode_u32 }.to raise_error(ArgumentError, /too short/)
+      packed = u32_view((0..200).to_a).encode_u32
+      expect { packed.decode_u64 }.to raise_error(ArgumentError, /4 bytes long/)
+      truncated = DataView.new(packed, 0, packed.size - 1)
+      expect { truncated.decode_u32 }.to raise_error(ArgumentError, /malformed/)
+    end
+  end
+
+  describe "encode_u64 and decode_u64" do
+    it "round-trips the whole 64 bits range" do
+      values = [0, 2**64 - 1, 1, 2**63, 2**57 + 3, 42] * 50
+      view = DataView.new(ArrayBuffer.new(values.size * 8))
+      values.each_with_index { |value, idx| view.setU64(idx * 8, value) }
+      [false, true].each do |delta|
+        packed = view.encode_u64(delta: delta)
+        expect(u64_values(DataView.new(packed.decode_u64))).to eq(values)
+      end
+    end
+
+    it "round-trips widths spilling over 8 bytes" do
+      values = 200.times.map { |idx| (idx * 0x9E3779B97F4A7C15) % 2**61 }
+      view = DataView.new(ArrayBuffer.new(values.size * 8))
+      values.each_with_index { |value, idx| view.setU64(idx * 8, value) }
+      expect(u64_values(DataView.new(view.encode_u64.decode_u64))).to eq(values)
+    end
+
+    it "shrinks timestamps with delta encoding" do
+      values = 512.times.map { |idx| 1_700_000_000_000 + idx * 1000 }
+      view = DataView.new(ArrayBuffer.new(values.size * 8))
+      values.each_with_index { |value, idx| view.setU64(idx * 8, value) }
+      packed = view.encode_u64(delta: true)
+      expect(packed.size).to be < view.size / 4
+      expect(u64_values(DataView.new(packed.decode_u64))).to eq(values)
+    end
+  end
+end
@@ -0,0 +1,70 @@
+require "spec_helper"
+
+describe ArrayBuffer::Pool do
+  let(:pool) { described_class.new(size_classes: [1024, 64], max_per_class: 2) }
+
+  it "sorts the size classes" do
+    expect(pool.size_classes).to eq([64, 1024])
+  end
+
+  it "hands out zeroed buffers of the requested size" do
+    buffer = pool.acquire(10)
+    expect(buffer.size).to eq(10)
+    expect(buffer.to_a).to eq([0] * 10)
+  end
+
+  it "recycles released buffers" do
+    buffer = pool.acquire(50)
+    buffer[3] = 42
+    pool.release(buffer)
+    expect(buffer.size).to eq(0)
+
+    again = pool.acquire(60)
+    expect(again).to be(buffer)
+    expect(again.size).to eq(60)
+    expect(again.to_a).to eq([0] * 60)
+    expect(pool.stats).to eq(hits: 1, misses: 1, releases: 1, discards: 0, pooled: 0)
+  end
+
+  it "serves requests from the smallest class that fits" do
+    pool.release(pool.acquire(100))
+    expect(pool.acquire(10)).to be_a(ArrayBuffer)
+    expect(pool.stats[:hits]).to eq(0)
+    expect(pool.acquire(500).capacity >= 1024).to be(true)
+    expect(pool.stats[:hits]).to eq(1)
+  end
+
+  it "serves requests larger than the largest class with new buffers" do
+    buffer = pool.acquire(4096)
+    expect(buffer.size).to eq(4096)
+    pool.release(buffer)
+    expect(pool.stats).to include(misses: 1, discards: 0, pooled: 1)
+  end
+
+  it "discards buffers when the class is full" do
+    buffers = 3.times.map { pool.acquire(8) }
+    buffers.each { |b| pool.release(b) }
+    expect(pool.stats).to include(discards: 1, pooled: 2)
+  end
+
+  it "rejects double releases" do
+    buffer = pool.acquire(8)
+    pool.release(buffer)
+    expect { pool.release(buffer) }.to raise_error(ArgumentError, /already released/)
+  end
+
+  it "keeps released buffers from being resized" do
+    buffer = pool.acquire(60)
+    pool.release(buffer)
+    expect { buffer.shrink_to_fit }.to raise_error(RuntimeError, /released to a pool/)
+    expect { buffer.realloc(8) }.to raise_error(RuntimeError, /released to a pool/)
+    expect(pool.acquire(60).size).to eq(60)
+  end
+
+  it "releases the buffer at block exit" do
+    result = pool.with(16) { |buffer| buffer.size }
+    expect(result).to eq(16)
+    expect { pool.with(16) { raise "boom" } }.to raise_error(RuntimeError, "boom")
+    expect(pool.stats).to include(releases: 2, pooled: 1)
+  end
+end
@@ -0,0 +1,141 @@
+require "spec_helper"
+
+describe "reductions" do
+  let(:buffer) { ArrayBuffer.new(16) }
+  let(:view) { DataView.new(buffer, endianess: :little) }
+
+  before do
+    [1, 200, 3, 0, 255, 3, 3, 7].each_with_index { |value, idx| buffer[idx] = value }
+  end
+
+  describe "sum" do
+    it "sums bytes by default" do
+      expect(view.sum).to eq(472)
+      expect(buffer.sum).to eq(472)
+    end
+
+    it "sums values of a type" do
+      view.setU32(8, 2**32 - 1)
+      view.setU32(12, 2**32 - 1)
+      expect(view.sum(:u32)).to eq(view.getU32(0) + view.getU32(4) + 2 * (2**32 - 1))
+      big = DataView.new(buffer)
+      expect(view.sum(:u16, endianess: :big)).to eq((0...16).step(2).sum { |idx| big.getU16(idx) })
+    end
+
+    it "sums signed and 64 bits values exactly" do
+      view.setI16(0, -300)
+      expect(view.sum(:i16)).to eq((0...16).step(2).sum { |idx| view.getI16(idx) })
+      view.setU64(0, 2**64 - 1)
+      view.setU64(8, 2**64 - 1)
+      expect(view.sum(:u64)).to eq(2 * (2**64 - 1))
+      expect(view.sum(:i64)).to eq(-2)
+      view.setI64(0, -2**63)
+      view.setI64(8, -2**63)
+      expect(view.sum(:i64)).to eq(-2**64)
+    end
+
+    it "sums floats" do
+      view.setF64(0, 1.5)
+      view.setF64(8, -0.25)
+      expect(view.sum(:f64)).to eq(1.25)
+    end
+
+    it "falls back to Enumerable" do
+      expect(view.sum(0.0)).to eq(472.0)
+      expect(view.sum { |byte| byte * 2 }).to eq(944)
+    end
+
+    it "ignores trailing bytes" do
+      expect(DataView.new(buffer, 0, 3).sum(:u16)).to eq(buffer[0] * 256 + buffer[1])
+    end
+  end
+
+  describe "min and max" do
+    it "finds extremes of a type" do
+      expect(view.min).to eq(0)
+      expect(view.max).to eq(255)
+      view.setI32(0, -5)
+      expect(view.min(:i32)).to eq(-5)
+      expect(view.max(:u32)).to eq(2**32 - 5)
+      view.setU64(8, 2**64 - 1)
+      expect(view.max(:u64)).to eq(2**64 - 1)
+      expect(view.min(:i64)).to eq(-1)
+    end
+
+    it "skips NaN floats" do
+      view.setF32(0, Float::NAN)
+      view.setF32(4, 2.5)
+      view.setF32(8, -1.5)
+      view.setF32(12, 0.0)
+      expect(view.min(:f32)).to eq(-1.5)
+      expect(view.max(:f32)).to eq(2.5)
+    end
+
+    it "returns nil without values" do
+      empty = DataView.new(buffer, 0, 3)
+      expect(empty.min(:u32)).to be_nil
+      expect(empty.max(:f64)).to be_nil
+    end
+
+    it "falls back to Enumerable" do
+      expect(view.min(2)).to eq([0, 0])
+      expect(view.max { |a, b| (a % 100) <=> (b % 100) }).to eq(255)
+    end
+  end
+
+  describe "count" do
+    it "counts equal values" do
+      expect(view.count(3)).to eq(3)
+      view.setU16(8, 513)
+      expect(view.count(513, :u16)).to eq(1)
+      expect(view.count(513, :u16, endianess: :big)).to eq(0)
+    end
+
+    it "counts signed values and floats" do
+      view.setI16(0, -1)
+      view.setI16(2, -1)
+      expect(view.count(-1, :i16)).to eq(2)
+      view.setF64(8, 0.5)
+      expect(view.count(0.5, :f64)).to eq(1)
+    end
+
+    it "matches other numbers equal to an integer like Enumerable" do
+      expect(view.count(3.0)).to eq(view.to_a.count(3.0))
+      expect(view.count(3r)).to eq(3)
+      expect(view.count(-1.0, :i16)).to eq(0)
+    end
+
+    it "converts the value before taking the bytes" do
+      large = ArrayBuffer.new(1024 * 1024)
+      zero = Class.new(Numeric) do
+        define_method(:to_int) { large.realloc(1); 0 }
+        define_method(:==) { |other| other == 0 }
+      end.new
+      expect(large.count(zero)).to eq(1)
+    end
+
+    it "never matches values out of the range of the type" do
+      expect(view.count(256)).to eq(0)
+      expect(view.count(-1, :u32)).to eq(0)
+      expect(view.count(1.5, :u8)).to eq(0)
+      expect(view.count(Float::NAN)).to eq(0)
+    end
+
+    it "falls back to Enumerable" do
+      expect(view.count).to eq(16)
+      expect(view.count { |byte| byte > 100 }).to eq(2)
+      expect(view.count("a")).to eq(0)
+    end
+  end
+
+  describe "histogram" do
+    it "counts every byte value" do
+      histogram = view.histogram
+      expect(histogram.size).to eq(256)
+      expect(histogram[3]).to eq(3)
+      expect(histogram[0]).to eq(9)
+      expect(histogram.sum).to eq(16)
+      expect(DataView.new(buffer, 1, 0).histogram.sum).to eq(0)
+    end
+  end
+end
@@ -0,0 +1,85 @@
+require "spec_helper"
+
+describe DataView::Schema do
+  let(:fields) { [[:id, :u32], [:kind, :u16], [:flags, :u8], [:ts, :f64], [:delta, :i16]] }
+  let(:schema) { described_class.new(fields) }
+  let(:buffer) { ArrayBuffer.new(64) }
+  let(:endianess) { :big }
+  let(:dv) { DataView.new(buffer, 2, endianess: endianess) }
+
+  def write_record(offset, id, kind, flags, ts, delta)
+    dv.setU32(offset, id)
+    dv.setU16(offset + 4, kind)
+    dv.setU8(offset + 6, flags)
+    dv.setF64(offset + 7, ts)
+    dv.setI16(offset + 15, delta)
+  end
+
+  it "computes the record size" do
+    expect(schema.size).to eq(17)
+  end
+
+  it "exposes the compiled layout" do
+    expect(schema.fields.first(2)).to eq([[:id, :u32, 0], [:kind, :u16, 4]])
+  end
+
+  [:big, :little].each do |endian|
+    context "with a #{endian} endian view" do
+      let(:endianess) { endian }
+
+      before { write_record(3, 70000, 513, 7, 1.25, -300) }
+
+      it "reads a record as a Hash" do
+        expect(schema.read(dv, 3)).to eq(id: 70000, kind: 513, flags: 7, ts: 1.25, delta: -300)
+      end
+
+      it "round-trips a written record" do
+        schema.write(dv, 20, { id: 1, kind: 2, flags: 3, ts: -0.5, delta: 4 })
+        expect(schema.read(dv, 20)).to eq(id: 1, kind: 2, flags: 3, ts: -0.5, delta: 4)
+      end
+    end
+  end
+
+  it "reads a record as an Array" do
+    write_record(0, 1, 2, 3, 4.0, -5)
+    expect(described_class.new(fields, as: :array).read(dv)).to eq([1, 2, 3, 4.0, -5])
+  end
+
+  it "reads a record into a Struct" do
+    klass = Struct.new(:id, :kind, :flags, :ts, :delta)
+    write_record(0, 1, 2, 3, 4.0, -5)
+    record = described_class.new(fields, as: klass).read(dv)
+    expect(record).to eq(klass.new(1, 2, 3, 4.0, -5))
+    schema.write(dv, 17, record)
+    expect(schema.read(dv, 17)).to eq(record.to_h)
+  end
+
+  it "rejects classes other than Struct classes" do
+    expect { described_class.new(fields, as: String) }.to raise_error(ArgumentError, /Struct class/)
+    expect { described_class.new(fields, as: Struct) }.to raise_error(ArgumentError, /Struct class/)
+  end
+
+  it "reads many consecutive records" do
+    write_record(0, 1, 2, 3, 4.0, -5)
+    write_record(17, 6, 7, 8, 9.0, -10)
+    records = described_class.new(fields, as: :array).read_many(dv, 0, 2)
+    expect(records).to eq([[1, 2, 3, 4.0, -5], [6, 7, 8, 9.0, -10]])
+  end
+
+  it "caps integer values like the DataView setters" do
+    schema.write(dv, 0, [-1, 1 << 20, 300, 0, 1 << 40])
+    expect(schema.read(dv, 0)).to eq(id: 0, kind: 0xFFFF, flags: 0xFF, ts: 0.0, delta: 0x7FFF)
+  end
+
+  it "raises when the records do not fit in the view" do
+    expect { schema.read_many(dv, 0, 4) }.to raise_error(ArgumentError, /do not fit/)
+  end
+
+  it "raises when a field is missing from a Hash record" do
+    expect { schema.write(dv, 0, { id: 1 }) }.to raise_error(KeyError, /kind/)
+  end
+
+  it "rejects unknown field types" do
+    expect { described_class.new([[:a, :u128]]) }.to raise_error(ArgumentError, /unknown field type/)
+  end
+end
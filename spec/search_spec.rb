@@ -0,0 +1,152 @@
+require "spec_helper"
+
+describe "byte search" do
+  let(:buffer) do
+    ArrayBuffer.new(13).tap do |b|
+      "GET /\r\nab\r\n\0x".bytes.each_with_index { |v, idx| b[idx] = v }
+    end
+  end
+
+  shared_examples "searchable" do
+    it "finds the first occurrence of a byte" do
+      expect(subject.indexOf(13)).to eq(first_cr)
+      expect(subject.indexOf(13, first_cr + 1)).to eq(second_cr)
+    end
+
+    it "returns nil when the byte is not found" do
+      expect(subject.indexOf(0xFF)).to be_nil
+      expect(subject.indexOf(13, second_cr + 1)).to be_nil
+      expect(subject.indexOf(256)).to be_nil
+    end
+
+    it "finds the last occurrence of a byte" do
+      expect(subject.lastIndexOf(13)).to eq(second_cr)
+      expect(subject.lastIndexOf(13, second_cr - 1)).to eq(first_cr)
+      expect(subject.lastIndexOf(13, first_cr - 1)).to be_nil
+    end
+
+    it "accepts negative start positions" do
+      expect(subject.indexOf(13, -(subject.size - first_cr))).to eq(first_cr)
+      expect(subject.lastIndexOf(13, -1)).to eq(second_cr)
+    end
+
+    it "finds byte sequences" do
+      expect(subject.indexOfSequence("\r\n")).to eq(first_cr)
+      expect(subject.indexOfSequence("\r\n", first_cr + 1)).to eq(second_cr)
+      expect(subject.indexOfSequence("\r\n", second_cr + 1)).to be_nil
+      expect(subject.indexOfSequence("")).to eq(0)
+    end
+
+    it "finds sequences given as buffers and views" do
+      needle = ArrayBuffer.new(2)
+      needle[0] = 13
+      needle[1] = 10
+      expect(subject.indexOfSequence(needle)).to eq(first_cr)
+      expect(subject.indexOfSequence(DataView.new(needle, 1, 1))).to eq(first_cr + 1)
+    end
+  end
+
+  context "on an ArrayBuffer" do
+    subject { buffer }
+    let(:first_cr) { 5 }
+    let(:second_cr) { 9 }
+
+    include_examples "searchable"
+  end
+
+  context "on a DataView" do
+    subject { DataView.new(buffer, 2, 9) }
+    let(:first_cr) { 3 }
+    let(:second_cr) { 7 }
+
+    include_examples "searchable"
+
+    it "does not search past the end of the view" do
+      expect(subject.indexOf(0)).to be_nil
+      expect(subject.indexOfSequence("\r\n\0")).to be_nil
+    end
+  end
+
+  it "searches large buffers" do
+    large = ArrayBuffer.new(4 * 1024 * 1024)
+    large[3 * 1024 * 1024] = 7
+    expect(large.indexOf(7)).to eq(3 * 1024 * 1024)
+    expect(large.lastIndexOf(0, 3 * 1024 * 1024)).to eq(3 * 1024 * 1024 - 1)
+    expect(large.indexOfSequence("\0\7")).to eq(3 * 1024 * 1024 - 1)
+  end
+
+  it "converts the start position before taking the bytes" do
+    large = ArrayBuffer.new(1024 * 1024)
+    expect(large.indexOf(0, shrinking_index(large, 1, 14))).to be_nil
+    expect(large.lastIndexOf(0, shrinking_index(large, 2, 14))).to eq(1)
+    expect(large.indexOfSequence("\0", shrinking_index(large, 3, 14))).to be_nil
+  end
+end
+
+describe DataView do
+  let(:buffer) do
+    ArrayBuffer.new(14).tap do |b|
+      "ab\r\ncd\r\n\r\nef\r\n".bytes.each_with_index { |v, idx| b[idx] = v }
+    end
+  end
+  let(:view) { described_class.new(buffer, 0, nil, endianess: :little) }
+
+  describe "split" do
+    it "splits into views sharing the buffer" do
+      pieces = view.split("\r\n")
+      expect(pieces.map(&:to_s)).to eq(["ab", "cd", "", "ef", ""])
+      expect(pieces.map(&:offset)).to eq([0, 4, 8, 10, 14])
+      expect(pieces.map(&:endianess).uniq).to eq([:little])
+
+      pieces[1].setU8(0, 0x43)
+      expect(buffer[4]).to eq(0x43)
+    end
+
+    it "splits by a single byte" do
+      expect(view.split(10).map(&:to_s)).to eq(["ab\r", "cd\r", "\r", "ef\r", ""])
+    end
+
+    it "splits within the bounds of the view" do
+      sub = described_class.new(buffer, 4, 6)
+      expect(sub.split("\r\n").map(&:to_s)).to eq(["cd", "", ""])
+    end
+
+    it "yields one reused view" do
+      seen = []
+      objects = []
+      result = view.split("\r\n") do |piece|
+        seen << piece.to_s
+        objects << piece.object_id
+      end
+      expect(result).to be(view)
+      expect(seen).to eq(["ab", "cd", "", "ef", ""])
+      expect(objects.uniq.size).to eq(1)
+    end
+
+    it "rejects empty delimiters" do
+      expect { view.split("") }.to raise_error(ArgumentError, /must not be empty/)
+    end
+  end
+
+  describe "each_slice_view" do
+    it "yields consecutive slices" do
+      slices = []
+      view.each_slice_view(4) { |slice| slices << [slice.offset, slice.to_s] }
+      expect(slices).to eq([[0, "ab\r\n"], [4, "cd\r\n"], [8, "\r\nef"], [12, "\r\n"]])
+    end
+
+    it "returns a sized enumerator without a block" do
+      expect(view.each_slice_view(4).size).to eq(4)
+    end
+
+    it "can keep a slice with dup" do
+      kept = []
+      view.each_slice_view(5) { |slice| kept << slice.dup }
+      expect(kept.map(&:to_s)).to eq(["ab\r\nc", "d\r\n\r\n", "ef\r\n"])
+    end
+
+    it "rejects non-positive lengths" do
+      expect { view.each_slice_view(0) { } }.to raise_error(ArgumentError, /greater than zero/)
+    end
+  end
+end
@@ -1 +1,10 @@
 require "arraybuffer"
+require "tempfile"
+
+# Returns an index converting to +value+, whose #to_int resizes +buffer+ to
+# +size+ bytes first
+def shrinking_index(buffer, size, value)
+  Object.new.tap do |index|
+    index.define_singleton_method(:to_int) { buffer.realloc(size); value }
+  end
+end
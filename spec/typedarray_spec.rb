@@ -0,0 +1,128 @@
+require "spec_helper"
+
+describe TypedArray do
+  it "can't be instantiated directly" do
+    expect { TypedArray.new(1) }.to raise_error(TypeError)
+  end
+
+  it "has the element sizes" do
+    expect(Int8Array::BYTES_PER_ELEMENT).to eq(1)
+    expect(Uint16Array::BYTES_PER_ELEMENT).to eq(2)
+    expect(Float32Array::BYTES_PER_ELEMENT).to eq(4)
+    expect(Int64Array::BYTES_PER_ELEMENT).to eq(8)
+  end
+
+  describe "initialize" do
+    it "allocates zeroed elements" do
+      a = Uint32Array.new(3)
+      expect(a.length).to eq(3)
+      expect(a.byte_length).to eq(12)
+      expect(a.to_a).to eq([0, 0, 0])
+    end
+
+    it "copies values from an Array" do
+      a = Float64Array.new([1.5, -2.0])
+      expect(a.to_a).to eq([1.5, -2.0])
+    end
+
+    it "views an ArrayBuffer without copying" do
+      buffer = ArrayBuffer.new(10)
+      a = Uint16Array.new(buffer, 2, 3, endianess: :big)
+      a[0] = 0x0102
+      expect(buffer[2]).to eq(1)
+      expect(buffer[3]).to eq(2)
+      expect(a.byte_offset).to eq(2)
+      expect(a.length).to eq(3)
+      expect(a.buffer).to be(buffer)
+    end
+
+    it "uses the rest of the buffer by default" do
+      a = Uint32Array.new(ArrayBuffer.new(10), 2)
+      expect(a.length).to eq(2)
+    end
+
+    it "validates offset and length" do
+      buffer = ArrayBuffer.new(8)
+      expect { Uint16Array.new(buffer, 9) }.to raise_error(ArgumentError)
+      expect { Uint16Array.new(buffer, 0, 5) }.to raise_error(ArgumentError)
+      expect { Uint16Array.new(-1) }.to raise_error(ArgumentError)
+    end
+  end
+
+  describe "[] and []=" do
+    it "supports negative indices" do
+      a = Int32Array.new([1, 2, 3])
+      a[-1] = -7
+      expect(a[2]).to eq(-7)
+      expect(a[-3]).to eq(1)
+    end
+
+    it "caps values" do
+      a = Int16Array.new([-1, 70000, -70000])
+      expect(a.to_a).to eq([-1, 32767, -32768])
+      a = Uint8Array.new([300, -1])
+      expect(a.to_a).to eq([255, 0])
+    end
+
+    it "raises when out of bounds" do
+      a = Uint8Array.new(2)
+      expect { a[2] }.to raise_error(ArgumentError)
+      expect { a[-3] = 1 }.to raise_error(ArgumentError)
+    end
+
+    it "converts the index before looking up the element" do
+      buffer = ArrayBuffer.new(1024 * 1024)
+      a = Uint8Array.new(buffer)
+      expect { a[shrinking_index(buffer, 1, 500_000)] }.to raise_error(ArgumentError, /out of bounds/)
+      expect { a[shrinking_index(buffer, 1, 500_000)] = 1 }.to raise_error(ArgumentError, /out of bounds/)
+    end
+  end
+
+  it "iterates over the elements" do
+    a = Uint64Array.new([1, 2**64 - 1])
+    values = []
+    a.each { |v| values << v }
+    expect(values).to eq([1, 2**64 - 1])
+    expect(a.each.size).to eq(2)
+    expect(a.map { |v| v > 1 }).to eq([false, true])
+  end
+
+  it "duplicates as an array of the same buffer" do
+    a = Int8Array.new([1, 2])
+    b = a.dup
+    b[0] = 9
+    expect(a[0]).to eq(9)
+    expect(b.buffer).to be(a.buffer)
+  end
+
+  describe "MemoryView" do
+    before do
+      begin
+        require "fiddle"
+      rescue LoadError
+        skip "fiddle is not available"
+      end
+      skip "fiddle has no MemoryView" unless defined?(Fiddle::MemoryView)
+    end
+
+    it "exports elements with their format" do
+      view = Fiddle::MemoryView.new(Uint32Array.new([1, 2, 3]))
+      expect(view.format).to eq("L")
+      expect(view.item_size).to eq(4)
+      expect(view.shape).to eq([3])
+      expect(view.strides).to eq([4])
+      expect(view[1]).to eq(2)
+    end
+
+    it "exports the byte order when it is not the host's" do
+      little = [1].pack("S") == [1].pack("S<")
+      order = little ? :big : :little
+      view = Fiddle::MemoryView.new(Uint32Array.new([0x01020304], endianess: order))
+      expect(view.format).to eq(little ? "L>" : "L<")
+      expect(view[0]).to eq(0x01020304)
+      view = Fiddle::MemoryView.new(Float64Array.new([2.5], endianess: order))
+      expect(view.format).to eq(little ? "G" : "E")
+      expect(view[0]).to eq(2.5)
+    end
+  end
+end
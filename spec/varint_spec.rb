@@ -0,0 +1,89 @@
+require "spec_helper"
+
+describe "varints" do
+  let(:buffer) { ArrayBuffer.new(32) }
+  let(:view) { DataView.new(buffer) }
+
+  def bytes_at(offset, count)
+    buffer.bytes.bytes[offset, count]
+  end
+
+  describe "getVarint and setVarint" do
+    it "encodes unsigned LEB128" do
+      expect(view.setVarint(0, 1)).to eq(1)
+      expect(view.setVarint(1, 300)).to eq(2)
+      expect(bytes_at(0, 3)).to eq([0x01, 0xAC, 0x02])
+      expect(view.getVarint(1)).to eq([300, 2])
+    end
+
+    it "round-trips the whole 64 bits range" do
+      [0, 127, 128, 2**32, 2**56 - 1, 2**56, 2**63, 2**64 - 1].each do |value|
+        size = view.setVarint(3, value)
+        expect(view.getVarint(3)).to eq([value, size])
+      end
+      expect(view.setVarint(0, 2**64 - 1)).to eq(10)
+    end
+
+    it "caps values" do
+      view.setVarint(0, -5)
+      expect(view.getVarint(0)).to eq([0, 1])
+      view.setVarint(0, 2**70)
+      expect(view.getVarint(0)).to eq([2**64 - 1, 10])
+    end
+
+    it "raises on truncated or overlong varints" do
+      short = DataView.new(buffer, 0, 2)
+      short.setU8(0, 0x80)
+      short.setU8(1, 0x80)
+      expect { short.getVarint(0) }.to raise_error(ArgumentError, /truncated/)
+      12.times { |idx| view.setU8(idx, 0xFF) }
+      expect { view.getVarint(0) }.to raise_error(ArgumentError, /malformed/)
+      expect { short.setVarint(1, 300) }.to raise_error(ArgumentError, /2 bytes needed/)
+    end
+
+    it "converts the offset before taking the bytes" do
+      expect { view.getVarint(shrinking_index(buffer, 1, 20)) }.to raise_error(ArgumentError, /out of bounds/)
+      expect { view.setVarint(shrinking_index(buffer, 1, 20), 1) }.to raise_error(ArgumentError, /out of bounds/)
+      expect { view.setZigZag(shrinking_index(buffer, 1, 20), 1) }.to raise_error(ArgumentError, /out of bounds/)
+      expect { view.decode_varints(shrinking_index(buffer, 1, 20), 1) }.to raise_error(ArgumentError, /out of bounds/)
+    end
+  end
+
+  describe "getZigZag and setZigZag" do
+    it "maps signed values to unsigned ones" do
+      [0, -1, 1, -2].each_with_index do |value, encoded|
+        view.setZigZag(0, value)
+        expect(view.getVarint(0)).to eq([encoded, 1])
+        expect(view.getZigZag(0)).to eq([value, 1])
+      end
+    end
+
+    it "round-trips the 64 bits signed range" do
+      [2**63 - 1, -2**63, -300].each do |value|
+        size = view.setZigZag(0, value)
+        expect(view.getZigZag(0)).to eq([value, size])
+      end
+    end
+  end
+
+  describe "decode_varints" do
+    it "decodes runs of varints" do
+      values = [1, 300, 2**40, 0, 2**64 - 1, 5]
+      offset = 0
+      values.each { |value| offset += view.setVarint(offset, value) }
+      expect(view.decode_varints(0, values.size)).to eq([values, offset])
+      expect(view.decode_varints(1, 2)).to eq([[300, 2**40], 8])
+    end
+
+    it "decodes ZigZag varints" do
+      offset = 0
+      [-1, 2, -3].each { |value| offset += view.setZigZag(offset, value) }
+      expect(view.decode_varints(0, 3, zigzag: true)).to eq([[-1, 2, -3], 3])
+    end
+
+    it "raises when the run is truncated" do
+      view.setVarint(30, 300)
+      expect { view.decode_varints(30, 2) }.to raise_error(ArgumentError, /after 1 values/)
+    end
+  end
+end